@@ -0,0 +1,153 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "matrix.h"
+#include "feature_matrix.h"
+
+/*
+ * NOTE:
+ * A Dataset is a binary file of features (and optionally labels) that is
+ * memory mapped instead of parsed: the features and labels are used in place
+ * through views (see gmf_dataset_features()) so opening a file of any size
+ * takes no time and no memory besides the page cache.
+ *
+ * File layout (native byte order):
+ *
+ *     [DatasetHeader - 64 bytes][features][padding][labels - n_rows floats]
+ *
+ * Every block starts at a multiple of GMF_DATASET_ALIGNMENT bytes. DATASET_ROWS
+ * stores the features row-major (the same layout as a Matrix/FeatureMatrix)
+ * and DATASET_COLUMNS stores every column as its own aligned block of n_rows
+ * values (column c starts column_stride * c bytes into the features).
+ * Features are stored as FEATURES_F32, FEATURES_F16 or FEATURES_BF16.
+ */
+
+#define GMF_DATASET_MAGIC "GMFDATA"
+#define GMF_DATASET_VERSION 1
+#define GMF_DATASET_ALIGNMENT 64
+
+// storage order of the features of a Dataset
+typedef enum DatasetLayout
+{
+	DATASET_ROWS, // row-major, can be used as a Matrix/FeatureMatrix directly
+	DATASET_COLUMNS // column-major, every column is a GMF_DATASET_ALIGNMENT aligned block
+} DatasetLayout;
+
+// first 64 bytes of a dataset file
+typedef struct DatasetHeader
+{
+	char magic[8]; // GMF_DATASET_MAGIC
+	uint32_t version; // GMF_DATASET_VERSION
+	uint32_t type; // FeatureType of the features
+	uint32_t layout; // DatasetLayout
+	uint32_t has_labels; // 1 if the file has labels
+	uint64_t n_rows;
+	uint64_t n_columns;
+	uint64_t column_stride; // bytes from one column to the next - DATASET_COLUMNS only
+	uint64_t features_offset; // offset of the features from the start of the file
+	uint64_t labels_offset; // offset of the labels from the start of the file (0 if there are none)
+} DatasetHeader;
+
+// an open (memory mapped) dataset file
+typedef struct Dataset
+{
+	DatasetLayout layout;
+	FeatureType type;
+	size_t n_rows;
+	size_t n_columns;
+	size_t column_stride; // bytes from one column to the next - DATASET_COLUMNS only
+	const void* features; // first feature value (inside the mapping)
+	const float* labels; // (n_rows) labels (inside the mapping), NULL if the file has none
+	void* mapping;
+	size_t mapping_size;
+} Dataset;
+
+// writes a DATASET_ROWS file one block of rows at a time, so data sets
+// larger than memory can be written. The labels are streamed into a
+// temporary file and copied behind the features by gmf_dataset_writer_close().
+typedef struct DatasetWriter
+{
+	FILE* file;
+	DatasetHeader header;
+	FeatureMatrix* row; // (1, n_columns) conversion buffer of a single row
+	FILE* labels; // temporary file of the labels written so far, NULL if the file has none
+} DatasetWriter;
+
+// chunks of the rows of a DATASET_ROWS file with labels, see gmf_dataset_iterator()
+typedef struct DatasetIterator
+{
+	const Dataset* dataset;
+	size_t chunk_rows;
+	size_t position; // first row of the next chunk
+	FeatureMatrix X; // view of the current chunk
+	Matrix Y; // view of the labels of the current chunk
+} DatasetIterator;
+
+// write X (and Y if it isn't NULL) converted to type (FEATURES_F32, FEATURES_F16
+// or FEATURES_BF16) into a new dataset file at path
+void gmf_dataset_write(
+		const char* path,
+		const Matrix* X,
+		const Matrix* Y,
+		const FeatureType type,
+		const DatasetLayout layout);
+
+// start writing a DATASET_ROWS file with n_columns features stored as type.
+// If has_labels is set every block of rows needs labels.
+DatasetWriter* gmf_dataset_writer_init(
+		const char* path,
+		const size_t n_columns,
+		const FeatureType type,
+		const bool has_labels);
+
+// append the rows of X (and their labels Y, NULL if the file has none)
+void gmf_dataset_writer_append(
+		DatasetWriter* writer,
+		const Matrix* X,
+		const Matrix* Y);
+
+// write the labels and the final header, close the file and cleanup memory
+void gmf_dataset_writer_close(DatasetWriter** writer);
+
+// memory map the dataset file at path (read only). Exits with an error if it
+// isn't a valid dataset file. Large mappings are advised to use huge pages
+// where the system supports them, which cuts TLB misses of passes over the data.
+Dataset* gmf_dataset_open(const char* path);
+
+// unmap the file and cleanup memory. Every view of the dataset becomes invalid.
+void gmf_dataset_close(Dataset** dataset);
+
+// FeatureMatrix view of the features of a DATASET_ROWS file (nothing is
+// copied), e.g. for gmf_model_linear_fit_features() or gmf_model_knn_fit_features().
+// The view is read only and valid until the dataset is closed.
+FeatureMatrix gmf_dataset_features(const Dataset* dataset);
+
+// Matrix view of the features of a FEATURES_F32 DATASET_ROWS file (nothing is
+// copied), e.g. for gmf_model_linear_fit() or gmf_model_linear_predict().
+// Read only, don't mat_free() it. Valid until the dataset is closed.
+Matrix gmf_dataset_matrix(const Dataset* dataset);
+
+// (n_rows, 1) Matrix view of the labels (nothing is copied).
+// Read only, don't mat_free() it. Valid until the dataset is closed.
+Matrix gmf_dataset_labels(const Dataset* dataset);
+
+// first value of column c (n_rows values of type) of a DATASET_COLUMNS file
+const void* gmf_dataset_column(
+		const Dataset* dataset,
+		const size_t c);
+
+// DataIterator over chunks of chunk_rows rows (the last one can be smaller) of
+// a DATASET_ROWS file with labels, e.g. for gmf_model_linear_partial_fit().
+// Every chunk is a view into the mapping, nothing is copied. iterator holds
+// the state and must outlive the returned DataIterator.
+DataIterator gmf_dataset_iterator(
+		DatasetIterator* iterator,
+		const Dataset* dataset,
+		const size_t chunk_rows);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef FEATURE_HASHER_H
+#define FEATURE_HASHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * NOTE:
+ * A FeatureHasher turns raw tokens (words, "field=value" categories, ...)
+ * into a FEATURES_CSR matrix with a fixed number of columns without a
+ * vocabulary: every token is hashed to a column and a sign (signed hashing,
+ * so collisions cancel out on average instead of piling up) and rows are
+ * appended straight into the CSR arrays as they are streamed in.
+ *
+ * Tokens of a row are added one at a time, gmf_features_hasher_end_row()
+ * closes the row (columns sorted, collisions within the row summed) and
+ * gmf_features_hasher_finish() hands the rows collected so far over as a
+ * FeatureMatrix. Memory is proportional to the number of non-zero values,
+ * never to n_features, so n_features can be 2^20 or more.
+ *
+ * Column 0 is the bias (a 1 in every row) if add_bias is set and the
+ * hashed columns follow it.
+ */
+
+// forward declaration
+typedef struct FeatureMatrix FeatureMatrix;
+
+// value of a single hashed token, sorted and merged by gmf_features_hasher_end_row()
+typedef struct HashedValue
+{
+	uint32_t column;
+	float value;
+} HashedValue;
+
+typedef struct FeatureHasher
+{
+	size_t n_features; // number of hashed columns (excluding the bias)
+	bool add_bias; // column 0 is 1 in every row
+	uint64_t seed;
+	size_t n_rows; // rows ended so far
+	size_t row_capacity;
+	size_t nonzero_capacity;
+	size_t* row_ptr; // (row_capacity + 1) offsets of the rows ended so far
+	uint32_t* col_idx; // (nonzero_capacity) columns of the rows ended so far
+	float* data; // (nonzero_capacity) values of the rows ended so far
+	size_t n_pending; // tokens of the current row
+	size_t pending_capacity;
+	HashedValue* pending; // (pending_capacity) tokens of the current row
+} FeatureHasher;
+
+// hasher for n_features hashed columns (< 2^32 - 1 including the bias).
+// Different seeds give independent hash functions.
+FeatureHasher* gmf_features_hasher_init(
+		const size_t n_features,
+		const bool add_bias,
+		const uint64_t seed);
+
+// 64 bit hash of length bytes of token (FNV-1a with a murmur3 finalizer)
+uint64_t gmf_features_hash(
+		const void* token,
+		const size_t length,
+		const uint64_t seed);
+
+// add value * sign(token) to the column of the (null terminated) token in the current row
+void gmf_features_hasher_add(
+		FeatureHasher* hasher,
+		const char* token,
+		const float value);
+
+// gmf_features_hasher_add() for a token of length bytes (no null terminator needed)
+void gmf_features_hasher_add_bytes(
+		FeatureHasher* hasher,
+		const void* token,
+		const size_t length,
+		const float value);
+
+// add the categorical value category of field (one-hot without a vocabulary).
+// The same category of different fields maps to different columns.
+void gmf_features_hasher_add_category(
+		FeatureHasher* hasher,
+		const char* field,
+		const char* category);
+
+// add every whitespace separated word of text with value 1 (bag of words)
+void gmf_features_hasher_add_text(
+		FeatureHasher* hasher,
+		const char* text);
+
+// close the current row: its tokens are sorted by column, tokens hashed to
+// the same column are summed (values that cancel out are dropped) and the
+// row is appended to the CSR arrays
+void gmf_features_hasher_end_row(FeatureHasher* hasher);
+
+// number of columns of the matrices returned by gmf_features_hasher_finish()
+size_t gmf_features_hasher_n_columns(const FeatureHasher* hasher);
+
+// hand the rows ended so far over as an (n_rows, n_columns) FEATURES_CSR
+// matrix (nothing is copied) and start over with no rows, e.g. to hash
+// a large data set in chunks. The current row must be ended first.
+FeatureMatrix* gmf_features_hasher_finish(FeatureHasher* hasher);
+
+// cleanup FeatureHasher memory (including rows that weren't finished)
+void gmf_features_hasher_free(FeatureHasher** hasher);
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef FEATURE_MATRIX_H
+#define FEATURE_MATRIX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * NOTE:
+ * A FeatureMatrix is a read-only, row-major (n_rows, n_columns) block
+ * of features that can be stored in reduced precision. Half precision
+ * storage halves the resident size of the data and the bytes streamed
+ * by every pass over it. Values are converted to float on the fly
+ * inside the row kernels below and every sum is accumulated in float
+ * (or double by the callers), only the storage is reduced.
+ *
+ * FEATURES_F16 is IEEE 754 half precision (~3 significant digits,
+ * max 65504) and FEATURES_BF16 keeps the range of float with only
+ * ~2 significant digits. Conversions round to nearest even.
+ *
+ * A row view (see gmf_features_rows()) is a FeatureMatrix over a subset
+ * of the rows of another one: row r of the view is row row_idx[r] of the
+ * data. Every row kernel goes through row_idx so training on a subset
+ * doesn't have to copy it.
+ *
+ * FEATURES_CSR stores only the non-zero values (compressed sparse rows):
+ * the values of row r are data[row_ptr[r]], ..., data[row_ptr[r + 1] - 1]
+ * in columns col_idx[row_ptr[r]], ... (ascending within a row). Memory and
+ * every row kernel are proportional to the number of non-zero values, so
+ * X * W and X^T r only touch the non-zero values of every row.
+ */
+
+// forward declaration
+typedef struct Matrix Matrix;
+
+// storage type of a FeatureMatrix
+typedef enum FeatureType
+{
+	FEATURES_F32, // float (no conversion)
+	FEATURES_F16, // IEEE 754 half precision
+	FEATURES_BF16, // bfloat16 (upper half of a float)
+	FEATURES_CSR // compressed sparse rows of float (see gmf_features_csr_alloc())
+} FeatureType;
+
+typedef struct FeatureMatrix
+{
+	FeatureType type;
+	size_t n_rows;
+	size_t n_columns;
+	void* data; // (n_rows, n_columns) values of type, (n_nonzero) floats for FEATURES_CSR
+	bool owns_data; // false for views of a Matrix
+	const size_t* row_idx; // (n_rows) rows of data used by a row view, NULL otherwise
+	size_t* row_ptr; // (n_rows + 1) offset of every row into col_idx and data - FEATURES_CSR only
+	uint32_t* col_idx; // (n_nonzero) column of every value - FEATURES_CSR only
+} FeatureMatrix;
+
+// float view of X (nothing is copied). X must outlive the view.
+FeatureMatrix gmf_features_view(const Matrix* X);
+
+// view of the n_rows rows row_idx of X (nothing is copied). Row r of the
+// view is row row_idx[r] of X. X and row_idx must outlive the view.
+FeatureMatrix gmf_features_rows(
+		const FeatureMatrix* X,
+		const size_t* row_idx,
+		const size_t n_rows);
+
+// row of the data that backs row r of X
+size_t gmf_features_data_row(
+		const FeatureMatrix* X,
+		const size_t r);
+
+// allocate an (n_rows, n_columns) FeatureMatrix of zeros. Rows can be
+// filled with gmf_features_set_row() so the data never has to exist as float.
+// Use gmf_features_csr_alloc() for FEATURES_CSR.
+FeatureMatrix* gmf_features_alloc(
+		const size_t n_rows,
+		const size_t n_columns,
+		const FeatureType type);
+
+// allocate an (n_rows, n_columns) FEATURES_CSR matrix with room for n_nonzero
+// values. row_ptr starts out as zeros (every row empty); fill row_ptr, col_idx
+// and data directly, then check them with gmf_features_csr_check().
+FeatureMatrix* gmf_features_csr_alloc(
+		const size_t n_rows,
+		const size_t n_columns,
+		const size_t n_nonzero);
+
+// FEATURES_CSR view of existing CSR arrays (nothing is copied). row_ptr has
+// n_rows + 1 offsets into col_idx and data. The arrays must outlive the view.
+FeatureMatrix gmf_features_csr_view(
+		const size_t n_rows,
+		const size_t n_columns,
+		const size_t* row_ptr,
+		const uint32_t* col_idx,
+		const float* data);
+
+// exits with an error unless the CSR arrays of X are valid: row_ptr is
+// non-decreasing and every row has ascending columns < n_columns
+void gmf_features_csr_check(const FeatureMatrix* X);
+
+// copy X converted to type (FEATURES_CSR keeps only the non-zero values)
+FeatureMatrix* gmf_features_init(
+		const Matrix* X,
+		const FeatureType type);
+
+// cleanup FeatureMatrix memory
+void gmf_features_free(FeatureMatrix** X);
+
+// bytes used by the values of X (including the indices of FEATURES_CSR)
+size_t gmf_features_bytes(const FeatureMatrix* X);
+
+// number of stored values of X (n_rows * n_columns unless FEATURES_CSR)
+size_t gmf_features_nonzeros(const FeatureMatrix* X);
+
+// element (r, c) of X as float
+float gmf_features_at(
+		const FeatureMatrix* X,
+		const size_t r,
+		const size_t c);
+
+// convert row (n_columns floats) and store it as row r of X. Not supported by FEATURES_CSR.
+void gmf_features_set_row(
+		FeatureMatrix* X,
+		const size_t r,
+		const float* row);
+
+// write row r of X as n_columns floats into row
+void gmf_features_row(
+		const FeatureMatrix* X,
+		const size_t r,
+		float* row);
+
+// write columns [column_start, column_start + n) of row r of X as n floats into row
+void gmf_features_row_slice(
+		const FeatureMatrix* X,
+		const size_t r,
+		const size_t column_start,
+		const size_t n,
+		float* row);
+
+// dot product of row r of X with w (n_columns floats)
+float gmf_features_dot(
+		const FeatureMatrix* X,
+		const size_t r,
+		const float* w);
+
+// y += a * (row r of X) where y is n_columns floats
+void gmf_features_axpy(
+		const FeatureMatrix* X,
+		const size_t r,
+		const float a,
+		float* y);
+
+// caller-supplied stream of (X, Y) chunks, e.g. blocks of a data set that
+// doesn't fit in memory read one at a time (see gmf_model_linear_partial_fit())
+typedef struct DataIterator
+{
+	// point *X and *Y at the next chunk and return true, or return false once
+	// every chunk was visited. Every chunk has the same columns (including the
+	// bias column) and only has to stay valid until the next call.
+	bool (*next)(void* state, const FeatureMatrix** X, const Matrix** Y);
+	// start over at the first chunk (NULL if the data can only be read once)
+	void (*reset)(void* state);
+	void* state; // passed to next and reset
+} DataIterator;
+
+#endif
@@ -1,11 +1,61 @@
 #ifndef GMF_UTIL_H
 #define GMF_UTIL_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 // forward declaration
 typedef struct Matrix Matrix;
+typedef struct ThreadPool ThreadPool;
+
+// state of a small (splitmix64) random number generator. Every user
+// gets its own state so streams are reproducible and thread safe.
+typedef struct RandomState
+{
+	uint64_t state;
+} RandomState;
 
 // add a bias term - modifies X inplace and potentially
 // changes the underlying pointer address
 void gmf_util_add_bias(Matrix** X);
 
+// seed a random number generator
+void gmf_util_random_seed(RandomState* random_state, const uint64_t seed);
+
+// next random 64 bit integer
+uint64_t gmf_util_random_next(RandomState* random_state);
+
+// random integer in [0, n)
+size_t gmf_util_random_index(RandomState* random_state, const size_t n);
+
+// random float in [low, high)
+float gmf_util_random_uniform(RandomState* random_state, const float low, const float high);
+
+// shuffle idx inplace (Fisher-Yates)
+void gmf_util_shuffle(RandomState* random_state, size_t* idx, const size_t n);
+
+// draw n_samples distinct indices from [0, n) into idx in increasing
+// order (selection sampling, a single pass without extra memory)
+void gmf_util_sample(RandomState* random_state, size_t* idx, const size_t n_samples, const size_t n);
+
+// create a pool with n_threads threads (including the calling thread,
+// so n_threads <= 1 runs everything on the caller without spawning anything)
+ThreadPool* gmf_util_thread_pool_init(const size_t n_threads);
+
+// total number of threads that run tasks (including the calling thread)
+size_t gmf_util_thread_pool_size(const ThreadPool* pool);
+
+// run task(args, i) for every i in [0, n_tasks) across the pool and
+// block until all of them have finished. Tasks are handed out in
+// order but may complete in any order, so tasks must write to
+// separate memory if the result should be deterministic.
+void gmf_util_thread_pool_run(
+		ThreadPool* pool,
+		const size_t n_tasks,
+		void (*task)(void*, size_t),
+		void* args);
+
+// stop all threads and cleanup memory
+void gmf_util_thread_pool_free(ThreadPool** pool);
+
 #endif
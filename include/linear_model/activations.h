@@ -14,6 +14,7 @@
 // forward declaration
 typedef struct Matrix Matrix;
 typedef struct LinearModel LinearModel;
+typedef struct LinearModelVec LinearModelVec;
 
 // f(x) = x
 void gmf_activation_identity(
@@ -35,4 +36,25 @@ void gmf_activation_sigmoid_hard(
 		Matrix** XW,
 		const LinearModel* lm);
 
+/*
+ * Activations of the vectorized model (see linear_model_vec.h).
+ * These are given XW of shape (r, s), one column per output.
+ */
+
+// f(x) = x
+void gmf_activation_vec_identity(
+		Matrix** XW,
+		const LinearModelVec* lm);
+
+// f(x) = 1 / (1 + e^(-x)) for every output separately
+void gmf_activation_vec_sigmoid(
+		Matrix** XW,
+		const LinearModelVec* lm);
+
+// f(x)_j = e^(x_j) / sum(e^(x_k)) over the outputs of each row,
+// i.e. the probability of every class (multiclass classification)
+void gmf_activation_vec_softmax(
+		Matrix** XW,
+		const LinearModelVec* lm);
+
 #endif
@@ -0,0 +1,71 @@
+#ifndef COORDINATE_DESCENT_H
+#define COORDINATE_DESCENT_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * NOTE:
+ * Building blocks of the COORDINATE_DESCENT model type which minimizes
+ *
+ *     sum((y - XW)^2) + l1 * sum(|w_j|) + l2 * sum(w_j^2)
+ *
+ * one weight at a time. X is stored column-major (every column is
+ * contiguous) and the residual y - XW is cached so updating w_j
+ * only touches column j.
+ *
+ * Column j is X_columns[column_ptr[j]], ..., X_columns[column_ptr[j + 1] - 1].
+ * A dense X stores every row of every column (row_idx is NULL) while a
+ * FEATURES_CSR X only stores the non-zero values with their rows in row_idx
+ * (compressed sparse columns), so a sweep costs O(non-zero values).
+ */
+
+// forward declaration
+typedef struct Matrix Matrix;
+typedef struct FeatureMatrix FeatureMatrix;
+
+// copy X into column-major X_columns (gmf_features_nonzeros(X) values) and
+// fill column_ptr (n_columns + 1), compute the squared norm of every column and
+// the residual Y - XW for the current W. row_idx (gmf_features_nonzeros(X) rows)
+// is only written for FEATURES_CSR and can be NULL otherwise.
+// X_columns is always float, even if X is stored in reduced precision.
+void gmf_coordinate_descent_prepare(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const float* W,
+		size_t* column_ptr,
+		uint32_t* row_idx,
+		float* X_columns,
+		double* column_norms,
+		double* residual);
+
+// update the weights of the n_active columns listed in columns (in order).
+// Columns before first_penalized (e.g. the bias) aren't regularized.
+// The residual is kept up to date. Returns the largest change of
+// |delta w_j| * sqrt(column_norms[j] / n_rows), the RMS change of the predictions.
+double gmf_coordinate_descent_sweep(
+		const float* X_columns,
+		const size_t* column_ptr,
+		const uint32_t* row_idx,
+		const size_t n_rows,
+		const size_t* columns,
+		const size_t n_active,
+		const double* column_norms,
+		const double l1,
+		const double l2,
+		const size_t first_penalized,
+		double* residual,
+		float* W);
+
+// smallest l1 for which every penalized weight is zero given the residual
+// of the unpenalized columns: 2 * max_j |x_j^T residual|
+double gmf_coordinate_descent_l1_max(
+		const float* X_columns,
+		const size_t* column_ptr,
+		const uint32_t* row_idx,
+		const size_t n_columns,
+		const size_t first_penalized,
+		const double* residual);
+
+#endif
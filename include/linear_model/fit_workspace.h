@@ -0,0 +1,56 @@
+#ifndef FIT_WORKSPACE_H
+#define FIT_WORKSPACE_H
+
+#include <stddef.h>
+
+/*
+ * NOTE:
+ * Parts of the training workspace shared by LinearModel and LinearModelVec.
+ * Samples are drawn from shuffled epochs of row indices and gradients are
+ * computed over fixed size chunks of rows whose partial results are combined
+ * with a pairwise tree reduction in a fixed order, so results don't depend
+ * on the number of threads used.
+ */
+
+// forward declarations
+typedef struct RandomState RandomState;
+typedef struct ThreadPool ThreadPool;
+
+// allocate the identity permutation of [0, n_rows) used for sampling
+size_t* gmf_fit_row_idx_alloc(const size_t n_rows);
+
+// allocate (n_chunks, n_weights) partial gradients and (n_chunks) partial losses
+void gmf_fit_partials_alloc(
+		const size_t n_chunks,
+		const size_t n_weights,
+		float** partial_gradients,
+		double** partial_losses);
+
+// next n_sample_rows entries of row_idx. Every epoch visits each row exactly
+// once in a random order; once there aren't enough rows left for a full
+// sample row_idx is reshuffled. *epoch_position is the position of the next
+// sample (n_rows starts a new epoch).
+const size_t* gmf_fit_next_sample(
+		RandomState* random_state,
+		size_t* row_idx,
+		const size_t n_rows,
+		const size_t n_sample_rows,
+		size_t* epoch_position);
+
+// run task(args, chunk) for every chunk in [0, n_chunks), on thread_pool
+// unless it's NULL
+void gmf_fit_run_chunks(
+		ThreadPool* thread_pool,
+		const size_t n_chunks,
+		void (*task)(void*, size_t),
+		void* args);
+
+// sum the n_chunks partial gradients (n_weights each) and losses into the
+// first ones with a pairwise tree reduction in a fixed order
+void gmf_fit_reduce_chunks(
+		float* partial_gradients,
+		double* partial_losses,
+		const size_t n_chunks,
+		const size_t n_weights);
+
+#endif
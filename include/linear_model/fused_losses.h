@@ -0,0 +1,148 @@
+#ifndef FUSED_LOSSES_H
+#define FUSED_LOSSES_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * NOTE:
+ * Fused kernels do the work of activation + loss + loss_gradient
+ * in a single streaming pass over X. For every row we compute
+ * x*W, apply the activation, accumulate the loss and add the
+ * row's contribution to the gradient X^T r without allocating
+ * any temporaries (no Yhat, no copies of Y and no transpose of X).
+ *
+ * The returned loss (including regularization) and the gradient
+ * written to loss_gradient match the unfused functions, i.e.
+ * gmf_fused_loss_squared() == gmf_loss_squared() + gmf_loss_gradient_squared().
+ *
+ * The built-in kernels only understand the built-in activations
+ * (identity, sigmoid_soft and sigmoid_hard). It is assumed that
+ * loss_gradient matrix is pre-allocated to shape (c, 1).
+ */
+
+// forward declaration
+typedef struct Matrix Matrix;
+typedef struct FeatureMatrix FeatureMatrix;
+typedef struct LinearModel LinearModel;
+typedef struct LazyRegularization LazyRegularization;
+
+// fused gmf_loss_squared + gmf_loss_gradient_squared
+float gmf_fused_loss_squared(
+		const Matrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		Matrix** loss_gradient);
+
+// fused gmf_loss_cross_entropy + gmf_loss_gradient_cross_entropy
+float gmf_fused_loss_cross_entropy(
+		const Matrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		Matrix** loss_gradient);
+
+// fused gmf_loss_absolute + gmf_loss_gradient_absolute
+float gmf_fused_loss_absolute(
+		const Matrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		Matrix** loss_gradient);
+
+// fused gmf_loss_hinge + gmf_loss_gradient_hinge
+float gmf_fused_loss_hinge(
+		const Matrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		Matrix** loss_gradient);
+
+// fused gmf_loss_huber + gmf_loss_gradient_huber
+float gmf_fused_loss_huber(
+		const Matrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		Matrix** loss_gradient);
+
+// returns the built-in fused kernel matching the model's activation,
+// loss and loss gradient or NULL if there is none (e.g. custom functions)
+float (*gmf_fused_loss_select(const LinearModel* lm))(const Matrix*, const Matrix*, const LinearModel*, Matrix**);
+
+// low level building block of the built-in kernels used for multi-threaded
+// and mini-batch training. Adds the (un-normalized) gradient contribution of
+// rows [row_start, row_end) of X to gradient and returns their summed loss
+// WITHOUT regularization (or 0 without compute_loss, which skips the loss
+// of every row). If row_idx isn't NULL, the rows visited are
+// row_idx[row_start], ..., row_idx[row_end - 1] instead (no rows are copied).
+// X can be stored in reduced precision (see feature_matrix.h).
+// regularization_gradient is the scalar added to every residual.
+// Requires gmf_fused_loss_select(lm) != NULL.
+double gmf_fused_loss_accumulate(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		const float regularization_gradient,
+		const size_t* row_idx,
+		const size_t row_start,
+		const size_t row_end,
+		const bool compute_loss,
+		float* gradient);
+
+// per-sample SGD used by STOCHASTIC training with the built-in kernels.
+// For every row r = row_idx[0], ..., row_idx[n_samples - 1] this computes the
+// scalar residual of row r and updates W (n_columns floats) inplace with
+// W -= learning_rate * (residual + regularization_gradient) * x_r followed by
+// the proximal step of a proximal regularization (see gmf_regularization_is_proximal())
+// if proximal is true (HOGWILD passes false and takes the steps once per window).
+// If lazy isn't NULL the proximal steps are deferred (see LazyRegularization)
+// so a sparse row only touches the weights of its non-zero columns.
+// Only the last n_loss_samples rows compute their loss (the loss is only
+// reported every so often, the other rows skip it). Returns the summed loss
+// of those rows (before their update) WITHOUT regularization.
+// Requires gmf_fused_loss_select(lm) != NULL.
+double gmf_fused_loss_sgd(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		const float learning_rate,
+		const float regularization_gradient,
+		const size_t* row_idx,
+		const size_t n_samples,
+		const size_t n_loss_samples,
+		const bool proximal,
+		LazyRegularization* lazy,
+		float* W);
+
+// single mini-batch SGD step used by BATCH training on FEATURES_CSR data:
+// the residuals of the rows row_idx[0], ..., row_idx[n_rows - 1] are computed
+// with the current W (stored in residuals, n_rows floats), then
+// W -= learning_rate / n_rows * sum((residual + regularization_gradient) * x_r)
+// followed by the (possibly lazy) proximal step like gmf_fused_loss_sgd().
+// Only the weights of the non-zero columns of the rows are touched.
+// Returns the summed loss of the rows WITHOUT regularization (or 0
+// without compute_loss).
+// Requires gmf_fused_loss_select(lm) != NULL.
+double gmf_fused_loss_sgd_batch(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		const float learning_rate,
+		const float regularization_gradient,
+		const size_t* row_idx,
+		const size_t n_rows,
+		const bool compute_loss,
+		LazyRegularization* lazy,
+		float* residuals,
+		float* W);
+
+// loss only (no gradient) of rows row_idx[0], ..., row_idx[n_rows - 1]
+// (or the first n_rows rows if row_idx is NULL) using the current W.
+// Returns the summed loss WITHOUT regularization, e.g. for validation data.
+// Requires gmf_fused_loss_select(lm) != NULL.
+double gmf_fused_loss_value(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		const size_t* row_idx,
+		const size_t n_rows);
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * NOTE:
+ * Array level kernels behind the built-in activations, losses and predictions.
+ * Every kernel has an AVX-512, an AVX2 (+FMA) and a scalar version.
+ * The fastest one the CPU supports is picked at runtime unless
+ * gmf_kernel_set_isa() says otherwise (or the library is built with
+ * GMF_KERNEL_SCALAR defined, or not by GCC/Clang on x86).
+ *
+ * exp and log are polynomial approximations (Cephes) accurate to
+ * a couple of float ulps. The ISAs round slightly differently so
+ * results can differ in the last bits between machines; force
+ * KERNEL_SCALAR if you need bitwise identical results everywhere.
+ *
+ * Losses are summed in double and returned WITHOUT regularization.
+ */
+
+// instruction set used by the kernels
+typedef enum KernelISA
+{
+	KERNEL_AUTO, // best one the CPU supports
+	KERNEL_SCALAR,
+	KERNEL_AVX2,
+	KERNEL_AVX512
+} KernelISA;
+
+// choose the instruction set of every kernel. Falls back to the best
+// supported one if the CPU can't run isa. Not thread safe - call it
+// before training.
+void gmf_kernel_set_isa(const KernelISA isa);
+
+// instruction set the kernels currently run
+KernelISA gmf_kernel_isa();
+
+// e^x (scalar version of the vectorized approximation)
+float gmf_kernel_exp(const float x);
+
+// ln(x) for x > 0 (scalar version of the vectorized approximation)
+float gmf_kernel_log(const float x);
+
+// z = 1 / (1 + e^(-z)) inplace
+void gmf_kernel_sigmoid(
+		float* z,
+		const size_t n);
+
+// z = 1 if 1 / (1 + e^(-z)) > threshold, 0 otherwise (inplace)
+void gmf_kernel_sigmoid_hard(
+		float* z,
+		const size_t n,
+		const float threshold);
+
+// softmax of every row of the row-major (n_rows, n_columns) z inplace:
+// z[r, c] = e^z[r, c] / sum(e^z[r, :])
+void gmf_kernel_softmax(
+		float* z,
+		const size_t n_rows,
+		const size_t n_columns);
+
+// sum((y - yhat)^2)
+double gmf_kernel_loss_squared(
+		const float* y,
+		const float* yhat,
+		const size_t n);
+
+// sum(-y * log(p) - (1 - y) * log(1 - p)) where p is yhat clamped to [0.01, 0.99]
+double gmf_kernel_loss_cross_entropy(
+		const float* y,
+		const float* yhat,
+		const size_t n);
+
+// sum(|y - yhat|)
+double gmf_kernel_loss_absolute(
+		const float* y,
+		const float* yhat,
+		const size_t n);
+
+// sum(max(0, 1 - y * yhat)) where labels (and predictions) of 0 count as -1
+double gmf_kernel_loss_hinge(
+		const float* y,
+		const float* yhat,
+		const size_t n);
+
+// sum(0.5 * (y - yhat)^2) where |y - yhat| < delta, otherwise sum(delta * (|y - yhat| - 0.5 * delta))
+double gmf_kernel_loss_huber(
+		const float* y,
+		const float* yhat,
+		const size_t n,
+		const float delta);
+
+// y[r * y_stride] = X[r, :] . w for every r in [0, n_rows) where row r starts
+// at X + r * x_stride and has n_columns floats. Adds to y instead if accumulate
+// is true (used to sum the column blocks of a wide X).
+void gmf_kernel_gemv(
+		const float* X,
+		const size_t n_rows,
+		const size_t n_columns,
+		const size_t x_stride,
+		const float* w,
+		float* y,
+		const size_t y_stride,
+		const bool accumulate);
+
+// Y = X * W where row r of X starts at X + r * x_stride and has n_inner floats,
+// W is the row-major (n_inner, n_columns) and Y the row-major (n_rows, n_columns).
+// Adds to Y instead if accumulate is true (used to sum the blocks of a wide X).
+void gmf_kernel_gemm(
+		const float* X,
+		const size_t n_rows,
+		const size_t n_inner,
+		const size_t x_stride,
+		const float* W,
+		const size_t n_columns,
+		float* Y,
+		const bool accumulate);
+
+#endif
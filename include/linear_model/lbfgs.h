@@ -0,0 +1,55 @@
+#ifndef LBFGS_H
+#define LBFGS_H
+
+#include <math.h>
+#include <stddef.h>
+
+/*
+ * NOTE:
+ * Building blocks of the LBFGS model type. The curvature pairs
+ * s = W_new - W_old and y = gradient_new - gradient_old are kept
+ * in ring buffers of (history, n) doubles. Everything here works
+ * on plain arrays so nothing is allocated while training.
+ */
+
+// evaluates the objective at the current weights, stores its
+// gradient (n doubles) and returns the objective value
+typedef double (*LBFGSObjective)(void* context, double* gradient);
+
+// two-loop recursion: direction = -H * gradient where H is the inverse
+// hessian approximation built from the n_pairs most recent curvature pairs.
+// newest is the ring buffer slot of the most recent pair.
+// alpha is scratch space of history doubles.
+void gmf_lbfgs_direction(
+		const double* gradient,
+		const double* s,
+		const double* y,
+		const double* rho,
+		const size_t n_pairs,
+		const size_t newest,
+		const size_t history,
+		const size_t n,
+		double* alpha,
+		double* direction);
+
+// line search along direction from W0 satisfying the strong Wolfe conditions
+//     f(W0 + t * d) <= f0 + 1e-4 * t * g0^T d
+//     |g(W0 + t * d)^T d| <= 0.9 * |g0^T d|
+// W is set to W0 + t * d before every call to objective. On success the
+// accepted step t is returned with W, f and gradient at the new point.
+// Returns 0 if no step decreasing the objective was found, in which
+// case W is restored to W0 (f and gradient are then undefined).
+double gmf_lbfgs_line_search(
+		LBFGSObjective objective,
+		void* context,
+		float* W,
+		const float* W0,
+		const double* direction,
+		const double f0,
+		const double g0_dot_d,
+		const double initial_step,
+		const size_t n,
+		double* f,
+		double* gradient);
+
+#endif
@@ -6,6 +6,10 @@
 #include <stdbool.h>
 #include <math.h>
 
+#include "gmf_util.h"
+#include "feature_matrix.h"
+#include "regularization.h"
+
 // forward declaration
 typedef struct Matrix Matrix;
 
@@ -13,7 +17,12 @@ typedef enum LinearModelType
 {
 	CLASSIC, // train on full data set each iteration
 	BATCH, // train on sampled data set each iteration
-	STOCHASTIC // train on single point each iteration
+	STOCHASTIC, // train on single point each iteration
+	HOGWILD, // STOCHASTIC on n_threads threads sharing W without locks
+	CHOLESKY, // squared loss only - solve the normal equations directly
+	NEWTON, // cross entropy loss only - Newton's method (IRLS)
+	LBFGS, // smooth losses - quasi-Newton on the full data set each iteration
+	COORDINATE_DESCENT // squared loss only - one weight at a time, exact zeros with L1/elastic net
 } LinearModelType;
 
 typedef struct LinearModelParams
@@ -26,11 +35,110 @@ typedef struct LinearModelParams
 	size_t batch_size;
 	float huber_delta;
 	float sigmoid_threshold;
+	size_t n_threads; // threads used to compute the CLASSIC/BATCH gradient
+	size_t loss_check_interval; // iterations (per thread for HOGWILD) between loss/early stop checks (0 = 100 for STOCHASTIC/HOGWILD, otherwise 1)
+	size_t validation_sample_size; // validation rows used per loss check (0 = all)
+	float momentum; // gmf_optimizer_momentum/nesterov
+	float beta1; // gmf_optimizer_adam
+	float beta2; // gmf_optimizer_adam/rmsprop
+	float epsilon; // gmf_optimizer_adagrad/rmsprop/adam
+	float decay_rate; // gmf_learning_rate_step_decay
+	size_t decay_steps; // gmf_learning_rate_step_decay
+	float min_learning_rate; // gmf_learning_rate_cosine
+	size_t lbfgs_history; // LBFGS - number of curvature pairs kept
+	bool exclude_bias; // COORDINATE_DESCENT and proximal regularization - don't regularize the bias (column 0)
+	uint64_t random_seed; // seed of the initial weights and sampling (0 = drawn from rand())
 	float* class_weights;
 	size_t* class_pair;
 	float* regularization_params;
 } LinearModelParams;
 
+// slice of the (shuffled) rows that a single SGD thread walks through.
+// STOCHASTIC uses one shard and HOGWILD uses one per thread.
+typedef struct LinearModelShard
+{
+	size_t row_start; // first entry of row_idx owned by this shard
+	size_t n_rows; // number of entries of row_idx owned by this shard
+	size_t epoch_position; // position of the next sample in this shard
+	RandomState random_state; // used to shuffle this shard every epoch
+	double loss; // summed loss of the last n_loss_samples samples of the last window
+	size_t n_loss_samples; // number of samples of the last window that computed their loss
+} LinearModelShard;
+
+// state kept by the optimizer between weight updates, see optimizers.h
+typedef struct LinearModelOptimizerState
+{
+	size_t n_weights;
+	size_t step; // number of updates since the start of fit()
+	float* velocity; // (n_weights) momentum / first moment
+	float* accumulator; // (n_weights) (average) squared gradient
+} LinearModelOptimizerState;
+
+// buffers used while training. These are allocated once and
+// reused every iteration so fit() doesn't touch the heap after warm-up.
+typedef struct LinearModelWorkspace
+{
+	size_t n_rows; // rows in the training data
+	size_t n_columns; // columns in the training data
+	size_t n_sample_rows; // rows used per iteration (n_rows, batch_size or 1)
+	size_t row_capacity; // rows row_idx (and cd_residual) were allocated for, at least n_rows
+	size_t sample_capacity; // rows Yhat, X_sample and Y_sample were allocated for, at least n_sample_rows
+	Matrix* Yhat; // (n_sample_rows, 1)
+	Matrix* X_sample; // (n_sample_rows, n_columns) - only allocated for custom (unfused) functions
+	Matrix* Y_sample; // (n_sample_rows, 1) - only allocated for custom (unfused) functions
+	Matrix* loss_gradient; // (n_columns, 1)
+	size_t* row_idx; // permutation of [0, n_rows) used for sampling - BATCH, STOCHASTIC and HOGWILD only
+	size_t epoch_position; // position of the next sample in row_idx
+	RandomState random_state; // used to shuffle row_idx every epoch
+	size_t n_threads; // size of thread_pool
+	ThreadPool* thread_pool; // NULL if n_threads <= 1
+	size_t n_chunks; // number of fixed size row chunks per iteration - CLASSIC, BATCH and LBFGS only
+	size_t chunk_rows; // rows per chunk, GMF_FIT_CHUNK_ROWS or more for FEATURES_CSR (set by fit()) - CLASSIC, BATCH and LBFGS only
+	float* partial_gradients; // (n_chunks, n_columns) per-chunk gradients - CLASSIC, BATCH and LBFGS only
+	double* partial_losses; // (n_chunks) per-chunk losses - CLASSIC, BATCH and LBFGS only
+	size_t n_shards; // STOCHASTIC and HOGWILD only
+	LinearModelShard* shards; // (n_shards) - STOCHASTIC and HOGWILD only
+	LinearModelOptimizerState optimizer_state;
+	LazyRegularization lazy_regularization; // deferred L1/L2/elastic net of sparse STOCHASTIC and BATCH, allocated on first use
+	size_t n_solver_partials; // CHOLESKY and NEWTON only
+	double* solver_partials; // (n_solver_partials, n_columns * (n_columns + 1 + GMF_SOLVER_ROW_BLOCK)) per-thread X^T S X, rhs and rows - CHOLESKY and NEWTON only
+	double* solver_losses; // (n_solver_partials) - CHOLESKY and NEWTON only
+	double* solver_factor; // (n_columns, n_columns) Cholesky factor - CHOLESKY and NEWTON only
+	double* solver_step; // (n_columns) solution of the system - CHOLESKY and NEWTON only
+	float* solver_W; // (n_columns) weights before the Newton step - NEWTON and LBFGS only
+	size_t lbfgs_history; // LBFGS only
+	double* lbfgs_s; // (lbfgs_history, n_columns) weight differences - LBFGS only
+	double* lbfgs_y; // (lbfgs_history, n_columns) gradient differences - LBFGS only
+	double* lbfgs_rho; // (lbfgs_history) 1 / s^T y - LBFGS only
+	double* lbfgs_alpha; // (lbfgs_history) - LBFGS only
+	double* lbfgs_gradient; // (n_columns) gradient at W - LBFGS only
+	double* lbfgs_previous_gradient; // (n_columns) gradient before the line search - LBFGS only
+	double* lbfgs_direction; // (n_columns) - LBFGS only
+	float* cd_X_columns; // (cd_capacity) column-major copy of the (non-zero) values of X - COORDINATE_DESCENT only
+	uint32_t* cd_row_idx; // (cd_capacity) row of every value of cd_X_columns, NULL for a dense X - COORDINATE_DESCENT only
+	size_t* cd_column_ptr; // (n_columns + 1) offset of every column into cd_X_columns - COORDINATE_DESCENT only
+	size_t cd_capacity; // values cd_X_columns has room for, sized by the X of the last fit() - COORDINATE_DESCENT only
+	double* cd_column_norms; // (n_columns) squared norm of every column - COORDINATE_DESCENT only
+	double* cd_residual; // (n_rows) Y - XW - COORDINATE_DESCENT only
+	size_t* cd_columns; // (n_columns) every column index - COORDINATE_DESCENT only
+	size_t* cd_active; // (n_columns) columns with non-zero weights - COORDINATE_DESCENT only
+	size_t n_validation_rows; // validation rows used per loss check - validation data only
+	size_t* validation_idx; // (n_validation_rows) fixed subsample of the validation rows, NULL if all are used - validation data only
+	Matrix* validation_X_sample; // (n_validation_rows, n_columns) - only allocated for custom (unfused) functions with a subsample
+	Matrix* validation_Y_sample; // (n_validation_rows, 1) - only allocated for custom (unfused) functions with a subsample
+	Matrix* validation_Yhat; // (n_validation_rows, 1) - only allocated for custom (unfused) functions
+	float* best_W; // (n_columns) weights with the lowest validation loss - validation data only
+} LinearModelWorkspace;
+
+// training state kept between gmf_model_linear_partial_fit() calls
+typedef struct LinearModelPartialState
+{
+	LinearModelWorkspace* workspace; // owned - used (with its optimizer state) unless the model has a workspace of its own
+	RandomState random_state; // shuffles the rows of every chunk
+	size_t n_updates; // weight updates so far, the iteration passed to the learning rate schedule
+	size_t n_rows_seen; // rows trained on so far
+} LinearModelPartialState;
+
 typedef struct LinearModel LinearModel;
 typedef struct LinearModel
 {
@@ -41,6 +149,14 @@ typedef struct LinearModel
 	void (*loss_gradient)(const Matrix*, const Matrix*, const Matrix*, const LinearModel*, Matrix**);
 	float (*regularization)(const float*, const Matrix*);
 	float (*regularization_gradient)(const float*, const Matrix*);
+	float (*fused_loss_gradient)(const Matrix*, const Matrix*, const LinearModel*, Matrix**); // optional - see fused_losses.h
+	void (*optimizer)(Matrix**, const Matrix*, const float, const LinearModel*, LinearModelOptimizerState*); // see optimizers.h
+	float (*learning_rate_schedule)(const LinearModel*, const size_t); // see optimizers.h
+	LinearModelWorkspace* workspace; // optional - NOT owned by the model, see gmf_model_linear_set_workspace()
+	const Matrix* validation_X; // optional - NOT owned by the model, see gmf_model_linear_set_validation()
+	const Matrix* validation_Y; // optional - NOT owned by the model, see gmf_model_linear_set_validation()
+	LinearModelPartialState* partial; // set by gmf_model_linear_partial_fit() - NULL until then and after fit()
+	bool stopped_early; // set by fit() - true if training stopped before n_iterations (no improvement for early_stop_iterations or the solver converged)
 } LinearModel;
 
 // initialize new linear model by passing address of (NULL) pointer 
@@ -60,12 +176,79 @@ void gmf_model_linear_fit(
 	const Matrix* Y,
 	const bool verbose);
 
+// same as gmf_model_linear_fit() with X stored as a FeatureMatrix, e.g. in half
+// precision (see feature_matrix.h) which halves the memory used by X and the
+// bytes read every pass. Rows are converted to float on the fly and every sum
+// is still accumulated in float (double for CHOLESKY/NEWTON). X must already
+// contain the bias column. X can be a row view (see gmf_features_rows()) to
+// train on a subset of the rows without copying them. A FEATURES_CSR X is
+// trained with sparse kernels (X * W and X^T r only touch non-zero values) in
+// every model type; CHOLESKY and NEWTON still build a dense (c, c) system.
+// Custom functions convert sampled rows (all of X once for CLASSIC and LBFGS)
+// to float matrices.
+void gmf_model_linear_fit_features(
+	LinearModel** lm,
+	const FeatureMatrix* X,
+	const Matrix* Y,
+	const bool verbose);
+
+// one more pass over a chunk of training data (X with the bias column, see
+// gmf_model_linear_fit_features()) that continues where the last call left off:
+// W, the optimizer state (e.g. adam moments) and the learning rate schedule
+// are kept between calls, so a data set can be trained on one chunk at a time.
+// The first call starts from the W of a previous fit() (if the columns match)
+// or random weights. CLASSIC takes one step on the whole chunk, BATCH one step
+// per batch_size rows and STOCHASTIC one step per row, visiting the rows of the
+// chunk in a random order. The learning rate schedule gets the number of weight
+// updates since the first call. There is no early stopping (and validation data
+// isn't used). Requires the built-in activations and losses.
+// Returns the average loss (without regularization) of the rows of the chunk,
+// each computed just before the step that uses it.
+float gmf_model_linear_partial_fit_features(
+	LinearModel** lm,
+	const FeatureMatrix* X,
+	const Matrix* Y);
+
+// out-of-core training: gmf_model_linear_partial_fit_features() on every chunk
+// of data, n_epochs times (data->reset() is called between epochs). Only one
+// chunk is in memory at a time and training continues across calls, so more
+// epochs (or new data) can be added later. fit() starts over from scratch.
+void gmf_model_linear_partial_fit(
+	LinearModel** lm,
+	DataIterator* data,
+	const size_t n_epochs,
+	const bool verbose);
+
+// fit a COORDINATE_DESCENT model for every lambda (regularization_params[0])
+// of a decreasing grid. Every fit is warm started from the previous solution,
+// which is much cheaper than fitting each lambda from scratch.
+// If lambdas is NULL, n_lambdas values are spaced logarithmically from the
+// smallest lambda where every (penalized) weight is zero down to 0.001 times that.
+// The weights of fit i are stored in column i of path - (c, n_lambdas) where c
+// is the number of columns in X. path is allocated if it's NULL.
+// Afterwards W (and regularization_params[0]) belong to the last lambda.
+// Requires gmf_regularization_L1 or gmf_regularization_elastic_net.
+void gmf_model_linear_fit_path(
+	LinearModel** lm,
+	const Matrix* X,
+	const Matrix* Y,
+	const float* lambdas,
+	const size_t n_lambdas,
+	Matrix** path,
+	const bool verbose);
+
 // Take data X and make predictions using linear model.
 // Predictions are allocated and returned as new matrix.
 Matrix* gmf_model_linear_predict(
 	const LinearModel* lm,
 	const Matrix* X);
 
+// Take data X stored as a FeatureMatrix (see gmf_model_linear_fit_features())
+// and make predictions using linear model. Predictions are allocated and returned as new matrix.
+Matrix* gmf_model_linear_predict_features(
+	const LinearModel* lm,
+	const FeatureMatrix* X);
+
 // Take data X and make predictions using linear model.
 // Predictions are stored into Yhat and is assumed to be allocated to the correct size beforehand.
 void gmf_model_linear_predict_inplace(
@@ -73,10 +256,44 @@ void gmf_model_linear_predict_inplace(
 	const Matrix* X,
 	Matrix** Yhat);
 
+// Batch prediction engine behind the other predict functions. Writes the
+// X->n_rows predictions of X into the caller owned yhat (X->n_rows floats)
+// without allocating anything (except a small tile buffer per task for
+// reduced precision features). X*W is computed in cache sized blocks with
+// the activation applied to every block right after it's computed (FEATURES_CSR
+// rows only read their non-zero values). Rows are
+// split over thread_pool (see gmf_util_thread_pool_init()) if it isn't NULL,
+// so the same pool can be reused for every batch.
+void gmf_model_linear_predict_batch(
+	const LinearModel* lm,
+	const FeatureMatrix* X,
+	float* yhat,
+	ThreadPool* thread_pool);
+
 // cleanup memory
 void gmf_model_linear_free(
 	LinearModel** lm);
 
+// allocate every buffer fit() needs to train lm on an (n_rows, n_columns) data set.
+// The buffer sizes depend on model_type and batch_size so set those beforehand.
+LinearModelWorkspace* gmf_model_linear_workspace_init(
+	const LinearModel* lm,
+	const size_t n_rows,
+	const size_t n_columns);
+
+// cleanup workspace memory
+void gmf_model_linear_workspace_free(
+	LinearModelWorkspace** workspace);
+
+// use a caller-owned workspace for every subsequent fit() so repeated
+// training (e.g. in a long running service) never allocates. If the
+// shape of the data changes, fit() resizes the workspace buffers.
+// The workspace is NOT free'd by gmf_model_linear_free(). Pass NULL to
+// go back to allocating a workspace once per fit().
+void gmf_model_linear_set_workspace(
+	LinearModel** lm,
+	LinearModelWorkspace* workspace);
+
 // set n_iterations parameter
 void gmf_model_linear_set_iterations(
 	LinearModel** lm,
@@ -107,12 +324,44 @@ void gmf_model_linear_set_batch_size(
 	LinearModel** lm,
 	const size_t batch_size);
 
+// set n_threads parameter. CLASSIC/BATCH training splits the rows into fixed
+// size chunks and reduces the per-chunk gradients in a fixed order so
+// the trained weights are identical for any number of threads.
+void gmf_model_linear_set_threads(
+	LinearModel** lm,
+	const size_t n_threads);
+
 // pass an array of regularization params and store a copy
 void gmf_model_linear_set_regularization_params(
 	LinearModel** lm,
 	const float* regularization_params,
 	const size_t n);
 
+// set loss_check_interval parameter. The loss (and early stopping criteria) is only
+// checked every loss_check_interval iterations. Custom (unfused) functions skip
+// computing the training loss in between. 0 picks 100 samples for STOCHASTIC/HOGWILD
+// and every iteration for the others. HOGWILD threads each run loss_check_interval
+// samples between checks.
+void gmf_model_linear_set_loss_check_interval(
+	LinearModel** lm,
+	const size_t loss_check_interval);
+
+// use validation data (with the bias column, same columns as X) for early stopping.
+// Every loss check computes the validation loss instead of the training loss and
+// the weights with the lowest validation loss are restored at the end of fit().
+// Only used by the iterative model types (CLASSIC, BATCH, STOCHASTIC, HOGWILD and LBFGS).
+// The data is NOT copied or owned by the model. Pass NULL to stop using validation data.
+void gmf_model_linear_set_validation(
+	LinearModel** lm,
+	const Matrix* validation_X,
+	const Matrix* validation_Y);
+
+// set validation_sample_size parameter. Every loss check estimates the validation
+// loss on the same random subsample of validation_sample_size rows (drawn once per fit())
+void gmf_model_linear_set_validation_sample_size(
+	LinearModel** lm,
+	const size_t validation_sample_size);
+
 // set activation function
 void gmf_model_linear_set_activation(
 	LinearModel** lm,
@@ -138,6 +387,82 @@ void gmf_model_linear_set_regularization_gradient(
 	LinearModel** lm,
 	float (*regularization_gradient)(const float*, const Matrix*));
 
+// set fused loss + loss gradient function (single pass over X).
+// If this isn't set, fit() picks the matching built-in gmf_fused_loss_...
+// automatically when the activation, loss and loss gradient are all built-in.
+void gmf_model_linear_set_fused_loss_gradient(
+	LinearModel** lm,
+	float (*fused_loss_gradient)(const Matrix*, const Matrix*, const LinearModel*, Matrix**));
+
+// set optimizer used to update the weights (default gmf_optimizer_sgd).
+// STOCHASTIC training with gmf_optimizer_sgd and the built-in functions
+// updates the weights inplace while walking the rows, any other optimizer
+// updates them through the gradient one sample at a time.
+// HOGWILD only supports gmf_optimizer_sgd.
+void gmf_model_linear_set_optimizer(
+	LinearModel** lm,
+	void (*optimizer)(Matrix**, const Matrix*, const float, const LinearModel*, LinearModelOptimizerState*));
+
+// set learning rate schedule (default gmf_learning_rate_constant).
+// STOCHASTIC/HOGWILD training with the built-in functions only updates
+// the learning rate every loss_check_interval samples.
+void gmf_model_linear_set_learning_rate_schedule(
+	LinearModel** lm,
+	float (*learning_rate_schedule)(const LinearModel*, const size_t));
+
+// set momentum parameter for gmf_optimizer_momentum/nesterov
+void gmf_model_linear_set_momentum(
+	LinearModel** lm,
+	const float momentum);
+
+// set beta1 parameter (decay of the first moment) for gmf_optimizer_adam
+void gmf_model_linear_set_beta1(
+	LinearModel** lm,
+	const float beta1);
+
+// set beta2 parameter (decay of the squared gradient average) for gmf_optimizer_adam/rmsprop
+void gmf_model_linear_set_beta2(
+	LinearModel** lm,
+	const float beta2);
+
+// set epsilon parameter (added to the denominator) for gmf_optimizer_adagrad/rmsprop/adam
+void gmf_model_linear_set_epsilon(
+	LinearModel** lm,
+	const float epsilon);
+
+// set decay_rate and decay_steps parameters for gmf_learning_rate_step_decay.
+// The learning rate is multiplied by decay_rate every decay_steps iterations.
+void gmf_model_linear_set_step_decay(
+	LinearModel** lm,
+	const float decay_rate,
+	const size_t decay_steps);
+
+// set min_learning_rate parameter for gmf_learning_rate_cosine
+void gmf_model_linear_set_min_learning_rate(
+	LinearModel** lm,
+	const float min_learning_rate);
+
+// set lbfgs_history parameter - number of curvature pairs LBFGS
+// uses to approximate the hessian (typically 5 - 20)
+void gmf_model_linear_set_lbfgs_history(
+	LinearModel** lm,
+	const size_t lbfgs_history);
+
+// set exclude_bias parameter. If true, COORDINATE_DESCENT and the proximal
+// steps of L1/L2/elastic net (see gmf_regularization_is_proximal()) don't
+// regularize the bias (column 0, see gmf_util_add_bias())
+void gmf_model_linear_set_exclude_bias(
+	LinearModel** lm,
+	const bool exclude_bias);
+
+// set random_seed parameter. Every random draw of fit() (initial weights,
+// sampling, shuffling) comes from a stream seeded with it, so a model trains
+// the same way no matter what else uses rand(). 0 (default) draws the seed
+// from rand() at the start of every fit().
+void gmf_model_linear_set_random_seed(
+	LinearModel** lm,
+	const uint64_t random_seed);
+
 // set huber delta if using huber loss function
 void gmf_model_linear_set_huber_delta(
 		LinearModel** lm,
@@ -15,26 +15,53 @@
 // forward declaration
 typedef struct Matrix Matrix;
 
+// how the classes are split into binary submodels
+typedef enum OVRStrategy
+{
+	OVR_ONE_VS_ONE, // a submodel for every pair of classes (n_classes choose 2), predictions by majority vote
+	OVR_ONE_VS_REST // a submodel for every class against all the others (n_classes), predictions by highest score
+} OVRStrategy;
+
 typedef struct LinearModelOVR
 {
 	LinearModel** models; // OVR is a collection of models with different paired labels
 	size_t n_models;
 	size_t n_classes;
-	size_t (*class_pairs)[2]; // pairs of [0, 1], [0, 2], [1, 2] etc. class labels per linear model
+	OVRStrategy strategy;
+	size_t (*class_pairs)[2]; // pairs of [0, 1], [0, 2], [1, 2] etc. class labels per linear model ([m, m] for OVR_ONE_VS_REST)
 	float* class_weights; // weights for each class in order [0, 1, 2, ...]. Higher the value, more importance is given.
+	float (*binary_weights)[2]; // OVR_ONE_VS_REST only: [rest, class] weights of every submodel - set during fit()
+	size_t n_model_threads; // number of submodels trained at the same time
+	uint64_t random_seed; // seed of the submodels' random streams (0 = drawn from rand() every fit)
+	Matrix* W; // (c, n_models) weights of every submodel, one column per model - set during fit() and used to predict
 } LinearModelOVR;
 
-// initialize new linear model by passing address of (NULL) pointer 
+// initialize new (OVR_ONE_VS_ONE) linear model by passing address of (NULL) pointer 
 void gmf_model_linear_ovr_init_inplace(
 	LinearModelOVR** lm,
 	const size_t n_classes,
 	const float* class_weights);
 
-// initalize new linear model and return a pointer
+// initalize new (OVR_ONE_VS_ONE) linear model and return a pointer
 LinearModelOVR* gmf_model_linear_ovr_init(
 		const size_t n_classes,
 		const float* class_weights);
 
+// initialize new linear model using strategy to split the classes
+// into submodels by passing address of (NULL) pointer
+void gmf_model_linear_ovr_init_strategy_inplace(
+	LinearModelOVR** lm,
+	const size_t n_classes,
+	const float* class_weights,
+	const OVRStrategy strategy);
+
+// initialize new linear model using strategy to split the classes
+// into submodels and return a pointer
+LinearModelOVR* gmf_model_linear_ovr_init_strategy(
+		const size_t n_classes,
+		const float* class_weights,
+		const OVRStrategy strategy);
+
 // train model given actuals: X - (r, c) matrix. Y - (r, 1) matrix.
 // NOTE: a bias term is automatically added to X and stored internally so it becomes an (r+1, c) matrix.
 // Original matrix is *UNTOUCHED* and still must be free'd separately.
@@ -44,7 +71,33 @@ void gmf_model_linear_ovr_fit(
 	const Matrix* Y,
 	const bool verbose);
 
-// Take data X and make predictions using linear model.
+// one more pass over a chunk of training data (X with the bias column) for
+// every submodel, continuing where the last call left off (see
+// gmf_model_linear_partial_fit_features()) and packing the weights afterwards.
+// Without class_weights the submodels are unweighted (fit() derives balanced
+// weights from the whole data set). OVR_ONE_VS_REST derives the [rest, class]
+// weights from the class counts of every chunk. Returns the average loss of
+// the submodels over the rows they were trained on.
+float gmf_model_linear_ovr_partial_fit_features(
+	LinearModelOVR** lm,
+	const FeatureMatrix* X,
+	const Matrix* Y);
+
+// out-of-core training of every submodel on every chunk of data, n_epochs
+// times (see gmf_model_linear_partial_fit())
+void gmf_model_linear_ovr_partial_fit(
+	LinearModelOVR** lm,
+	DataIterator* data,
+	const size_t n_epochs,
+	const bool verbose);
+
+// Take data X and make predictions using linear model. Every submodel scores
+// X with a single blocked matrix product against W. With OVR_ONE_VS_ONE every
+// submodel votes for a class of its pair and the most votes win. With
+// OVR_ONE_VS_REST the class whose submodel gives the highest activation wins
+// (gmf_activation_sigmoid_hard is compared before thresholding).
+// NOTE: predictions use the weights packed into W by fit(). Call
+// gmf_model_linear_ovr_pack_weights() after changing the W of a submodel.
 // Predictions are allocated and returned as new matrix.
 Matrix* gmf_model_linear_ovr_predict(
 	const LinearModelOVR* lm,
@@ -57,6 +110,10 @@ void gmf_model_linear_ovr_predict_inplace(
 	const Matrix* X,
 	Matrix** Yhat);
 
+// copy the weights of every submodel into W (done by fit())
+void gmf_model_linear_ovr_pack_weights(
+	LinearModelOVR** lm);
+
 // cleanup memory
 void gmf_model_linear_ovr_free(
 	LinearModelOVR** lm);
@@ -91,6 +148,37 @@ void gmf_model_linear_ovr_set_batch_size(
 		LinearModelOVR** lm,
 		size_t batch_size);
 
+// set n_threads parameter for all submodels in OVR model
+void gmf_model_linear_ovr_set_threads(
+		LinearModelOVR** lm,
+		size_t n_threads);
+
+// set the number of threads training submodels at the same time (default 1).
+// Submodels are independent so they're handed out largest subset first, and
+// every submodel has its own random stream so the results are the same for
+// any number of threads. NOTE: this multiplies with n_threads of the
+// submodels and verbose output of different submodels may interleave.
+void gmf_model_linear_ovr_set_model_threads(
+		LinearModelOVR** lm,
+		size_t n_model_threads);
+
+// set the seed every submodel's own random stream is derived from (see
+// gmf_model_linear_set_random_seed()). With the default of 0 the streams
+// are derived from a single rand() call.
+void gmf_model_linear_ovr_set_random_seed(
+		LinearModelOVR** lm,
+		uint64_t random_seed);
+
+// set optimizer for all submodels in OVR model
+void gmf_model_linear_ovr_set_optimizer(
+		LinearModelOVR** lm,
+		void (*optimizer)(Matrix**, const Matrix*, const float, const LinearModel*, LinearModelOptimizerState*));
+
+// set learning rate schedule for all submodels in OVR model
+void gmf_model_linear_ovr_set_learning_rate_schedule(
+		LinearModelOVR** lm,
+		float (*learning_rate_schedule)(const LinearModel*, const size_t));
+
 // set activation function for all submodels in OVR model
 void gmf_model_linear_ovr_set_activation(
 		LinearModelOVR** lm,
@@ -0,0 +1,144 @@
+#ifndef LINEAR_MODEL_VEC_H
+#define LINEAR_MODEL_VEC_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "activations.h"
+#include "losses.h"
+#include "loss_gradients.h"
+#include "gmf_util.h"
+#include "linear_model.h"
+
+/*
+ * NOTE:
+ * The vectorized linear model f : R^w -> R^s predicts s outputs at once
+ * with a (w, s) weight matrix. All outputs are trained together: each
+ * iteration computes XW for every output with a single matrix product
+ * and the gradient of every output in the same pass over X.
+ *
+ * With gmf_activation_vec_softmax and gmf_loss_vec_cross_entropy this is
+ * multinomial logistic regression - a single model for any number of
+ * classes instead of the c choose 2 models of LinearModelOVR.
+ */
+
+// forward declaration
+typedef struct Matrix Matrix;
+
+typedef struct LinearModelVecParams
+{
+	size_t n_iterations;
+	float learning_rate;
+	float early_stop_threshold;
+	size_t early_stop_iterations;
+	LinearModelType model_type; // CLASSIC or BATCH only
+	size_t batch_size;
+	size_t n_threads; // threads used to compute the gradient
+} LinearModelVecParams;
+
+typedef struct LinearModelVec LinearModelVec;
+typedef struct LinearModelVec
+{
+	LinearModelVecParams* params;
+	size_t n_outputs; // s - number of outputs (or classes)
+	Matrix* W; // (c, n_outputs) weights, one column per output - set during fit()
+	void (*activation)(Matrix**, const LinearModelVec*);
+	float (*loss)(const Matrix*, const Matrix*, const LinearModelVec*);
+	void (*loss_gradient)(const Matrix*, const Matrix*, const LinearModelVec*, Matrix**);
+} LinearModelVec;
+
+// initialize new vectorized linear model with n_outputs outputs by passing address of (NULL) pointer
+void gmf_model_linear_vec_init_inplace(
+	LinearModelVec** lm,
+	const size_t n_outputs);
+
+// initialize new vectorized linear model with n_outputs outputs and return a pointer
+LinearModelVec* gmf_model_linear_vec_init(
+	const size_t n_outputs);
+
+// train model given actuals: X - (r, c) matrix. Y - (r, n_outputs) matrix
+// or (r, 1) class labels {0, 1, ..., n_outputs - 1} which are one-hot encoded internally.
+// NOTE: a bias term is NOT added automatically, see gmf_util_add_bias().
+void gmf_model_linear_vec_fit(
+	LinearModelVec** lm,
+	const Matrix* X,
+	const Matrix* Y,
+	const bool verbose);
+
+// Take data X and make predictions using linear model.
+// Predictions (r, n_outputs) are allocated and returned as new matrix.
+Matrix* gmf_model_linear_vec_predict(
+	const LinearModelVec* lm,
+	const Matrix* X);
+
+// Take data X and make predictions using linear model.
+// Predictions are stored into Yhat which is assumed to be allocated as (r, n_outputs) beforehand.
+void gmf_model_linear_vec_predict_inplace(
+	const LinearModelVec* lm,
+	const Matrix* X,
+	Matrix** Yhat);
+
+// Take data X and predict the class (output with the highest value) of every row.
+// Classes (r, 1) are allocated and returned as new matrix.
+Matrix* gmf_model_linear_vec_predict_class(
+	const LinearModelVec* lm,
+	const Matrix* X);
+
+// cleanup memory
+void gmf_model_linear_vec_free(
+	LinearModelVec** lm);
+
+// set n_iterations parameter
+void gmf_model_linear_vec_set_iterations(
+	LinearModelVec** lm,
+	const size_t n_iterations);
+
+// set learning_rate parameter
+void gmf_model_linear_vec_set_learning_rate(
+	LinearModelVec** lm,
+	const float learning_rate);
+
+// set early_stop_threshold parameter
+void gmf_model_linear_vec_set_early_stop_threshold(
+	LinearModelVec** lm,
+	const float early_stop_threshold);
+
+// set early_stop_iterations parameter
+void gmf_model_linear_vec_set_early_stop_iterations(
+	LinearModelVec** lm,
+	const size_t early_stop_iterations);
+
+// set model_type parameter (CLASSIC or BATCH)
+void gmf_model_linear_vec_set_model_type(
+	LinearModelVec** lm,
+	const LinearModelType model_type);
+
+// set batch_size parameter
+void gmf_model_linear_vec_set_batch_size(
+	LinearModelVec** lm,
+	const size_t batch_size);
+
+// set n_threads parameter. Rows are split into fixed size chunks
+// so the trained weights are identical for any number of threads.
+void gmf_model_linear_vec_set_threads(
+	LinearModelVec** lm,
+	const size_t n_threads);
+
+// set activation function
+void gmf_model_linear_vec_set_activation(
+	LinearModelVec** lm,
+	void (*activation)(Matrix**, const LinearModelVec*));
+
+// set loss function
+void gmf_model_linear_vec_set_loss(
+	LinearModelVec** lm,
+	float (*loss)(const Matrix*, const Matrix*, const LinearModelVec*));
+
+// set loss gradient function
+void gmf_model_linear_vec_set_loss_gradient(
+	LinearModelVec** lm,
+	void (*loss_gradient)(const Matrix*, const Matrix*, const LinearModelVec*, Matrix**));
+
+#endif
@@ -17,6 +17,7 @@
 // formward declaration
 typedef struct Matrix Matrix;
 typedef struct LinearModel LinearModel;
+typedef struct LinearModelVec LinearModelVec;
 
 // L'(y, yhat) = 2(y - yhat)x
 void gmf_loss_gradient_squared(
@@ -67,4 +68,27 @@ void gmf_loss_gradient_huber(
 		const LinearModel* lm,
 		Matrix** loss_gradient);
 
+/*
+ * Loss gradients of the vectorized model (see linear_model_vec.h).
+ * These only compute the (r, s) gradient with respect to XW into
+ * residual - the model multiplies it with X itself so the gradient
+ * of all outputs is computed in a single pass over X.
+ */
+
+// L'(y, yhat) = -2(y - yhat)
+void gmf_loss_gradient_vec_squared(
+		const Matrix* Y,
+		const Matrix* Yhat,
+		const LinearModelVec* lm,
+		Matrix** residual);
+
+// L'(y, yhat) = yhat - y
+// NOTE: this is the gradient of cross entropy combined with softmax
+// (or sigmoid) with respect to XW.
+void gmf_loss_gradient_vec_cross_entropy(
+		const Matrix* Y,
+		const Matrix* Yhat,
+		const LinearModelVec* lm,
+		Matrix** residual);
+
 #endif
@@ -6,6 +6,7 @@
 // forward declaration
 typedef struct Matrix Matrix;
 typedef struct LinearModel LinearModel;
+typedef struct LinearModelVec LinearModelVec;
 
 // L(y, yhat) = (y - yhat)^2
 float gmf_loss_squared(
@@ -46,4 +47,22 @@ float gmf_loss_huber(
 		const Matrix* Yhat,
 		const LinearModel* lm);
 
+/*
+ * Losses of the vectorized model (see linear_model_vec.h).
+ * Y and Yhat have shape (r, s) and the loss is summed over every output.
+ */
+
+// L(y, yhat) = sum((y_j - yhat_j)^2)
+float gmf_loss_vec_squared(
+		const Matrix* Y,
+		const Matrix* Yhat,
+		const LinearModelVec* lm);
+
+// L(y, yhat) = -sum(y_j * log(yhat_j)) - multinomial cross entropy
+// for one-hot Y and softmax outputs. yhat is kept above 1e-7.
+float gmf_loss_vec_cross_entropy(
+		const Matrix* Y,
+		const Matrix* Yhat,
+		const LinearModelVec* lm);
+
 #endif
@@ -0,0 +1,95 @@
+#ifndef OPTIMIZERS_H
+#define OPTIMIZERS_H
+
+#include <math.h>
+#include <stddef.h>
+
+/*
+ * NOTE:
+ * Optimizers take the (already regularized) loss gradient and
+ * update the weights W inplace. Anything they need to remember
+ * between updates is kept in LinearModelOptimizerState which
+ * is allocated once by the training workspace and reset at the
+ * start of every fit().
+ *
+ * Learning rate schedules return the learning rate to use for
+ * a given iteration (sample for STOCHASTIC/HOGWILD).
+ */
+
+// forward declaration
+typedef struct Matrix Matrix;
+typedef struct LinearModel LinearModel;
+typedef struct LinearModelOptimizerState LinearModelOptimizerState;
+
+// W = W - lr * g
+void gmf_optimizer_sgd(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state);
+
+// v = momentum * v + g
+// W = W - lr * v
+void gmf_optimizer_momentum(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state);
+
+// v = momentum * v + g
+// W = W - lr * (g + momentum * v)
+// NOTE: this is the reformulation of Nesterov momentum that
+// doesn't need the gradient at the look-ahead point W - lr * momentum * v
+void gmf_optimizer_nesterov(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state);
+
+// s = s + g^2
+// W = W - lr * g / (sqrt(s) + epsilon)
+void gmf_optimizer_adagrad(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state);
+
+// s = beta2 * s + (1 - beta2) * g^2
+// W = W - lr * g / (sqrt(s) + epsilon)
+void gmf_optimizer_rmsprop(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state);
+
+// m = beta1 * m + (1 - beta1) * g
+// s = beta2 * s + (1 - beta2) * g^2
+// W = W - lr * (m / (1 - beta1^t)) / (sqrt(s / (1 - beta2^t)) + epsilon)
+void gmf_optimizer_adam(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state);
+
+// lr
+float gmf_learning_rate_constant(
+		const LinearModel* lm,
+		const size_t iteration);
+
+// lr * decay_rate^floor(iteration / decay_steps)
+float gmf_learning_rate_step_decay(
+		const LinearModel* lm,
+		const size_t iteration);
+
+// min_lr + (lr - min_lr) * (1 + cos(pi * iteration / n_iterations)) / 2
+float gmf_learning_rate_cosine(
+		const LinearModel* lm,
+		const size_t iteration);
+
+#endif
@@ -3,10 +3,35 @@
 
 #include <math.h>
 #include <stddef.h>
+#include <stdbool.h>
+
+// lazy regularization flushes every weight once the scale drops below this
+#define GMF_LAZY_MIN_SCALE 1e-30
 
 // forward declaration
 typedef struct Matrix Matrix;
 
+// proximal regularization of sparse SGD that is deferred until a weight is
+// used. Instead of shrinking every weight after every step, the steps are
+// accumulated: scale is the product of the L2 decays 1 / (1 + 2 * step * l2)
+// of every step and shrinkage the sum of the L1 thresholds step * l1 of every
+// step divided by the scale before that step. A weight that wasn't touched
+// since its snapshot (weight_scale, weight_shrinkage) is brought up to date
+// exactly with
+//     |w| = max(|w| / weight_scale - (shrinkage - weight_shrinkage), 0) * scale
+// so a step only costs O(non-zero values of its rows).
+typedef struct LazyRegularization
+{
+	float l1; // L1 strength (params[0] or params[0] * params[1] for elastic net)
+	float l2; // L2 strength
+	size_t first; // weights before first aren't regularized (exclude_bias)
+	double scale;
+	double shrinkage;
+	size_t n_weights;
+	double* weight_scale; // (n_weights) scale when each weight was last brought up to date
+	double* weight_shrinkage; // (n_weights) shrinkage when each weight was last brought up to date
+} LazyRegularization;
+
 // params[0] * sum(|w_i|)
 float gmf_regularization_L1(const float* params, const Matrix* W);
 
@@ -16,4 +41,56 @@ float gmf_regularization_L2(const float* params, const Matrix* W);
 // params[0] * sum((w_i)^params[1])
 float gmf_regularization_LN(const float* params, const Matrix* W);
 
+// params[0] * (params[1] * sum(|w_i|) + (1 - params[1]) * sum((w_i)^2))
+// params[1] is the L1 ratio in [0, 1] (1 = L1, 0 = L2)
+float gmf_regularization_elastic_net(const float* params, const Matrix* W);
+
+// true if regularization is applied with gmf_regularization_proximal()
+// while training (L1, L2 and elastic net) instead of its gradient function
+bool gmf_regularization_is_proximal(float (*regularization)(const float*, const Matrix*));
+
+// proximal step of regularization for a gradient step of size step, applied
+// inplace to W[first], ..., W[n - 1] (first = 1 leaves the bias alone):
+// * L1 soft thresholds: w = sign(w) * max(|w| - step * params[0], 0) so weights become exactly zero
+// * L2 decays: w = w / (1 + 2 * step * params[0])
+// * elastic net soft thresholds by the L1 share and decays by the L2 share
+void gmf_regularization_proximal(
+		float (*regularization)(const float*, const Matrix*),
+		const float* params,
+		const float step,
+		const size_t first,
+		float* W,
+		const size_t n);
+
+// start deferring the proximal regularization (see gmf_regularization_is_proximal())
+// of n_weights weights. The buffers are reused if lazy already has n_weights
+// weights, so lazy must be zero initialized before the first call.
+void gmf_regularization_lazy_init(
+		LazyRegularization* lazy,
+		float (*regularization)(const float*, const Matrix*),
+		const float* params,
+		const size_t first,
+		const size_t n_weights);
+
+// cleanup LazyRegularization buffers
+void gmf_regularization_lazy_free(LazyRegularization* lazy);
+
+// apply every step deferred since W[i] was last used. Call it
+// before reading W[i] (e.g. for every non-zero column of a row).
+void gmf_regularization_lazy_update(
+		LazyRegularization* lazy,
+		const size_t i,
+		float* W);
+
+// defer the proximal step of a gradient step of size step (O(1))
+void gmf_regularization_lazy_step(
+		LazyRegularization* lazy,
+		const float step,
+		float* W);
+
+// bring every weight up to date (O(n_weights)), e.g. before W is read as a whole
+void gmf_regularization_lazy_flush(
+		LazyRegularization* lazy,
+		float* W);
+
 #endif
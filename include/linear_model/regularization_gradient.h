@@ -7,7 +7,7 @@
 // forward declaration
 typedef struct Matrix Matrix;
 
-// params[0] * sum(w_i / |w_i|)
+// params[0] * sum(sign(w_i)) where sign(0) = 0
 float gmf_regularization_gradient_L1(const float* params, const Matrix* W);
 
 // params[0] * 2 * sum(w_i)
@@ -16,4 +16,18 @@ float gmf_regularization_gradient_L2(const float* params, const Matrix* W);
 // params[0] * params[1] * sum(w_i)
 float gmf_regularization_gradient_LN(const float* params, const Matrix* W);
 
+// params[0] * (params[1] * sum(sign(w_i)) + (1 - params[1]) * 2 * sum(w_i)) where sign(0) = 0
+float gmf_regularization_gradient_elastic_net(const float* params, const Matrix* W);
+
+// gradient[i] += d/dw_i of the proximal regularization (see gmf_regularization_is_proximal())
+// for i in [first, n) where sign(0) = 0 for the L1 part. Used by LBFGS and the
+// optimizers other than gmf_optimizer_sgd, which can't take proximal steps.
+void gmf_regularization_gradient_weights(
+		float (*regularization)(const float*, const Matrix*),
+		const float* params,
+		const size_t first,
+		const float* W,
+		const size_t n,
+		float* gradient);
+
 #endif
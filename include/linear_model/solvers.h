@@ -0,0 +1,60 @@
+#ifndef SOLVERS_H
+#define SOLVERS_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * NOTE:
+ * Direct solvers used by the CHOLESKY and NEWTON model types.
+ * Both reduce training to (a few) linear systems
+ *
+ *     (X^T S X + 2 * lambda * I) * step = rhs
+ *
+ * where S is a diagonal matrix of per-row weights. The systems
+ * are accumulated and solved in double precision. Matrices are
+ * dense, row-major (n, n) arrays and only the lower triangle is
+ * ever read or written.
+ */
+
+// rows accumulated into the system at once - every pass over
+// the (n_columns, n_columns) system adds this many rows
+#define GMF_SOLVER_ROW_BLOCK 4
+
+// forward declaration
+typedef struct Matrix Matrix;
+typedef struct FeatureMatrix FeatureMatrix;
+typedef struct LinearModel LinearModel;
+
+// accumulate the system for rows [row_start, row_end) of X into gram (n_columns, n_columns)
+// and rhs (n_columns). rows is scratch space of GMF_SOLVER_ROW_BLOCK * n_columns doubles.
+// CHOLESKY (squared loss):       gram += x^T x,             rhs += y * x,        returns sum(y^2)
+// NEWTON (cross entropy loss):   gram += c * p(1 - p) x^T x, rhs += c * (p - y) x, returns the loss
+// where p = sigmoid(x * W) and c is the class weight of y (1 without class weights).
+// Nothing is cleared beforehand so a system can be accumulated over several calls.
+double gmf_solver_accumulate(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		const size_t row_start,
+		const size_t row_end,
+		double* gram,
+		double* rhs,
+		double* rows);
+
+// in place (blocked) Cholesky factorization A = L * L^T of the
+// symmetric positive definite (n, n) matrix A. The lower triangle
+// of A is replaced by L. Returns false if A isn't positive definite.
+bool gmf_solver_cholesky(
+		double* A,
+		const size_t n);
+
+// solve L * L^T * x = b for x given the factorization from
+// gmf_solver_cholesky(). b is overwritten with x.
+void gmf_solver_cholesky_solve(
+		const double* L,
+		double* b,
+		const size_t n);
+
+#endif
@@ -6,13 +6,23 @@
 
 #include "linear_model.h"
 #include "linear_model_ovr.h"
+#include "linear_model_vec.h"
 #include "activations.h"
 #include "losses.h"
+#include "kernels.h"
 #include "loss_gradients.h"
+#include "fused_losses.h"
+#include "optimizers.h"
+#include "solvers.h"
+#include "lbfgs.h"
+#include "coordinate_descent.h"
 #include "regularization.h"
 #include "regularization_gradient.h"
 #include "matrix.h"
 #include "metrics.h"
 #include "gmf_util.h"
+#include "feature_matrix.h"
+#include "feature_hasher.h"
+#include "dataset.h"
 
 #endif
@@ -2,6 +2,7 @@
 #define KNN_H
 
 #include "distances.h"
+#include "feature_matrix.h"
 #include <stddef.h>
 #include <stdlib.h>
 
@@ -20,13 +21,15 @@ typedef struct KNNParams
 {
 	float (*distance)(const Vector*, const Vector*);
 	size_t n_neighbors;
+	FeatureType feature_type; // storage of the training data, see feature_matrix.h
 } KNNParams;
 
 typedef struct KNN
 {
 	KNNParams* params;
 	KNNType type;
-	Matrix* X;
+	Matrix* X; // NULL unless feature_type is FEATURES_F32
+	FeatureMatrix* features; // training data in reduced precision - NULL if feature_type is FEATURES_F32
 	Matrix* Y;
 } KNN;
 
@@ -48,12 +51,26 @@ void gmf_model_knn_set_neighbors(
 		KNN** knn,
 		const size_t n_neighbors);
 
+// set feature_type parameter. FEATURES_F16/FEATURES_BF16 store the training
+// data in half precision (half the memory) and convert it on the fly in predict
+void gmf_model_knn_set_feature_type(
+		KNN** knn,
+		const FeatureType feature_type);
+
 // fit KNN model
 void gmf_model_knn_fit(
 		KNN** knn, 
 		const Matrix* X, 
 		const Matrix* Y);
 
+// fit KNN model on X without copying it (any FeatureType, e.g. a view of a
+// memory mapped dataset, see dataset.h). X must stay valid as long as the
+// model is used. Y is copied.
+void gmf_model_knn_fit_features(
+		KNN** knn, 
+		const FeatureMatrix* X, 
+		const Matrix* Y);
+
 // find nearest neighbors
 Matrix* gmf_model_knn_predict(
 		const KNN* knn, 
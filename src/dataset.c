@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "matrix.h"
+#include "feature_matrix.h"
+#include "dataset.h"
+
+// the header is exactly one aligned block
+typedef char __dataset_header_size[sizeof(DatasetHeader) == GMF_DATASET_ALIGNMENT ? 1 : -1];
+
+static void err(const char* msg)
+{
+	printf("%s\n", msg);
+	exit(-1);
+}
+
+static size_t __align(const size_t bytes)
+{
+	return (bytes + GMF_DATASET_ALIGNMENT - 1) / GMF_DATASET_ALIGNMENT * GMF_DATASET_ALIGNMENT;
+}
+
+// *result = a * b, false if it overflows
+static bool __multiply(const uint64_t a, const uint64_t b, size_t* result)
+{
+	if (a > SIZE_MAX || b > SIZE_MAX || (a != 0 && b > SIZE_MAX / a))
+		return false;
+	*result = (size_t)(a * b);
+	return true;
+}
+
+// bytes [offset, offset + bytes) are inside a file of file_size bytes
+static bool __inside(const uint64_t offset, const size_t bytes, const size_t file_size)
+{
+	return bytes <= file_size && offset <= file_size - bytes;
+}
+
+// bytes per stored feature value
+static size_t __value_size(const FeatureType type)
+{
+	switch (type)
+	{
+		case FEATURES_F32:
+			return sizeof(float);
+		case FEATURES_F16:
+		case FEATURES_BF16:
+			return sizeof(uint16_t);
+		default:
+			err("Datasets store FEATURES_F32, FEATURES_F16 or FEATURES_BF16 features.");
+	}
+	return 0;
+}
+
+static void __write(FILE* file, const void* data, const size_t bytes)
+{
+	if (bytes > 0 && fwrite(data, 1, bytes, file) != bytes)
+		err("Couldn't write dataset file.");
+}
+
+// zeros up to the next multiple of GMF_DATASET_ALIGNMENT
+static void __write_padding(FILE* file, const size_t bytes_written)
+{
+	static const char zeros[GMF_DATASET_ALIGNMENT] = { 0 };
+	__write(file, zeros, __align(bytes_written) - bytes_written);
+}
+
+static DatasetHeader __header(
+	const size_t n_columns,
+	const FeatureType type,
+	const DatasetLayout layout,
+	const bool has_labels)
+{
+	DatasetHeader header;
+	memset(&header, 0, sizeof(DatasetHeader));
+	memcpy(header.magic, GMF_DATASET_MAGIC, sizeof(GMF_DATASET_MAGIC));
+	header.version = GMF_DATASET_VERSION;
+	header.type = (uint32_t)type;
+	header.layout = (uint32_t)layout;
+	header.has_labels = has_labels ? 1 : 0;
+	header.n_columns = n_columns;
+	header.features_offset = sizeof(DatasetHeader);
+
+	return header;
+}
+
+DatasetWriter* gmf_dataset_writer_init(
+		const char* path,
+		const size_t n_columns,
+		const FeatureType type,
+		const bool has_labels)
+{
+	__value_size(type);
+
+	DatasetWriter* writer = malloc(sizeof(DatasetWriter));
+	if (!writer)
+		err("Couldn't allocate memory for DatasetWriter.");
+
+	writer->file = fopen(path, "wb");
+	if (!writer->file)
+		err("Couldn't open dataset file for writing.");
+	writer->header = __header(n_columns, type, DATASET_ROWS, has_labels);
+	writer->row = gmf_features_alloc(1, n_columns, type);
+	writer->labels = NULL;
+	if (has_labels)
+	{
+		writer->labels = tmpfile();
+		if (!writer->labels)
+			err("Couldn't open temporary file for the dataset labels.");
+	}
+
+	// the final header is written by gmf_dataset_writer_close()
+	__write(writer->file, &writer->header, sizeof(DatasetHeader));
+
+	return writer;
+}
+
+void gmf_dataset_writer_append(
+		DatasetWriter* writer,
+		const Matrix* X,
+		const Matrix* Y)
+{
+	const size_t n_columns = writer->header.n_columns;
+	if (X->n_columns != n_columns)
+		err("Every block of a dataset needs the same number of columns.");
+	if (writer->header.has_labels && (!Y || Y->n_rows != X->n_rows))
+		err("Every row of a dataset with labels needs a label.");
+
+	if (writer->labels)
+		__write(writer->labels, Y->data, X->n_rows * sizeof(float));
+
+	// float rows are written as is, reduced precision rows are converted one at a time
+	const FeatureType type = (FeatureType)writer->header.type;
+	const size_t row_bytes = n_columns * __value_size(type);
+	if (type == FEATURES_F32)
+		__write(writer->file, X->data, X->n_rows * row_bytes);
+	else
+		for (size_t r = 0; r < X->n_rows; ++r)
+		{
+			gmf_features_set_row(writer->row, 0, X->data + r * n_columns);
+			__write(writer->file, writer->row->data, row_bytes);
+		}
+
+	writer->header.n_rows += X->n_rows;
+}
+
+void gmf_dataset_writer_close(DatasetWriter** writer)
+{
+	DatasetHeader* header = &(*writer)->header;
+	const size_t features_end = (size_t)header->features_offset
+		+ (size_t)(header->n_rows * header->n_columns) * __value_size((FeatureType)header->type);
+
+	if ((*writer)->labels)
+	{
+		__write_padding((*writer)->file, features_end);
+		header->labels_offset = __align(features_end);
+
+		// copy the labels over in blocks
+		float block[1024];
+		size_t n_read = 0;
+		if (fseek((*writer)->labels, 0, SEEK_SET) != 0)
+			err("Couldn't read temporary file of the dataset labels.");
+		while ((n_read = fread(block, sizeof(float), 1024, (*writer)->labels)) > 0)
+			__write((*writer)->file, block, n_read * sizeof(float));
+		if (ferror((*writer)->labels))
+			err("Couldn't read temporary file of the dataset labels.");
+		fclose((*writer)->labels);
+	}
+
+	if (fseek((*writer)->file, 0, SEEK_SET) != 0)
+		err("Couldn't write dataset file.");
+	__write((*writer)->file, header, sizeof(DatasetHeader));
+	if (fclose((*writer)->file) != 0)
+		err("Couldn't write dataset file.");
+
+	gmf_features_free(&(*writer)->row);
+	free(*writer);
+	*writer = NULL;
+}
+
+void gmf_dataset_write(
+		const char* path,
+		const Matrix* X,
+		const Matrix* Y,
+		const FeatureType type,
+		const DatasetLayout layout)
+{
+	if (layout == DATASET_ROWS)
+	{
+		DatasetWriter* writer = gmf_dataset_writer_init(path, X->n_columns, type, Y != NULL);
+		gmf_dataset_writer_append(writer, X, Y);
+		gmf_dataset_writer_close(&writer);
+		return;
+	}
+
+	if (Y && Y->n_rows != X->n_rows)
+		err("Every row of a dataset with labels needs a label.");
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		err("Couldn't open dataset file for writing.");
+
+	// every column is gathered and converted as a single row of n_rows values
+	const size_t value_size = __value_size(type);
+	DatasetHeader header = __header(X->n_columns, type, DATASET_COLUMNS, Y != NULL);
+	header.n_rows = X->n_rows;
+	header.column_stride = __align(X->n_rows * value_size);
+	const size_t features_end = (size_t)header.features_offset + X->n_columns * (size_t)header.column_stride;
+	if (Y)
+		header.labels_offset = features_end;
+	__write(file, &header, sizeof(DatasetHeader));
+
+	float* column = malloc((X->n_rows + 1) * sizeof(float));
+	FeatureMatrix* converted = gmf_features_alloc(1, X->n_rows, type);
+	if (!column)
+		err("Couldn't allocate memory for writing a dataset.");
+	for (size_t c = 0; c < X->n_columns; ++c)
+	{
+		for (size_t r = 0; r < X->n_rows; ++r)
+			column[r] = X->data[r * X->n_columns + c];
+		gmf_features_set_row(converted, 0, column);
+		__write(file, converted->data, X->n_rows * value_size);
+		__write_padding(file, X->n_rows * value_size);
+	}
+	if (Y)
+		__write(file, Y->data, X->n_rows * sizeof(float));
+
+	if (fclose(file) != 0)
+		err("Couldn't write dataset file.");
+	free(column);
+	gmf_features_free(&converted);
+}
+
+Dataset* gmf_dataset_open(const char* path)
+{
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		err("Couldn't open dataset file.");
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(DatasetHeader))
+		err("Not a valid dataset file.");
+	const size_t file_size = (size_t)file_stat.st_size;
+
+	// the mapping stays valid after the file is closed
+	void* mapping = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+		err("Couldn't memory map dataset file.");
+#ifdef MADV_HUGEPAGE
+	// only a hint, ignored where huge pages aren't available for files
+	madvise(mapping, file_size, MADV_HUGEPAGE);
+#endif
+
+	const DatasetHeader* header = mapping;
+	if (memcmp(header->magic, GMF_DATASET_MAGIC, sizeof(GMF_DATASET_MAGIC)) != 0
+			|| header->version != GMF_DATASET_VERSION
+			|| header->layout > DATASET_COLUMNS
+			|| header->has_labels > 1
+			|| (header->type != FEATURES_F32 && header->type != FEATURES_F16 && header->type != FEATURES_BF16))
+		err("Not a valid dataset file.");
+
+	// the sizes of the blocks can't overflow (a crafted header could wrap
+	// them around to something small) and every block has to be aligned,
+	// behind the previous one and inside the file
+	const size_t value_size = __value_size((FeatureType)header->type);
+	size_t values_bytes = 0; // all values of a row or of a column
+	size_t features_bytes = 0;
+	size_t labels_bytes = 0;
+	if (!__multiply(header->layout == DATASET_ROWS ? header->n_columns : header->n_rows, value_size, &values_bytes)
+			|| !__multiply(header->layout == DATASET_ROWS ? header->n_rows : header->n_columns, 
+				header->layout == DATASET_ROWS ? values_bytes : header->column_stride, 
+				&features_bytes)
+			|| !__multiply(header->n_rows, sizeof(float), &labels_bytes))
+		err("Not a valid dataset file.");
+	if (header->features_offset < sizeof(DatasetHeader)
+			|| header->features_offset % GMF_DATASET_ALIGNMENT != 0
+			|| header->labels_offset % GMF_DATASET_ALIGNMENT != 0
+			|| (header->layout == DATASET_COLUMNS 
+				&& (values_bytes > SIZE_MAX - GMF_DATASET_ALIGNMENT || header->column_stride != __align(values_bytes)))
+			|| !__inside(header->features_offset, features_bytes, file_size)
+			|| (header->has_labels 
+				&& (header->labels_offset < header->features_offset + features_bytes
+					|| !__inside(header->labels_offset, labels_bytes, file_size))))
+		err("Not a valid dataset file.");
+	const size_t n_rows = (size_t)header->n_rows;
+	const size_t n_columns = (size_t)header->n_columns;
+
+	Dataset* dataset = malloc(sizeof(Dataset));
+	if (!dataset)
+		err("Couldn't allocate memory for Dataset.");
+
+	const char* bytes = mapping;
+	dataset->layout = (DatasetLayout)header->layout;
+	dataset->type = (FeatureType)header->type;
+	dataset->n_rows = n_rows;
+	dataset->n_columns = n_columns;
+	dataset->column_stride = (size_t)header->column_stride;
+	dataset->features = bytes + header->features_offset;
+	dataset->labels = header->has_labels ? (const float*)(bytes + header->labels_offset) : NULL;
+	dataset->mapping = mapping;
+	dataset->mapping_size = file_size;
+
+	return dataset;
+}
+
+void gmf_dataset_close(Dataset** dataset)
+{
+	munmap((*dataset)->mapping, (*dataset)->mapping_size);
+	free(*dataset);
+	*dataset = NULL;
+}
+
+FeatureMatrix gmf_dataset_features(const Dataset* dataset)
+{
+	if (dataset->layout != DATASET_ROWS)
+		err("Only DATASET_ROWS datasets can be used as a FeatureMatrix.");
+
+	// nothing writes through a FeatureMatrix that doesn't own its data
+	FeatureMatrix view = {
+		.type = dataset->type,
+		.n_rows = dataset->n_rows,
+		.n_columns = dataset->n_columns,
+		.data = (void*)dataset->features,
+		.owns_data = false,
+		.row_idx = NULL,
+		.row_ptr = NULL,
+		.col_idx = NULL
+	};
+
+	return view;
+}
+
+Matrix gmf_dataset_matrix(const Dataset* dataset)
+{
+	if (dataset->layout != DATASET_ROWS || dataset->type != FEATURES_F32)
+		err("Only FEATURES_F32 DATASET_ROWS datasets can be used as a Matrix.");
+
+	const Matrix view = {
+		.data = (float*)dataset->features,
+		.n_rows = dataset->n_rows,
+		.n_columns = dataset->n_columns
+	};
+
+	return view;
+}
+
+Matrix gmf_dataset_labels(const Dataset* dataset)
+{
+	if (!dataset->labels)
+		err("Dataset doesn't have labels.");
+
+	const Matrix view = {
+		.data = (float*)dataset->labels,
+		.n_rows = dataset->n_rows,
+		.n_columns = 1
+	};
+
+	return view;
+}
+
+const void* gmf_dataset_column(
+		const Dataset* dataset,
+		const size_t c)
+{
+	if (dataset->layout != DATASET_COLUMNS)
+		err("Only DATASET_COLUMNS datasets store contiguous columns.");
+	if (c >= dataset->n_columns)
+		err("Dataset column out of range.");
+
+	return (const char*)dataset->features + c * dataset->column_stride;
+}
+
+// the next chunk is a contiguous block of rows, so it's a plain (non row view) FeatureMatrix
+static bool __iterator_next(void* state, const FeatureMatrix** X, const Matrix** Y)
+{
+	DatasetIterator* iterator = state;
+	const Dataset* dataset = iterator->dataset;
+	if (iterator->position >= dataset->n_rows)
+		return false;
+
+	size_t n_rows = dataset->n_rows - iterator->position;
+	if (n_rows > iterator->chunk_rows)
+		n_rows = iterator->chunk_rows;
+
+	iterator->X = gmf_dataset_features(dataset);
+	iterator->X.data = (char*)iterator->X.data + iterator->position * dataset->n_columns * __value_size(dataset->type);
+	iterator->X.n_rows = n_rows;
+	iterator->Y = gmf_dataset_labels(dataset);
+	iterator->Y.data += iterator->position;
+	iterator->Y.n_rows = n_rows;
+	iterator->position += n_rows;
+
+	*X = &iterator->X;
+	*Y = &iterator->Y;
+
+	return true;
+}
+
+static void __iterator_reset(void* state)
+{
+	((DatasetIterator*)state)->position = 0;
+}
+
+DataIterator gmf_dataset_iterator(
+		DatasetIterator* iterator,
+		const Dataset* dataset,
+		const size_t chunk_rows)
+{
+	if (dataset->layout != DATASET_ROWS || !dataset->labels)
+		err("gmf_dataset_iterator() needs a DATASET_ROWS dataset with labels.");
+	if (chunk_rows == 0)
+		err("gmf_dataset_iterator() needs at least one row per chunk.");
+
+	iterator->dataset = dataset;
+	iterator->chunk_rows = chunk_rows;
+	iterator->position = 0;
+
+	const DataIterator data = {
+		.next = &__iterator_next,
+		.reset = &__iterator_reset,
+		.state = iterator
+	};
+
+	return data;
+}
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "feature_matrix.h"
+#include "feature_hasher.h"
+
+static void err(const char* msg)
+{
+	printf("%s\n", msg);
+	exit(-1);
+}
+
+// murmur3 64 bit finalizer (every input bit affects every output bit)
+static inline uint64_t __mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+// grow *buffer (of *capacity elements of element_size bytes) to at least n elements
+static void __reserve(
+	void** buffer,
+	size_t* capacity,
+	const size_t n,
+	const size_t element_size)
+{
+	if (n <= *capacity)
+		return;
+
+	size_t new_capacity = *capacity > 0 ? *capacity : 16;
+	while (new_capacity < n)
+		new_capacity *= 2;
+
+	void* new_buffer = realloc(*buffer, new_capacity * element_size);
+	if (!new_buffer)
+		err("Couldn't allocate memory for FeatureHasher.");
+
+	*buffer = new_buffer;
+	*capacity = new_capacity;
+}
+
+static int __compare_columns(const void* a, const void* b)
+{
+	const uint32_t column_a = ((const HashedValue*)a)->column;
+	const uint32_t column_b = ((const HashedValue*)b)->column;
+	return (column_a > column_b) - (column_a < column_b);
+}
+
+// empty row buffers (no rows ended yet). col_idx and data always grow together.
+static void __start_rows(FeatureHasher* hasher)
+{
+	hasher->n_rows = 0;
+	hasher->row_capacity = 0;
+	hasher->nonzero_capacity = 0;
+	hasher->row_ptr = NULL;
+	hasher->col_idx = NULL;
+	hasher->data = NULL;
+
+	size_t row_ptr_capacity = 0;
+	__reserve((void**)&hasher->row_ptr, &row_ptr_capacity, 16 + 1, sizeof(size_t));
+	hasher->row_capacity = row_ptr_capacity - 1;
+	hasher->row_ptr[0] = 0;
+
+	size_t col_idx_capacity = 0;
+	__reserve((void**)&hasher->col_idx, &col_idx_capacity, 16, sizeof(uint32_t));
+	__reserve((void**)&hasher->data, &hasher->nonzero_capacity, 16, sizeof(float));
+}
+
+FeatureHasher* gmf_features_hasher_init(
+		const size_t n_features,
+		const bool add_bias,
+		const uint64_t seed)
+{
+	if (n_features == 0)
+		err("FeatureHasher needs at least one feature.");
+	if (n_features + (add_bias ? 1 : 0) > UINT32_MAX)
+		err("FEATURES_CSR supports at most 2^32 - 1 columns.");
+
+	FeatureHasher* hasher = malloc(sizeof(FeatureHasher));
+	if (!hasher)
+		err("Couldn't allocate memory for FeatureHasher.");
+
+	hasher->n_features = n_features;
+	hasher->add_bias = add_bias;
+	hasher->seed = seed;
+	hasher->n_pending = 0;
+	hasher->pending_capacity = 0;
+	hasher->pending = NULL;
+	__start_rows(hasher);
+
+	return hasher;
+}
+
+uint64_t gmf_features_hash(
+		const void* token,
+		const size_t length,
+		const uint64_t seed)
+{
+	// FNV-1a over the bytes, the finalizer fixes its weak low bits
+	const unsigned char* bytes = token;
+	uint64_t h = 0xcbf29ce484222325ULL ^ __mix(seed + 0x9E3779B97F4A7C15ULL);
+	for (size_t i = 0; i < length; ++i)
+	{
+		h ^= bytes[i];
+		h *= 0x100000001b3ULL;
+	}
+
+	return __mix(h ^ (uint64_t)length);
+}
+
+// the top bit of the hash is the sign, the others pick the column
+static void __add_hash(
+	FeatureHasher* hasher,
+	const uint64_t h,
+	const float value)
+{
+	if (value == 0.0f)
+		return;
+
+	__reserve((void**)&hasher->pending, &hasher->pending_capacity, hasher->n_pending + 1, sizeof(HashedValue));
+
+	const size_t offset = hasher->add_bias ? 1 : 0;
+	HashedValue* hashed = &hasher->pending[hasher->n_pending++];
+	hashed->column = (uint32_t)(offset + (size_t)((h & 0x7fffffffffffffffULL) % (uint64_t)hasher->n_features));
+	hashed->value = (h >> 63) ? -value : value;
+}
+
+void gmf_features_hasher_add_bytes(
+		FeatureHasher* hasher,
+		const void* token,
+		const size_t length,
+		const float value)
+{
+	__add_hash(hasher, gmf_features_hash(token, length, hasher->seed), value);
+}
+
+void gmf_features_hasher_add(
+		FeatureHasher* hasher,
+		const char* token,
+		const float value)
+{
+	gmf_features_hasher_add_bytes(hasher, token, strlen(token), value);
+}
+
+void gmf_features_hasher_add_category(
+		FeatureHasher* hasher,
+		const char* field,
+		const char* category)
+{
+	// the field's hash seeds the category's hash
+	const uint64_t field_seed = gmf_features_hash(field, strlen(field), hasher->seed);
+	__add_hash(hasher, gmf_features_hash(category, strlen(category), field_seed), 1.0f);
+}
+
+static inline bool __is_space(const char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+void gmf_features_hasher_add_text(
+		FeatureHasher* hasher,
+		const char* text)
+{
+	const char* c = text;
+	while (*c)
+	{
+		while (*c && __is_space(*c))
+			++c;
+
+		const char* word = c;
+		while (*c && !__is_space(*c))
+			++c;
+
+		if (c > word)
+			gmf_features_hasher_add_bytes(hasher, word, (size_t)(c - word), 1.0f);
+	}
+}
+
+void gmf_features_hasher_end_row(FeatureHasher* hasher)
+{
+	qsort(hasher->pending, hasher->n_pending, sizeof(HashedValue), &__compare_columns);
+
+	// the bias plus at most one value per pending token
+	const size_t start = hasher->row_ptr[hasher->n_rows];
+	const size_t max_nonzero = start + hasher->n_pending + 1;
+	if (max_nonzero > hasher->nonzero_capacity)
+	{
+		size_t col_idx_capacity = hasher->nonzero_capacity;
+		__reserve((void**)&hasher->col_idx, &col_idx_capacity, max_nonzero, sizeof(uint32_t));
+		__reserve((void**)&hasher->data, &hasher->nonzero_capacity, max_nonzero, sizeof(float));
+	}
+
+	if (hasher->n_rows + 1 > hasher->row_capacity)
+	{
+		size_t row_ptr_capacity = hasher->row_capacity + 1;
+		__reserve((void**)&hasher->row_ptr, &row_ptr_capacity, hasher->n_rows + 2, sizeof(size_t));
+		hasher->row_capacity = row_ptr_capacity - 1;
+	}
+
+	size_t i = start;
+	if (hasher->add_bias)
+	{
+		hasher->col_idx[i] = 0;
+		hasher->data[i++] = 1.0f;
+	}
+
+	// sum runs of the same column, collisions with opposite signs can cancel
+	for (size_t p = 0; p < hasher->n_pending;)
+	{
+		const uint32_t column = hasher->pending[p].column;
+		float value = 0.0f;
+		for (; p < hasher->n_pending && hasher->pending[p].column == column; ++p)
+			value += hasher->pending[p].value;
+
+		if (value != 0.0f)
+		{
+			hasher->col_idx[i] = column;
+			hasher->data[i++] = value;
+		}
+	}
+
+	hasher->row_ptr[++hasher->n_rows] = i;
+	hasher->n_pending = 0;
+}
+
+size_t gmf_features_hasher_n_columns(const FeatureHasher* hasher)
+{
+	return hasher->n_features + (hasher->add_bias ? 1 : 0);
+}
+
+FeatureMatrix* gmf_features_hasher_finish(FeatureHasher* hasher)
+{
+	if (hasher->n_pending > 0)
+		err("Call gmf_features_hasher_end_row() before gmf_features_hasher_finish().");
+
+	FeatureMatrix* X = malloc(sizeof(FeatureMatrix));
+	if (!X)
+		err("Couldn't allocate memory for FeatureMatrix.");
+
+	// hand the buffers over, shrunk to what's used (+1 like gmf_features_csr_alloc())
+	const size_t n_nonzero = hasher->row_ptr[hasher->n_rows];
+	X->type = FEATURES_CSR;
+	X->n_rows = hasher->n_rows;
+	X->n_columns = gmf_features_hasher_n_columns(hasher);
+	X->owns_data = true;
+	X->row_idx = NULL;
+	X->row_ptr = realloc(hasher->row_ptr, (hasher->n_rows + 1) * sizeof(size_t));
+	X->col_idx = realloc(hasher->col_idx, (n_nonzero + 1) * sizeof(uint32_t));
+	X->data = realloc(hasher->data, (n_nonzero + 1) * sizeof(float));
+	if (!X->row_ptr || !X->col_idx || !X->data)
+		err("Couldn't allocate memory for FeatureMatrix.");
+
+	__start_rows(hasher);
+
+	return X;
+}
+
+void gmf_features_hasher_free(FeatureHasher** hasher)
+{
+	free((*hasher)->row_ptr);
+	free((*hasher)->col_idx);
+	free((*hasher)->data);
+	free((*hasher)->pending);
+	free(*hasher);
+	*hasher = NULL;
+}
@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "matrix.h"
+#include "feature_matrix.h"
+
+static void err(const char* msg)
+{
+	printf("%s\n", msg);
+	exit(-1);
+}
+
+typedef union float_bits
+{
+	float f;
+	uint32_t u;
+} float_bits;
+
+// half -> float (exact). Normal values only need the exponent rebiased,
+// denormals are normalized with a float subtraction.
+static inline float __half_to_float(const uint16_t h)
+{
+	const uint32_t shifted_exponent = 0x7c00u << 13;
+	float_bits magic = { .u = 113u << 23 };
+	float_bits o = { .u = (uint32_t)(h & 0x7fffu) << 13 };
+	const uint32_t exponent = o.u & shifted_exponent;
+
+	o.u += (uint32_t)(127 - 15) << 23;
+	if (exponent == shifted_exponent)
+		o.u += (uint32_t)(128 - 16) << 23; // inf/nan
+	else if (exponent == 0)
+	{
+		o.u += 1u << 23; // zero/denormal
+		o.f -= magic.f;
+	}
+	o.u |= (uint32_t)(h & 0x8000u) << 16;
+
+	return o.f;
+}
+
+// float -> half rounding to nearest even. Values beyond the half
+// range become inf and tiny values become denormals (or zero).
+static inline uint16_t __float_to_half(const float f)
+{
+	const uint32_t infinity = 255u << 23;
+	const uint32_t half_max = (127u + 16u) << 23;
+	float_bits denormal_magic = { .u = ((127u - 15u) + (23u - 10u) + 1u) << 23 };
+	float_bits v = { .f = f };
+	const uint32_t sign = v.u & 0x80000000u;
+	uint16_t h = 0;
+
+	v.u ^= sign;
+	if (v.u >= half_max)
+		h = v.u > infinity ? 0x7e00 : 0x7c00;
+	else if (v.u < (113u << 23))
+	{
+		// the float addition does the rounding of the denormal mantissa
+		v.f += denormal_magic.f;
+		h = (uint16_t)(v.u - denormal_magic.u);
+	}
+	else
+	{
+		const uint32_t mantissa_odd = (v.u >> 13) & 1u;
+		v.u -= (uint32_t)(127 - 15) << 23;
+		v.u += 0xfffu + mantissa_odd;
+		h = (uint16_t)(v.u >> 13);
+	}
+
+	return h | (uint16_t)(sign >> 16);
+}
+
+static inline float __bfloat16_to_float(const uint16_t b)
+{
+	float_bits o = { .u = (uint32_t)b << 16 };
+	return o.f;
+}
+
+// float -> bfloat16 rounding to nearest even
+static inline uint16_t __float_to_bfloat16(const float f)
+{
+	float_bits v = { .f = f };
+	if ((v.u & 0x7fffffffu) > 0x7f800000u)
+		return (uint16_t)((v.u >> 16) | 0x40u); // keep nan a (quiet) nan
+
+	v.u += 0x7fffu + ((v.u >> 16) & 1u);
+	return (uint16_t)(v.u >> 16);
+}
+
+static size_t __type_size(const FeatureType type)
+{
+	return type == FEATURES_F32 || type == FEATURES_CSR ? sizeof(float) : sizeof(uint16_t);
+}
+
+// first value of row (data row) r of a FEATURES_CSR matrix with a column >= c
+static size_t __csr_lower_bound(
+		const FeatureMatrix* X,
+		const size_t r,
+		const size_t c)
+{
+	size_t low = X->row_ptr[r];
+	size_t high = X->row_ptr[r + 1];
+	while (low < high)
+	{
+		const size_t middle = low + (high - low) / 2;
+		if (X->col_idx[middle] < c)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+FeatureMatrix gmf_features_view(const Matrix* X)
+{
+	FeatureMatrix view = {
+		.type = FEATURES_F32,
+		.n_rows = X->n_rows,
+		.n_columns = X->n_columns,
+		.data = X->data, // never written through a view
+		.owns_data = false,
+		.row_idx = NULL,
+		.row_ptr = NULL,
+		.col_idx = NULL
+	};
+
+	return view;
+}
+
+FeatureMatrix gmf_features_csr_view(
+		const size_t n_rows,
+		const size_t n_columns,
+		const size_t* row_ptr,
+		const uint32_t* col_idx,
+		const float* data)
+{
+	// never written through a view
+	FeatureMatrix view = {
+		.type = FEATURES_CSR,
+		.n_rows = n_rows,
+		.n_columns = n_columns,
+		.data = (float*)data,
+		.owns_data = false,
+		.row_idx = NULL,
+		.row_ptr = (size_t*)row_ptr,
+		.col_idx = (uint32_t*)col_idx
+	};
+
+	return view;
+}
+
+void gmf_features_csr_check(const FeatureMatrix* X)
+{
+	if (X->type != FEATURES_CSR)
+		err("gmf_features_csr_check() requires a FEATURES_CSR matrix.");
+	if (X->row_idx)
+		err("Check the CSR matrix before making row views of it.");
+	if (X->row_ptr[0] != 0)
+		err("CSR row_ptr must start at 0.");
+
+	for (size_t r = 0; r < X->n_rows; ++r)
+	{
+		if (X->row_ptr[r + 1] < X->row_ptr[r])
+			err("CSR row_ptr must be non-decreasing.");
+		for (size_t i = X->row_ptr[r]; i < X->row_ptr[r + 1]; ++i)
+		{
+			if (X->col_idx[i] >= X->n_columns)
+				err("CSR column index out of range.");
+			if (i > X->row_ptr[r] && X->col_idx[i] <= X->col_idx[i - 1])
+				err("CSR columns must be ascending within a row.");
+		}
+	}
+}
+
+FeatureMatrix gmf_features_rows(
+		const FeatureMatrix* X,
+		const size_t* row_idx,
+		const size_t n_rows)
+{
+	if (X->row_idx)
+		err("Can't make a row view of a row view.");
+
+	FeatureMatrix view = {
+		.type = X->type,
+		.n_rows = n_rows,
+		.n_columns = X->n_columns,
+		.data = X->data,
+		.owns_data = false,
+		.row_idx = row_idx,
+		.row_ptr = X->row_ptr,
+		.col_idx = X->col_idx
+	};
+
+	return view;
+}
+
+size_t gmf_features_data_row(
+		const FeatureMatrix* X,
+		const size_t r)
+{
+	return X->row_idx ? X->row_idx[r] : r;
+}
+
+FeatureMatrix* gmf_features_alloc(
+		const size_t n_rows,
+		const size_t n_columns,
+		const FeatureType type)
+{
+	if (type == FEATURES_CSR)
+		err("Use gmf_features_csr_alloc() for FEATURES_CSR.");
+
+	FeatureMatrix* X = malloc(sizeof(FeatureMatrix));
+	if (!X)
+		err("Couldn't allocate memory for FeatureMatrix.");
+
+	X->type = type;
+	X->n_rows = n_rows;
+	X->n_columns = n_columns;
+	X->owns_data = true;
+	X->row_idx = NULL;
+	X->row_ptr = NULL;
+	X->col_idx = NULL;
+	X->data = calloc(n_rows * n_columns, __type_size(type));
+	if (!X->data)
+		err("Couldn't allocate memory for FeatureMatrix.");
+
+	return X;
+}
+
+FeatureMatrix* gmf_features_csr_alloc(
+		const size_t n_rows,
+		const size_t n_columns,
+		const size_t n_nonzero)
+{
+	if (n_columns > UINT32_MAX)
+		err("FEATURES_CSR supports at most 2^32 - 1 columns.");
+
+	FeatureMatrix* X = malloc(sizeof(FeatureMatrix));
+	if (!X)
+		err("Couldn't allocate memory for FeatureMatrix.");
+
+	X->type = FEATURES_CSR;
+	X->n_rows = n_rows;
+	X->n_columns = n_columns;
+	X->owns_data = true;
+	X->row_idx = NULL;
+	// +1 so an empty matrix still gets valid pointers
+	X->row_ptr = calloc(n_rows + 1, sizeof(size_t));
+	X->col_idx = malloc((n_nonzero + 1) * sizeof(uint32_t));
+	X->data = malloc((n_nonzero + 1) * sizeof(float));
+	if (!X->row_ptr || !X->col_idx || !X->data)
+		err("Couldn't allocate memory for FeatureMatrix.");
+
+	return X;
+}
+
+FeatureMatrix* gmf_features_init(
+		const Matrix* X,
+		const FeatureType type)
+{
+	if (type == FEATURES_CSR)
+	{
+		size_t n_nonzero = 0;
+		for (size_t i = 0; i < X->n_rows * X->n_columns; ++i)
+			n_nonzero += X->data[i] != 0.0f;
+
+		FeatureMatrix* features = gmf_features_csr_alloc(X->n_rows, X->n_columns, n_nonzero);
+		float* values = features->data;
+		size_t i = 0;
+		for (size_t r = 0; r < X->n_rows; ++r)
+		{
+			const float* row = X->data + r * X->n_columns;
+			for (size_t c = 0; c < X->n_columns; ++c)
+				if (row[c] != 0.0f)
+				{
+					features->col_idx[i] = (uint32_t)c;
+					values[i++] = row[c];
+				}
+			features->row_ptr[r + 1] = i;
+		}
+
+		return features;
+	}
+
+	FeatureMatrix* features = gmf_features_alloc(X->n_rows, X->n_columns, type);
+	for (size_t r = 0; r < X->n_rows; ++r)
+		gmf_features_set_row(features, r, X->data + r * X->n_columns);
+
+	return features;
+}
+
+void gmf_features_free(FeatureMatrix** X)
+{
+	if ((*X)->owns_data)
+	{
+		free((*X)->data);
+		free((*X)->row_ptr);
+		free((*X)->col_idx);
+	}
+	free(*X);
+	*X = NULL;
+}
+
+size_t gmf_features_bytes(const FeatureMatrix* X)
+{
+	if (X->type == FEATURES_CSR)
+		return gmf_features_nonzeros(X) * (sizeof(float) + sizeof(uint32_t)) + (X->n_rows + 1) * sizeof(size_t);
+	return X->n_rows * X->n_columns * __type_size(X->type);
+}
+
+size_t gmf_features_nonzeros(const FeatureMatrix* X)
+{
+	if (X->type != FEATURES_CSR)
+		return X->n_rows * X->n_columns;
+	if (!X->row_idx)
+		return X->row_ptr[X->n_rows];
+
+	size_t n_nonzero = 0;
+	for (size_t r = 0; r < X->n_rows; ++r)
+		n_nonzero += X->row_ptr[X->row_idx[r] + 1] - X->row_ptr[X->row_idx[r]];
+	return n_nonzero;
+}
+
+float gmf_features_at(
+		const FeatureMatrix* X,
+		const size_t r,
+		const size_t c)
+{
+	if (X->type == FEATURES_CSR)
+	{
+		const size_t row = gmf_features_data_row(X, r);
+		const size_t i = __csr_lower_bound(X, row, c);
+		return i < X->row_ptr[row + 1] && X->col_idx[i] == c ? ((const float*)X->data)[i] : 0.0f;
+	}
+
+	const size_t i = gmf_features_data_row(X, r) * X->n_columns + c;
+	switch (X->type)
+	{
+		case FEATURES_F16:
+			return __half_to_float(((const uint16_t*)X->data)[i]);
+		case FEATURES_BF16:
+			return __bfloat16_to_float(((const uint16_t*)X->data)[i]);
+		default:
+			return ((const float*)X->data)[i];
+	}
+}
+
+void gmf_features_set_row(
+		FeatureMatrix* X,
+		const size_t r,
+		const float* row)
+{
+	if (!X->owns_data)
+		err("Can't modify a FeatureMatrix view.");
+	if (X->type == FEATURES_CSR)
+		err("Can't set a row of a FEATURES_CSR matrix. Fill row_ptr, col_idx and data directly.");
+
+	const size_t n_columns = X->n_columns;
+	if (X->type == FEATURES_F32)
+	{
+		memcpy((float*)X->data + r * n_columns, row, n_columns * sizeof(float));
+		return;
+	}
+
+	uint16_t* x = (uint16_t*)X->data + r * n_columns;
+	if (X->type == FEATURES_F16)
+		for (size_t c = 0; c < n_columns; ++c)
+			x[c] = __float_to_half(row[c]);
+	else
+		for (size_t c = 0; c < n_columns; ++c)
+			x[c] = __float_to_bfloat16(row[c]);
+}
+
+void gmf_features_row(
+		const FeatureMatrix* X,
+		const size_t r,
+		float* row)
+{
+	gmf_features_row_slice(X, r, 0, X->n_columns, row);
+}
+
+void gmf_features_row_slice(
+		const FeatureMatrix* X,
+		const size_t r,
+		const size_t column_start,
+		const size_t n,
+		float* row)
+{
+	if (X->type == FEATURES_CSR)
+	{
+		memset(row, 0, n * sizeof(float));
+		const size_t data_row = gmf_features_data_row(X, r);
+		const float* values = X->data;
+		for (size_t i = __csr_lower_bound(X, data_row, column_start); i < X->row_ptr[data_row + 1] && X->col_idx[i] < column_start + n; ++i)
+			row[X->col_idx[i] - column_start] = values[i];
+		return;
+	}
+
+	const size_t i = gmf_features_data_row(X, r) * X->n_columns + column_start;
+	if (X->type == FEATURES_F32)
+	{
+		memcpy(row, (const float*)X->data + i, n * sizeof(float));
+		return;
+	}
+
+	const uint16_t* x = (const uint16_t*)X->data + i;
+	if (X->type == FEATURES_F16)
+		for (size_t c = 0; c < n; ++c)
+			row[c] = __half_to_float(x[c]);
+	else
+		for (size_t c = 0; c < n; ++c)
+			row[c] = __bfloat16_to_float(x[c]);
+}
+
+float gmf_features_dot(
+		const FeatureMatrix* X,
+		const size_t r,
+		const float* w)
+{
+	float dot = 0.0f;
+	if (X->type == FEATURES_CSR)
+	{
+		// sparse X * W: gather the weights of the non-zero columns
+		const size_t data_row = gmf_features_data_row(X, r);
+		const float* values = X->data;
+		const uint32_t* columns = X->col_idx;
+		for (size_t i = X->row_ptr[data_row]; i < X->row_ptr[data_row + 1]; ++i)
+			dot += values[i] * w[columns[i]];
+		return dot;
+	}
+
+	const size_t n_columns = X->n_columns;
+	const size_t i = gmf_features_data_row(X, r) * n_columns;
+	if (X->type == FEATURES_F32)
+	{
+		const float* x = (const float*)X->data + i;
+		for (size_t c = 0; c < n_columns; ++c)
+			dot += x[c] * w[c];
+		return dot;
+	}
+
+	const uint16_t* x = (const uint16_t*)X->data + i;
+	if (X->type == FEATURES_F16)
+		for (size_t c = 0; c < n_columns; ++c)
+			dot += __half_to_float(x[c]) * w[c];
+	else
+		for (size_t c = 0; c < n_columns; ++c)
+			dot += __bfloat16_to_float(x[c]) * w[c];
+
+	return dot;
+}
+
+void gmf_features_axpy(
+		const FeatureMatrix* X,
+		const size_t r,
+		const float a,
+		float* y)
+{
+	if (X->type == FEATURES_CSR)
+	{
+		// sparse X^T r: scatter into the non-zero columns only
+		const size_t data_row = gmf_features_data_row(X, r);
+		const float* values = X->data;
+		const uint32_t* columns = X->col_idx;
+		for (size_t i = X->row_ptr[data_row]; i < X->row_ptr[data_row + 1]; ++i)
+			y[columns[i]] += a * values[i];
+		return;
+	}
+
+	const size_t n_columns = X->n_columns;
+	const size_t i = gmf_features_data_row(X, r) * n_columns;
+	if (X->type == FEATURES_F32)
+	{
+		const float* x = (const float*)X->data + i;
+		for (size_t c = 0; c < n_columns; ++c)
+			y[c] += a * x[c];
+		return;
+	}
+
+	const uint16_t* x = (const uint16_t*)X->data + i;
+	if (X->type == FEATURES_F16)
+		for (size_t c = 0; c < n_columns; ++c)
+			y[c] += a * __half_to_float(x[c]);
+	else
+		for (size_t c = 0; c < n_columns; ++c)
+			y[c] += a * __bfloat16_to_float(x[c]);
+}
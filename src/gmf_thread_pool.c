@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "gmf_util.h"
+
+struct ThreadPool
+{
+	pthread_t* workers;
+	size_t n_workers; // caller thread also runs tasks, so this is n_threads - 1
+	pthread_mutex_t mutex;
+	pthread_cond_t work_ready;
+	pthread_cond_t work_done;
+
+	// current job
+	void (*task)(void*, size_t);
+	void* args;
+	size_t n_tasks;
+	size_t next_task;
+	size_t n_busy; // workers that haven't finished the current job
+	size_t generation; // incremented every time a new job is submitted
+	bool shutdown;
+};
+
+static void err(const char* msg)
+{
+	printf("%s\n", msg);
+	exit(-1);
+}
+
+// grab tasks until there are none left
+static void __run_tasks(ThreadPool* pool)
+{
+	while (true)
+	{
+		pthread_mutex_lock(&pool->mutex);
+		size_t task_idx = pool->next_task++;
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (task_idx >= pool->n_tasks)
+			return;
+		pool->task(pool->args, task_idx);
+	}
+}
+
+static void* __worker(void* arg)
+{
+	ThreadPool* pool = arg;
+	size_t seen_generation = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (true)
+	{
+		while (!pool->shutdown && pool->generation == seen_generation)
+			pthread_cond_wait(&pool->work_ready, &pool->mutex);
+		if (pool->shutdown)
+			break;
+		seen_generation = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		__run_tasks(pool);
+
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->n_busy == 0)
+			pthread_cond_signal(&pool->work_done);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+ThreadPool* gmf_util_thread_pool_init(const size_t n_threads)
+{
+	void* alloc = malloc(sizeof(ThreadPool));
+	if (!alloc)
+		err("Couldn't allocate memory for ThreadPool.");
+	ThreadPool* pool = alloc;
+
+	pool->n_workers = n_threads > 1 ? n_threads - 1 : 0;
+	pool->workers = NULL;
+	pool->task = NULL;
+	pool->args = NULL;
+	pool->n_tasks = 0;
+	pool->next_task = 0;
+	pool->n_busy = 0;
+	pool->generation = 0;
+	pool->shutdown = false;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->work_ready, NULL);
+	pthread_cond_init(&pool->work_done, NULL);
+
+	if (pool->n_workers > 0)
+	{
+		alloc = malloc(pool->n_workers * sizeof(pthread_t));
+		if (!alloc)
+			err("Couldn't allocate memory for ThreadPool.");
+		pool->workers = alloc;
+	}
+
+	for (size_t t = 0; t < pool->n_workers; ++t)
+		if (pthread_create(&pool->workers[t], NULL, &__worker, pool) != 0)
+			err("Couldn't create ThreadPool worker thread.");
+
+	return pool;
+}
+
+size_t gmf_util_thread_pool_size(const ThreadPool* pool)
+{
+	return pool->n_workers + 1;
+}
+
+void gmf_util_thread_pool_run(
+		ThreadPool* pool,
+		const size_t n_tasks,
+		void (*task)(void*, size_t),
+		void* args)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->task = task;
+	pool->args = args;
+	pool->n_tasks = n_tasks;
+	pool->next_task = 0;
+	pool->n_busy = pool->n_workers;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->work_ready);
+	pthread_mutex_unlock(&pool->mutex);
+
+	// the calling thread helps out instead of idling
+	__run_tasks(pool);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->n_busy > 0)
+		pthread_cond_wait(&pool->work_done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void gmf_util_thread_pool_free(ThreadPool** pool)
+{
+	pthread_mutex_lock(&(*pool)->mutex);
+	(*pool)->shutdown = true;
+	pthread_cond_broadcast(&(*pool)->work_ready);
+	pthread_mutex_unlock(&(*pool)->mutex);
+
+	for (size_t t = 0; t < (*pool)->n_workers; ++t)
+		pthread_join((*pool)->workers[t], NULL);
+
+	pthread_mutex_destroy(&(*pool)->mutex);
+	pthread_cond_destroy(&(*pool)->work_ready);
+	pthread_cond_destroy(&(*pool)->work_done);
+	free((*pool)->workers);
+	free(*pool);
+	*pool = NULL;
+}
@@ -13,3 +13,49 @@ void gmf_util_add_bias(Matrix** X)
 	}	
 	mat_free(&X_copy);
 }
+
+void gmf_util_random_seed(RandomState* random_state, const uint64_t seed)
+{
+	random_state->state = seed;
+}
+
+uint64_t gmf_util_random_next(RandomState* random_state)
+{
+	// splitmix64
+	uint64_t z = (random_state->state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+size_t gmf_util_random_index(RandomState* random_state, const size_t n)
+{
+	return (size_t)(gmf_util_random_next(random_state) % (uint64_t)n);
+}
+
+float gmf_util_random_uniform(RandomState* random_state, const float low, const float high)
+{
+	// top 24 bits fill the float mantissa exactly
+	const float unit = (float)(gmf_util_random_next(random_state) >> 40) * (1.0f / 16777216.0f);
+	return low + (high - low) * unit;
+}
+
+void gmf_util_shuffle(RandomState* random_state, size_t* idx, const size_t n)
+{
+	for (size_t i = n; i > 1; --i)
+	{
+		size_t j = gmf_util_random_index(random_state, i);
+		size_t temp = idx[i - 1];
+		idx[i - 1] = idx[j];
+		idx[j] = temp;
+	}
+}
+
+void gmf_util_sample(RandomState* random_state, size_t* idx, const size_t n_samples, const size_t n)
+{
+	// row i is picked with probability (samples still needed) / (rows left)
+	size_t n_picked = 0;
+	for (size_t i = 0; i < n && n_picked < n_samples; ++i)
+		if (gmf_util_random_index(random_state, n - i) < n_samples - n_picked)
+			idx[n_picked++] = i;
+}
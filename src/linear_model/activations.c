@@ -1,6 +1,7 @@
 #include "activations.h"
 #include "matrix.h"
 #include "linear_model.h"
+#include "kernels.h"
 
 void gmf_activation_identity(
 		Matrix** XW,
@@ -15,26 +16,34 @@ void gmf_activation_sigmoid_soft(
 		Matrix** XW,
 		const LinearModel* lm)
 {
-	for (size_t r = 0; r < (*XW)->n_rows; ++r)
-	{
-		float actv = 1.0f / (1.0f + expf(-mat_at(*XW, r, 0)));
-		// keep bounds between 0 and 1
-		actv = actv < 0.0f ? 0.0f : actv;
-		actv = actv > 1.0f ? 1.0f : actv;
-		mat_set(XW, r, 0, actv);
-	}
+	// XW is a single column so the data is contiguous
+	gmf_kernel_sigmoid((*XW)->data, (*XW)->n_rows);
 }
 
 void gmf_activation_sigmoid_hard(
 		Matrix** XW,
 		const LinearModel* lm)
 {
-	gmf_activation_sigmoid_soft(XW, lm);
-	for (size_t r = 0; r < (*XW)->n_rows; ++r)
-	{
-		if (mat_at(*XW, r, 0) > lm->params->sigmoid_threshold)
-			mat_set(XW, r, 0, 1.0f);
-		else
-			mat_set(XW, r, 0, 0.0f);
-	}
+	gmf_kernel_sigmoid_hard((*XW)->data, (*XW)->n_rows, lm->params->sigmoid_threshold);
+}
+
+void gmf_activation_vec_identity(
+		Matrix** XW,
+		const LinearModelVec* lm)
+{
+	return;
+}
+
+void gmf_activation_vec_sigmoid(
+		Matrix** XW,
+		const LinearModelVec* lm)
+{
+	gmf_kernel_sigmoid((*XW)->data, (*XW)->n_rows * (*XW)->n_columns);
+}
+
+void gmf_activation_vec_softmax(
+		Matrix** XW,
+		const LinearModelVec* lm)
+{
+	gmf_kernel_softmax((*XW)->data, (*XW)->n_rows, (*XW)->n_columns);
 }
@@ -0,0 +1,190 @@
+#include "coordinate_descent.h"
+#include "matrix.h"
+#include "feature_matrix.h"
+
+// transpose the non-zero values of a FEATURES_CSR X into compressed sparse columns
+static void __prepare_sparse(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const float* W,
+		size_t* column_ptr,
+		uint32_t* row_idx,
+		float* X_columns,
+		double* column_norms,
+		double* residual)
+{
+	const size_t n_rows = X->n_rows;
+	const size_t n_columns = X->n_columns;
+	const float* values = X->data;
+
+	// count the values of every column, then turn the counts into offsets
+	for (size_t c = 0; c <= n_columns; ++c)
+		column_ptr[c] = 0;
+	for (size_t r = 0; r < n_rows; ++r)
+	{
+		const size_t row = gmf_features_data_row(X, r);
+		for (size_t i = X->row_ptr[row]; i < X->row_ptr[row + 1]; ++i)
+			column_ptr[X->col_idx[i] + 1]++;
+	}
+	for (size_t c = 0; c < n_columns; ++c)
+		column_ptr[c + 1] += column_ptr[c];
+
+	// column_norms doubles as the fill position of every column until the end
+	for (size_t r = 0; r < n_rows; ++r)
+	{
+		const size_t row = gmf_features_data_row(X, r);
+		double prediction = 0.0;
+		for (size_t i = X->row_ptr[row]; i < X->row_ptr[row + 1]; ++i)
+		{
+			const size_t c = X->col_idx[i];
+			const size_t position = column_ptr[c] + (size_t)column_norms[c];
+			X_columns[position] = values[i];
+			row_idx[position] = (uint32_t)r;
+			column_norms[c] += 1.0;
+			prediction += (double)values[i] * W[c];
+		}
+		residual[r] = Y->data[r] - prediction;
+	}
+
+	for (size_t c = 0; c < n_columns; ++c)
+	{
+		double norm = 0.0;
+		for (size_t i = column_ptr[c]; i < column_ptr[c + 1]; ++i)
+			norm += (double)X_columns[i] * X_columns[i];
+		column_norms[c] = norm;
+	}
+}
+
+void gmf_coordinate_descent_prepare(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const float* W,
+		size_t* column_ptr,
+		uint32_t* row_idx,
+		float* X_columns,
+		double* column_norms,
+		double* residual)
+{
+	const size_t n_rows = X->n_rows;
+	const size_t n_columns = X->n_columns;
+
+	for (size_t c = 0; c < n_columns; ++c)
+		column_norms[c] = 0.0;
+
+	if (X->type == FEATURES_CSR)
+	{
+		__prepare_sparse(X, Y, W, column_ptr, row_idx, X_columns, column_norms, residual);
+		return;
+	}
+
+	for (size_t c = 0; c <= n_columns; ++c)
+		column_ptr[c] = c * n_rows;
+
+	// transpose (and compute the residual) one row at a time
+	for (size_t r = 0; r < n_rows; ++r)
+	{
+		double prediction = 0.0;
+		for (size_t c = 0; c < n_columns; ++c)
+		{
+			const double x = gmf_features_at(X, r, c);
+			X_columns[c * n_rows + r] = (float)x;
+			column_norms[c] += x * x;
+			prediction += x * W[c];
+		}
+		residual[r] = Y->data[r] - prediction;
+	}
+}
+
+// soft thresholding operator sign(x) * max(|x| - threshold, 0)
+static double __soft_threshold(const double x, const double threshold)
+{
+	if (x > threshold)
+		return x - threshold;
+	if (x < -threshold)
+		return x + threshold;
+	return 0.0;
+}
+
+double gmf_coordinate_descent_sweep(
+		const float* X_columns,
+		const size_t* column_ptr,
+		const uint32_t* row_idx,
+		const size_t n_rows,
+		const size_t* columns,
+		const size_t n_active,
+		const double* column_norms,
+		const double l1,
+		const double l2,
+		const size_t first_penalized,
+		double* residual,
+		float* W)
+{
+	double max_change = 0.0;
+
+	for (size_t a = 0; a < n_active; ++a)
+	{
+		const size_t c = columns[a];
+		if (column_norms[c] == 0.0)
+			continue;
+
+		const float* x = X_columns + column_ptr[c];
+		const size_t n = column_ptr[c + 1] - column_ptr[c];
+		const uint32_t* rows = row_idx ? row_idx + column_ptr[c] : NULL;
+		const double w = W[c];
+
+		// rho = x_j^T (residual + x_j * w_j)
+		double rho = 0.0;
+		if (rows)
+			for (size_t i = 0; i < n; ++i)
+				rho += x[i] * residual[rows[i]];
+		else
+			for (size_t r = 0; r < n; ++r)
+				rho += x[r] * residual[r];
+		rho += column_norms[c] * w;
+
+		double w_new = 0.0;
+		if (c < first_penalized)
+			w_new = rho / column_norms[c];
+		else
+			w_new = __soft_threshold(rho, 0.5 * l1) / (column_norms[c] + l2);
+		W[c] = (float)w_new;
+
+		const double delta = (double)W[c] - w;
+		if (delta == 0.0)
+			continue;
+
+		if (rows)
+			for (size_t i = 0; i < n; ++i)
+				residual[rows[i]] -= delta * x[i];
+		else
+			for (size_t r = 0; r < n; ++r)
+				residual[r] -= delta * x[r];
+
+		const double change = fabs(delta) * sqrt(column_norms[c] / (double)n_rows);
+		if (change > max_change)
+			max_change = change;
+	}
+
+	return max_change;
+}
+
+double gmf_coordinate_descent_l1_max(
+		const float* X_columns,
+		const size_t* column_ptr,
+		const uint32_t* row_idx,
+		const size_t n_columns,
+		const size_t first_penalized,
+		const double* residual)
+{
+	double l1_max = 0.0;
+	for (size_t c = first_penalized; c < n_columns; ++c)
+	{
+		double correlation = 0.0;
+		for (size_t i = column_ptr[c]; i < column_ptr[c + 1]; ++i)
+			correlation += X_columns[i] * residual[row_idx ? row_idx[i] : i - column_ptr[c]];
+		if (2.0 * fabs(correlation) > l1_max)
+			l1_max = 2.0 * fabs(correlation);
+	}
+
+	return l1_max;
+}
@@ -6,6 +6,9 @@
  * - setting different model parameters
  * - adding a bias term to a new test data set (incase you don't have one in your dataset)
  * - changing the model optimization type (CLASSIC vs STOCHASTIC vs BATCH)
+ * - changing the optimizer (Adam) and learning rate schedule
+ * - solving least squares directly (CHOLESKY)
+ * - early stopping on held out validation data
  * - making new predictions and using predict_inplace for multiple predictions
  */
 
@@ -74,10 +77,58 @@ int main()
 	mat_print(preds);
 	printf("STOCHASTIC MAE: %f\n", gmf_metrics_mae(Y, preds, NULL));
 
+	// adaptive optimizers such as Adam can use much larger learning rates
+	// and need far fewer iterations than plain gradient descent
+	gmf_model_linear_set_model_type(&lm, CLASSIC);
+	gmf_model_linear_set_optimizer(&lm, &gmf_optimizer_adam);
+	gmf_model_linear_set_learning_rate_schedule(&lm, &gmf_learning_rate_cosine);
+	gmf_model_linear_set_learning_rate(&lm, 0.05f);
+	gmf_model_linear_set_iterations(&lm, 1000);
+	gmf_model_linear_set_early_stop_iterations(&lm, lm->params->n_iterations);
+
+	gmf_model_linear_fit(&lm, X, Y, true);
+	printf("\n\nADAM PREDICTED:\n");
+	gmf_model_linear_predict_inplace(lm, X, &preds); 
+	mat_print(preds);
+	printf("ADAM MAE: %f\n", gmf_metrics_mae(Y, preds, NULL));
+
+	// squared loss can also be solved exactly in a single pass over the data
+	gmf_model_linear_set_model_type(&lm, CHOLESKY);
+
+	gmf_model_linear_fit(&lm, X, Y, true);
+	printf("\n\nCHOLESKY PREDICTED:\n");
+	gmf_model_linear_predict_inplace(lm, X, &preds); 
+	mat_print(preds);
+	printf("CHOLESKY MAE: %f\n", gmf_metrics_mae(Y, preds, NULL));
+
+	// early stopping can look at held out data instead of the training loss.
+	// The weights with the lowest validation loss are kept after training
+	Matrix* X_validation = NULL;
+	mat_init(&X_validation, 5, 4);
+	mat_random(&X_validation, 0.0f, 10.0f);
+	gmf_util_add_bias(&X_validation);
+
+	Matrix* Y_validation = NULL;
+	mat_init(&Y_validation, 5, 1);
+	mat_random(&Y_validation, 0.0f, 10.0f);
+
+	gmf_model_linear_set_model_type(&lm, CLASSIC);
+	gmf_model_linear_set_validation(&lm, X_validation, Y_validation);
+	// only check the (validation) loss every 100 iterations and stop
+	// once it hasn't improved for 300 iterations
+	gmf_model_linear_set_loss_check_interval(&lm, 100);
+	gmf_model_linear_set_early_stop_iterations(&lm, 300);
+
+	gmf_model_linear_fit(&lm, X, Y, true);
+	gmf_model_linear_predict_inplace(lm, X, &preds);
+	printf("VALIDATION EARLY STOPPING MAE: %f\n", gmf_metrics_mae(Y, preds, NULL));
+
 
 	gmf_model_linear_free(&lm);
 	mat_free(&X);
 	mat_free(&Y);
+	mat_free(&X_validation);
+	mat_free(&Y_validation);
 	mat_free(&preds);
 
 	return 0;
@@ -7,6 +7,7 @@
  * - adding a bias term to a new test data set (incase you don't have one in your dataset)
  * - changing the model optimization type (CLASSIC vs STOCHASTIC vs BATCH)
  * - making new predictions and using predict_inplace for multiple predictions
+ * - training with Newton's method (NEWTON) instead of gradient descent
  */
 
 #include <stdio.h>
@@ -69,6 +70,22 @@ int main()
 	float weighted_f1 = gmf_metrics_confusion_matrix(Y, preds, &n_classes);
 	printf("\nWeighted F1: %f\n", weighted_f1);
 
+	// Newton's method converges in a handful of passes over the data
+	// NOTE: n_iterations is the maximum number of Newton steps
+	gmf_model_linear_set_model_type(&lm, NEWTON);
+	gmf_model_linear_set_iterations(&lm, 25);
+	gmf_model_linear_set_early_stop_iterations(&lm, lm->params->n_iterations);
+
+	gmf_model_linear_fit(&lm, X, Y, true);
+	printf("\n\nNEWTON PREDICTED:\n");
+	gmf_model_linear_predict_inplace(lm, X, &preds);
+	mat_print(preds);
+
+	for (size_t i = 0; i < preds->n_rows; ++i)
+		mat_set(&preds, i, 0, mat_at(preds, i, 0) > 0.5f ? 1.0f : 0.0f);
+	weighted_f1 = gmf_metrics_confusion_matrix(Y, preds, &n_classes);
+	printf("\nNEWTON Weighted F1: %f\n", weighted_f1);
+
 
 	gmf_model_linear_free(&lm);
 	mat_free(&X);
@@ -51,6 +51,28 @@ int main()
 	mat_print(preds);
 	printf("\nMean Absolute Error: %f\n", gmf_metrics_mae(Y, preds, NULL));
 
+	// L1 (lasso) and elastic net are best solved with coordinate descent
+	// which sets weights to exactly zero. Elastic net takes two parameters:
+	// lambda and the L1 ratio (1 = L1, 0 = L2)
+	float elastic_net_params[2] = {5.0f, 0.8f};
+	gmf_model_linear_set_model_type(&lm, COORDINATE_DESCENT);
+	gmf_model_linear_set_regularization(&lm, &gmf_regularization_elastic_net);
+	gmf_model_linear_set_regularization_gradient(&lm, &gmf_regularization_gradient_elastic_net);
+	gmf_model_linear_set_regularization_params(&lm, elastic_net_params, 2);
+	gmf_model_linear_set_exclude_bias(&lm, true); // don't shrink the bias
+
+	gmf_model_linear_fit(&lm, X, Y, false);
+	printf("\n\nWEIGHTS (elastic net):\n");
+	mat_print(lm->W);
+
+	// fit a whole path of decreasing lambdas (warm started from each other)
+	// every column of path holds the weights of one lambda
+	Matrix* path = NULL;
+	gmf_model_linear_fit_path(&lm, X, Y, NULL, 10, &path, true);
+	printf("\n\nREGULARIZATION PATH:\n");
+	mat_print(path);
+	mat_free(&path);
+
 	gmf_model_linear_free(&lm);
 	mat_free(&X);
 	mat_free(&Y);
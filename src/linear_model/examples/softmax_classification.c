@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include "linear_models.h"
+
+int main()
+{
+	// 3 classes separated along the first two features
+	Matrix* X = NULL;
+	mat_init(&X, 300, 2);
+	mat_random(&X, -1.0f, 1.0f);
+
+	Matrix* Y = NULL;
+	mat_init(&Y, 300, 1);
+	for (size_t r = 0; r < Y->n_rows; ++r)
+	{
+		const size_t label = r % 3;
+		mat_set(&Y, r, 0, (float)label);
+		mat_set(&X, r, 0, mat_at(X, r, 0) + 3.0f * (float)label);
+		mat_set(&X, r, 1, mat_at(X, r, 1) - 2.0f * (float)label);
+	}
+
+	// one model with an output per class. Y holds class labels
+	// {0, 1, 2} which are one-hot encoded during fit()
+	LinearModelVec* vec_model = gmf_model_linear_vec_init(3);
+
+	// softmax + multinomial cross entropy (multinomial logistic regression)
+	gmf_model_linear_vec_set_activation(&vec_model, &gmf_activation_vec_softmax);
+	gmf_model_linear_vec_set_loss(&vec_model, &gmf_loss_vec_cross_entropy);
+	gmf_model_linear_vec_set_loss_gradient(&vec_model, &gmf_loss_gradient_vec_cross_entropy);
+
+	gmf_model_linear_vec_set_iterations(&vec_model, 5000);
+	gmf_model_linear_vec_set_learning_rate(&vec_model, 0.1f);
+
+	gmf_util_add_bias(&X);
+	gmf_model_linear_vec_fit(&vec_model, X, Y, true);
+
+	// probability of every class...
+	Matrix* probabilities = gmf_model_linear_vec_predict(vec_model, X);
+	printf("\n\nPROBABILITIES (first 5 rows):\n");
+	for (size_t r = 0; r < 5; ++r)
+		printf("%f %f %f\n", mat_at(probabilities, r, 0), mat_at(probabilities, r, 1), mat_at(probabilities, r, 2));
+
+	// ...or just the most likely class
+	Matrix* preds = gmf_model_linear_vec_predict_class(vec_model, X);
+	float weighted_f1 = gmf_metrics_confusion_matrix(Y, preds, &vec_model->n_outputs);
+	printf("\nWeighted F1: %f\n", weighted_f1);
+
+	gmf_model_linear_vec_free(&vec_model);
+	mat_free(&X);
+	mat_free(&Y);
+	mat_free(&probabilities);
+	mat_free(&preds);
+}
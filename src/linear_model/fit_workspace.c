@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fit_workspace.h"
+#include "gmf_util.h"
+
+static void err(const char* msg)
+{
+	printf("%s\n", msg);
+	exit(-1);
+}
+
+size_t* gmf_fit_row_idx_alloc(const size_t n_rows)
+{
+	size_t* row_idx = malloc(n_rows * sizeof(size_t));
+	if (!row_idx)
+		err("Couldn't allocate memory for the training workspace.");
+	for (size_t r = 0; r < n_rows; ++r)
+		row_idx[r] = r;
+
+	return row_idx;
+}
+
+void gmf_fit_partials_alloc(
+		const size_t n_chunks,
+		const size_t n_weights,
+		float** partial_gradients,
+		double** partial_losses)
+{
+	*partial_gradients = malloc(n_chunks * n_weights * sizeof(float));
+	*partial_losses = malloc(n_chunks * sizeof(double));
+	if (!*partial_gradients || !*partial_losses)
+		err("Couldn't allocate memory for the training workspace.");
+}
+
+const size_t* gmf_fit_next_sample(
+		RandomState* random_state,
+		size_t* row_idx,
+		const size_t n_rows,
+		const size_t n_sample_rows,
+		size_t* epoch_position)
+{
+	if (*epoch_position + n_sample_rows > n_rows)
+	{
+		gmf_util_shuffle(random_state, row_idx, n_rows);
+		*epoch_position = 0;
+	}
+
+	const size_t* sample_idx = row_idx + *epoch_position;
+	*epoch_position += n_sample_rows;
+
+	return sample_idx;
+}
+
+void gmf_fit_run_chunks(
+		ThreadPool* thread_pool,
+		const size_t n_chunks,
+		void (*task)(void*, size_t),
+		void* args)
+{
+	if (thread_pool)
+		gmf_util_thread_pool_run(thread_pool, n_chunks, task, args);
+	else
+		for (size_t chunk = 0; chunk < n_chunks; ++chunk)
+			task(args, chunk);
+}
+
+void gmf_fit_reduce_chunks(
+		float* partial_gradients,
+		double* partial_losses,
+		const size_t n_chunks,
+		const size_t n_weights)
+{
+	for (size_t stride = 1; stride < n_chunks; stride *= 2)
+	{
+		for (size_t i = 0; i + stride < n_chunks; i += 2 * stride)
+		{
+			float* dst = partial_gradients + i * n_weights;
+			const float* src = partial_gradients + (i + stride) * n_weights;
+			for (size_t w = 0; w < n_weights; ++w)
+				dst[w] += src[w];
+			partial_losses[i] += partial_losses[i + stride];
+		}
+	}
+}
@@ -0,0 +1,425 @@
+#include "fused_losses.h"
+#include "activations.h"
+#include "losses.h"
+#include "kernels.h"
+#include "loss_gradients.h"
+#include "regularization.h"
+#include "linear_model.h"
+#include "matrix.h"
+#include "feature_matrix.h"
+
+static void err(const char* msg)
+{
+	printf("%s\n", msg);
+	exit(-1);
+}
+
+/*
+ * Scalar versions of the built-in activations.
+ * These use the same exp as activations.c (see kernels.h) so they
+ * match it up to the rounding differences between ISAs.
+ */
+
+static float __identity(float z, const LinearModel* lm)
+{
+	return z;
+}
+
+static float __sigmoid_soft(float z, const LinearModel* lm)
+{
+	return 1.0f / (1.0f + gmf_kernel_exp(-z));
+}
+
+static float __sigmoid_hard(float z, const LinearModel* lm)
+{
+	return __sigmoid_soft(z, lm) > lm->params->sigmoid_threshold ? 1.0f : 0.0f;
+}
+
+static float (*__scalar_activation(const LinearModel* lm))(float, const LinearModel*)
+{
+	if (lm->activation == &gmf_activation_identity)
+		return &__identity;
+	if (lm->activation == &gmf_activation_sigmoid_soft)
+		return &__sigmoid_soft;
+	if (lm->activation == &gmf_activation_sigmoid_hard)
+		return &__sigmoid_hard;
+	return NULL;
+}
+
+/*
+ * Row terms: given y and yhat, store the loss in *loss (unless loss is
+ * NULL, the loss isn't needed for every row) and return the residual
+ * that multiplies x in the gradient.
+ * These must match losses.c and loss_gradients.c (up to ISA rounding).
+ */
+
+static float __squared_term(float y, float yhat, const LinearModel* lm, float* loss)
+{
+	if (loss)
+		*loss = (y - yhat) * (y - yhat);
+	return -2.0f * (y - yhat);
+}
+
+static float __cross_entropy_term(float y, float yhat, const LinearModel* lm, float* loss)
+{
+	float residual = yhat - y;
+	if (lm->params->class_weights)
+		residual *= lm->params->class_weights[lm->params->class_pair[(size_t)y]];
+
+	// constrain yhat between [0, 1] for the loss only
+	if (loss)
+	{
+		yhat = yhat < 0.01f ? 0.01f : yhat;
+		yhat = yhat > 0.99f ? 0.99f : yhat;
+		*loss = -y * gmf_kernel_log(yhat) - (1 - y) * gmf_kernel_log(1 - yhat);
+	}
+
+	return residual;
+}
+
+static float __absolute_term(float y, float yhat, const LinearModel* lm, float* loss)
+{
+	const float diff = fabsf(y - yhat);
+	if (loss)
+		*loss = diff;
+	if (diff < 0.0001f)
+		return 0.0f;
+	return -(y - yhat) / diff; // carry negative from chain rule
+}
+
+static float __hinge_term(float y, float yhat, const LinearModel* lm, float* loss)
+{
+	// the gradient uses the raw labels...
+	float residual = 0.0f;
+	if (y * yhat <= 0.0f)
+		residual = 0.5f - y * yhat;
+	else if (y * yhat <= 1.0f)
+		residual = 0.5f * (1.0f - y * yhat);
+
+	// ...while the loss is defined for {-1, 1}
+	if (loss)
+	{
+		if (fabsf(y - 0.0f) < 0.0001f)
+			y = -1.0f;
+		if (fabsf(yhat - 0.0f) < 0.0001f)
+			yhat = -1.0f;
+		*loss = 1 - y * yhat < 0.0f ? 0.0f : 1 - y * yhat;
+	}
+
+	return residual;
+}
+
+static float __huber_term(float y, float yhat, const LinearModel* lm, float* loss)
+{
+	float diff = y - yhat;
+	float delta = lm->params->huber_delta;
+
+	if (loss)
+		*loss = fabsf(diff) < delta ? 0.5f * diff * diff : delta * (fabsf(diff) - 0.5f * delta);
+
+	// carry negative from chain rule
+	if (fabsf(diff) <= delta)
+		return -diff;
+	return -delta * (diff / fabsf(diff));
+}
+
+// adds the contribution of rows [row_start, row_end) (or the rows they
+// index in row_idx) to gradient (NOT divided by the number of rows)
+// and returns their summed loss (0 unless compute_loss is set)
+static double __fused_rows(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		float (*activation)(float, const LinearModel*),
+		float (*row_term)(float, float, const LinearModel*, float*),
+		const float regularization_gradient,
+		const size_t* row_idx,
+		const size_t row_start,
+		const size_t row_end,
+		const bool compute_loss,
+		float* gradient)
+{
+	const float* W = lm->W->data;
+
+	double loss = 0.0;
+	for (size_t i = row_start; i < row_end; ++i)
+	{
+		const size_t r = row_idx ? row_idx[i] : i;
+		const float xw = gmf_features_dot(X, r, W);
+
+		float row_loss = 0.0f;
+		float residual = row_term(Y->data[r], activation(xw, lm), lm, compute_loss ? &row_loss : NULL);
+		residual += regularization_gradient;
+		loss += row_loss;
+
+		gmf_features_axpy(X, r, residual, gradient);
+	}
+
+	return loss;
+}
+
+static float (*__row_term(const LinearModel* lm))(float, float, const LinearModel*, float*)
+{
+	if (lm->loss == &gmf_loss_squared && lm->loss_gradient == &gmf_loss_gradient_squared)
+		return &__squared_term;
+	if (lm->loss == &gmf_loss_cross_entropy && lm->loss_gradient == &gmf_loss_gradient_cross_entropy)
+		return &__cross_entropy_term;
+	if (lm->loss == &gmf_loss_absolute && lm->loss_gradient == &gmf_loss_gradient_absolute)
+		return &__absolute_term;
+	if (lm->loss == &gmf_loss_hinge && lm->loss_gradient == &gmf_loss_gradient_hinge)
+		return &__hinge_term;
+	if (lm->loss == &gmf_loss_huber && lm->loss_gradient == &gmf_loss_gradient_huber)
+		return &__huber_term;
+	return NULL;
+}
+
+double gmf_fused_loss_accumulate(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		const float regularization_gradient,
+		const size_t* row_idx,
+		const size_t row_start,
+		const size_t row_end,
+		const bool compute_loss,
+		float* gradient)
+{
+	float (*activation)(float, const LinearModel*) = __scalar_activation(lm);
+	float (*row_term)(float, float, const LinearModel*, float*) = __row_term(lm);
+	if (!activation || !row_term)
+		err("Fused loss kernels only support the built-in activations and losses.");
+
+	return __fused_rows(X, Y, lm, activation, row_term, regularization_gradient, row_idx, row_start, row_end, compute_loss, gradient);
+}
+
+// bring the weights used by row r up to date (only the non-zero columns of FEATURES_CSR)
+static void __lazy_update_row(
+		const FeatureMatrix* X,
+		const size_t r,
+		LazyRegularization* lazy,
+		float* W)
+{
+	if (X->type != FEATURES_CSR)
+	{
+		for (size_t c = 0; c < X->n_columns; ++c)
+			gmf_regularization_lazy_update(lazy, c, W);
+		return;
+	}
+
+	const size_t row = gmf_features_data_row(X, r);
+	for (size_t i = X->row_ptr[row]; i < X->row_ptr[row + 1]; ++i)
+		gmf_regularization_lazy_update(lazy, X->col_idx[i], W);
+}
+
+double gmf_fused_loss_sgd(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		const float learning_rate,
+		const float regularization_gradient,
+		const size_t* row_idx,
+		const size_t n_samples,
+		const size_t n_loss_samples,
+		const bool proximal,
+		LazyRegularization* lazy,
+		float* W)
+{
+	float (*activation)(float, const LinearModel*) = __scalar_activation(lm);
+	float (*row_term)(float, float, const LinearModel*, float*) = __row_term(lm);
+	if (!activation || !row_term)
+		err("Fused loss kernels only support the built-in activations and losses.");
+
+	const size_t first = lm->params->exclude_bias ? 1 : 0;
+	const size_t first_loss = n_loss_samples < n_samples ? n_samples - n_loss_samples : 0;
+
+	double loss = 0.0;
+	for (size_t i = 0; i < n_samples; ++i)
+	{
+		const size_t r = row_idx[i];
+		if (lazy)
+			__lazy_update_row(X, r, lazy, W);
+		const float xw = gmf_features_dot(X, r, W);
+
+		float row_loss = 0.0f;
+		float residual = row_term(Y->data[r], activation(xw, lm), lm, i >= first_loss ? &row_loss : NULL);
+		loss += row_loss;
+
+		gmf_features_axpy(X, r, -learning_rate * (residual + regularization_gradient), W);
+		if (lazy)
+			gmf_regularization_lazy_step(lazy, learning_rate, W);
+		else if (proximal)
+			gmf_regularization_proximal(lm->regularization, lm->params->regularization_params, learning_rate, first, W, X->n_columns);
+	}
+
+	return loss;
+}
+
+double gmf_fused_loss_sgd_batch(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		const float learning_rate,
+		const float regularization_gradient,
+		const size_t* row_idx,
+		const size_t n_rows,
+		const bool compute_loss,
+		LazyRegularization* lazy,
+		float* residuals,
+		float* W)
+{
+	float (*activation)(float, const LinearModel*) = __scalar_activation(lm);
+	float (*row_term)(float, float, const LinearModel*, float*) = __row_term(lm);
+	if (!activation || !row_term)
+		err("Fused loss kernels only support the built-in activations and losses.");
+
+	// every residual is computed with the same W
+	double loss = 0.0;
+	for (size_t i = 0; i < n_rows; ++i)
+	{
+		const size_t r = row_idx[i];
+		if (lazy)
+			__lazy_update_row(X, r, lazy, W);
+		const float xw = gmf_features_dot(X, r, W);
+
+		float row_loss = 0.0f;
+		residuals[i] = row_term(Y->data[r], activation(xw, lm), lm, compute_loss ? &row_loss : NULL) + regularization_gradient;
+		loss += row_loss;
+	}
+
+	const float step = learning_rate / (float)n_rows;
+	for (size_t i = 0; i < n_rows; ++i)
+		gmf_features_axpy(X, row_idx[i], -step * residuals[i], W);
+
+	if (lazy)
+		gmf_regularization_lazy_step(lazy, learning_rate, W);
+	else if (gmf_regularization_is_proximal(lm->regularization))
+		gmf_regularization_proximal(lm->regularization, lm->params->regularization_params, learning_rate, lm->params->exclude_bias ? 1 : 0, W, X->n_columns);
+
+	return loss;
+}
+
+double gmf_fused_loss_value(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		const size_t* row_idx,
+		const size_t n_rows)
+{
+	float (*activation)(float, const LinearModel*) = __scalar_activation(lm);
+	float (*row_term)(float, float, const LinearModel*, float*) = __row_term(lm);
+	if (!activation || !row_term)
+		err("Fused loss kernels only support the built-in activations and losses.");
+
+	const float* W = lm->W->data;
+
+	double loss = 0.0;
+	for (size_t i = 0; i < n_rows; ++i)
+	{
+		const size_t r = row_idx ? row_idx[i] : i;
+
+		float row_loss = 0.0f;
+		row_term(Y->data[r], activation(gmf_features_dot(X, r, W), lm), lm, &row_loss);
+		loss += row_loss;
+	}
+
+	return loss;
+}
+
+static float __fused_pass(
+		const Matrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		float (*row_term)(float, float, const LinearModel*, float*),
+		Matrix** loss_gradient)
+{
+	float (*activation)(float, const LinearModel*) = __scalar_activation(lm);
+	if (!activation)
+		err("Fused loss kernels only support the built-in activations. Use the unfused loss and loss gradient instead.");
+
+	const size_t n_columns = X->n_columns;
+	float* gradient = (*loss_gradient)->data;
+	for (size_t c = 0; c < n_columns; ++c)
+		gradient[c] = 0.0f;
+
+	// regularization gradient is a scalar added to every residual
+	// (proximal regularizations are applied to W after the update instead)
+	float regularization_gradient = 0.0f;
+	if (lm->regularization_gradient && !gmf_regularization_is_proximal(lm->regularization))
+		regularization_gradient = lm->regularization_gradient(lm->params->regularization_params, lm->W);
+
+	const FeatureMatrix features = gmf_features_view(X);
+	double loss = __fused_rows(&features, Y, lm, activation, row_term, regularization_gradient, NULL, 0, X->n_rows, true, gradient);
+
+	for (size_t c = 0; c < n_columns; ++c)
+		gradient[c] /= (float)X->n_rows;
+
+	if (lm->regularization)
+		loss += lm->regularization(lm->params->regularization_params, lm->W);
+
+	return (float)loss;
+}
+
+float gmf_fused_loss_squared(
+		const Matrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		Matrix** loss_gradient)
+{
+	return __fused_pass(X, Y, lm, &__squared_term, loss_gradient);
+}
+
+float gmf_fused_loss_cross_entropy(
+		const Matrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		Matrix** loss_gradient)
+{
+	return __fused_pass(X, Y, lm, &__cross_entropy_term, loss_gradient);
+}
+
+float gmf_fused_loss_absolute(
+		const Matrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		Matrix** loss_gradient)
+{
+	return __fused_pass(X, Y, lm, &__absolute_term, loss_gradient);
+}
+
+float gmf_fused_loss_hinge(
+		const Matrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		Matrix** loss_gradient)
+{
+	return __fused_pass(X, Y, lm, &__hinge_term, loss_gradient);
+}
+
+float gmf_fused_loss_huber(
+		const Matrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		Matrix** loss_gradient)
+{
+	return __fused_pass(X, Y, lm, &__huber_term, loss_gradient);
+}
+
+float (*gmf_fused_loss_select(const LinearModel* lm))(const Matrix*, const Matrix*, const LinearModel*, Matrix**)
+{
+	if (!__scalar_activation(lm))
+		return NULL;
+
+	float (*row_term)(float, float, const LinearModel*, float*) = __row_term(lm);
+	if (row_term == &__squared_term)
+		return &gmf_fused_loss_squared;
+	if (row_term == &__cross_entropy_term)
+		return &gmf_fused_loss_cross_entropy;
+	if (row_term == &__absolute_term)
+		return &gmf_fused_loss_absolute;
+	if (row_term == &__hinge_term)
+		return &gmf_fused_loss_hinge;
+	if (row_term == &__huber_term)
+		return &gmf_fused_loss_huber;
+
+	return NULL;
+}
@@ -0,0 +1,1040 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "kernels.h"
+
+// SIMD paths need GCC/Clang target attributes and x86 intrinsics
+#if !defined(GMF_KERNEL_SCALAR) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define GMF_KERNEL_X86
+#include <immintrin.h>
+#define GMF_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define GMF_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+// Cephes exp/log constants
+#define GMF_EXP_HI 88.0f // e^88 still fits a float
+#define GMF_EXP_LO -87.3365447504f // keeps 2^n a normal float
+#define GMF_LOG2E 1.44269504088896341f
+#define GMF_LN2_HI 0.693359375f
+#define GMF_LN2_LO -2.12194440e-4f
+#define GMF_SQRT_HALF 0.707106781186547524f
+
+typedef enum loss_kind
+{
+	LOSS_SQUARED,
+	LOSS_CROSS_ENTROPY,
+	LOSS_ABSOLUTE,
+	LOSS_HINGE,
+	LOSS_HUBER
+} loss_kind;
+
+typedef union float_bits
+{
+	float f;
+	uint32_t u;
+} float_bits;
+
+// the CPU is only queried once (kernels can run on several threads at
+// once, e.g. OVR submodels) and __isa is only written by gmf_kernel_set_isa()
+static pthread_once_t __best_isa_once = PTHREAD_ONCE_INIT;
+static KernelISA __best_isa = KERNEL_SCALAR;
+static KernelISA __isa = KERNEL_AUTO;
+
+static void __detect_isa()
+{
+#ifdef GMF_KERNEL_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		__best_isa = KERNEL_AVX512;
+	else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		__best_isa = KERNEL_AVX2;
+#endif
+}
+
+void gmf_kernel_set_isa(const KernelISA isa)
+{
+	pthread_once(&__best_isa_once, &__detect_isa);
+	__isa = isa == KERNEL_AUTO || isa > __best_isa ? __best_isa : isa;
+}
+
+KernelISA gmf_kernel_isa()
+{
+	pthread_once(&__best_isa_once, &__detect_isa);
+	return __isa == KERNEL_AUTO ? __best_isa : __isa;
+}
+
+/*
+ * Scalar kernels. Also used for the tails of the SIMD loops.
+ */
+
+static inline float __exp_scalar(float x)
+{
+	x = x > GMF_EXP_HI ? GMF_EXP_HI : x;
+	x = x < GMF_EXP_LO ? GMF_EXP_LO : x;
+
+	// e^x = 2^n * e^r with |r| <= ln(2) / 2
+	const float n = floorf(x * GMF_LOG2E + 0.5f);
+	x = x - n * GMF_LN2_HI - n * GMF_LN2_LO;
+
+	float y = 1.9875691500e-4f;
+	y = y * x + 1.3981999507e-3f;
+	y = y * x + 8.3334519073e-3f;
+	y = y * x + 4.1665795894e-2f;
+	y = y * x + 1.6666665459e-1f;
+	y = y * x + 5.0000001201e-1f;
+	y = y * x * x + x + 1.0f;
+
+	float_bits scale = { .u = (uint32_t)((int32_t)n + 127) << 23 };
+	return y * scale.f;
+}
+
+static inline float __log_scalar(const float x)
+{
+	// x = 2^e * m with m in [sqrt(0.5), sqrt(2))
+	float_bits v = { .f = x };
+	float e = (float)((int32_t)((v.u >> 23) & 0xff) - 126);
+	v.u = (v.u & 0x007fffffu) | 0x3f000000u;
+	float m = v.f;
+	if (m < GMF_SQRT_HALF)
+	{
+		e -= 1.0f;
+		m = m + m - 1.0f;
+	}
+	else
+		m = m - 1.0f;
+
+	const float z = m * m;
+	float y = 7.0376836292e-2f;
+	y = y * m - 1.1514610310e-1f;
+	y = y * m + 1.1676998740e-1f;
+	y = y * m - 1.2420140846e-1f;
+	y = y * m + 1.4249322787e-1f;
+	y = y * m - 1.6668057665e-1f;
+	y = y * m + 2.0000714765e-1f;
+	y = y * m - 2.4999993993e-1f;
+	y = y * m + 3.3333331174e-1f;
+	y = y * m * z;
+
+	y += e * GMF_LN2_LO;
+	y -= 0.5f * z;
+	return m + y + e * GMF_LN2_HI;
+}
+
+float gmf_kernel_exp(const float x)
+{
+	return __exp_scalar(x);
+}
+
+float gmf_kernel_log(const float x)
+{
+	return __log_scalar(x);
+}
+
+static inline float __loss_element(
+		const loss_kind kind,
+		float y,
+		float yhat,
+		const float delta)
+{
+	const float diff = y - yhat;
+	switch (kind)
+	{
+		case LOSS_SQUARED:
+			return diff * diff;
+		case LOSS_CROSS_ENTROPY:
+		{
+			// constrain yhat between [0.01, 0.99]
+			const float p = fminf(fmaxf(yhat, 0.01f), 0.99f);
+			return -y * __log_scalar(p) - (1.0f - y) * __log_scalar(1.0f - p);
+		}
+		case LOSS_ABSOLUTE:
+			return fabsf(diff);
+		case LOSS_HINGE:
+			// hinge loss is defined for {-1, 1} so 0 counts as -1
+			y = fabsf(y) < 0.0001f ? -1.0f : y;
+			yhat = fabsf(yhat) < 0.0001f ? -1.0f : yhat;
+			return fmaxf(1.0f - y * yhat, 0.0f);
+		case LOSS_HUBER:
+		{
+			// m * (|d| - m / 2) with m = min(|d|, delta) covers both pieces
+			const float a = fabsf(diff);
+			const float m = fminf(a, delta);
+			return m * (a - 0.5f * m);
+		}
+	}
+
+	return 0.0f;
+}
+
+static double __loss_scalar(
+		const loss_kind kind,
+		const float* y,
+		const float* yhat,
+		const size_t start,
+		const size_t n,
+		const float delta)
+{
+	double loss = 0.0;
+	for (size_t i = start; i < n; ++i)
+		loss += __loss_element(kind, y[i], yhat[i], delta);
+	return loss;
+}
+
+static void __sigmoid_scalar(
+		float* z,
+		const size_t start,
+		const size_t n,
+		const bool hard,
+		const float threshold)
+{
+	for (size_t i = start; i < n; ++i)
+	{
+		const float s = 1.0f / (1.0f + __exp_scalar(-z[i]));
+		z[i] = hard ? (s > threshold ? 1.0f : 0.0f) : s;
+	}
+}
+
+static void __exp_array_scalar(
+		float* z,
+		const size_t start,
+		const size_t n)
+{
+	for (size_t i = start; i < n; ++i)
+		z[i] = __exp_scalar(z[i]);
+}
+
+static void __gemv_scalar(
+		const float* X,
+		const size_t start,
+		const size_t n_rows,
+		const size_t n_columns,
+		const size_t x_stride,
+		const float* w,
+		float* y,
+		const size_t y_stride,
+		const bool accumulate)
+{
+	for (size_t r = start; r < n_rows; ++r)
+	{
+		const float* x = X + r * x_stride;
+		float dot = 0.0f;
+		for (size_t c = 0; c < n_columns; ++c)
+			dot += x[c] * w[c];
+		y[r * y_stride] = accumulate ? y[r * y_stride] + dot : dot;
+	}
+}
+
+// rows [row_start, row_end) and columns [column_start, column_end) of
+// Y = X * W where Y is (n_rows, n_columns) and W is (n_inner, n_columns)
+static void __gemm_scalar(
+		const float* X,
+		const size_t row_start,
+		const size_t row_end,
+		const size_t n_inner,
+		const size_t x_stride,
+		const float* W,
+		const size_t column_start,
+		const size_t column_end,
+		const size_t n_columns,
+		float* Y,
+		const bool accumulate)
+{
+	for (size_t r = row_start; r < row_end; ++r)
+	{
+		const float* x = X + r * x_stride;
+		float* y = Y + r * n_columns;
+		if (!accumulate)
+			for (size_t j = column_start; j < column_end; ++j)
+				y[j] = 0.0f;
+		for (size_t k = 0; k < n_inner; ++k)
+		{
+			const float* w = W + k * n_columns;
+			for (size_t j = column_start; j < column_end; ++j)
+				y[j] += x[k] * w[j];
+		}
+	}
+}
+
+#ifdef GMF_KERNEL_X86
+
+/*
+ * AVX2 + FMA kernels (8 floats at a time)
+ */
+
+GMF_TARGET_AVX2 static inline __m256 __exp_avx2(__m256 x)
+{
+	x = _mm256_min_ps(x, _mm256_set1_ps(GMF_EXP_HI));
+	x = _mm256_max_ps(x, _mm256_set1_ps(GMF_EXP_LO));
+
+	const __m256 n = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(GMF_LOG2E), _mm256_set1_ps(0.5f)));
+	x = _mm256_fnmadd_ps(n, _mm256_set1_ps(GMF_LN2_HI), x);
+	x = _mm256_fnmadd_ps(n, _mm256_set1_ps(GMF_LN2_LO), x);
+
+	__m256 y = _mm256_set1_ps(1.9875691500e-4f);
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507e-3f));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073e-3f));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894e-2f));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459e-1f));
+	y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201e-1f));
+	y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+	__m256i scale = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+	return _mm256_mul_ps(y, _mm256_castsi256_ps(_mm256_slli_epi32(scale, 23)));
+}
+
+GMF_TARGET_AVX2 static inline __m256 __log_avx2(const __m256 x)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256i bits = _mm256_castps_si256(x);
+	__m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(
+				_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xff)),
+				_mm256_set1_epi32(126)));
+	const __m256 mantissa = _mm256_castsi256_ps(_mm256_or_si256(
+				_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+				_mm256_set1_epi32(0x3f000000)));
+
+	// branchless version of the m < sqrt(0.5) adjustment
+	const __m256 small = _mm256_cmp_ps(mantissa, _mm256_set1_ps(GMF_SQRT_HALF), _CMP_LT_OQ);
+	e = _mm256_sub_ps(e, _mm256_and_ps(small, one));
+	const __m256 m = _mm256_add_ps(_mm256_sub_ps(mantissa, one), _mm256_and_ps(small, mantissa));
+
+	const __m256 z = _mm256_mul_ps(m, m);
+	__m256 y = _mm256_set1_ps(7.0376836292e-2f);
+	y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.1514610310e-1f));
+	y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(1.1676998740e-1f));
+	y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.2420140846e-1f));
+	y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(1.4249322787e-1f));
+	y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.6668057665e-1f));
+	y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(2.0000714765e-1f));
+	y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-2.4999993993e-1f));
+	y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(3.3333331174e-1f));
+	y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+
+	y = _mm256_fmadd_ps(e, _mm256_set1_ps(GMF_LN2_LO), y);
+	y = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, y);
+	return _mm256_fmadd_ps(e, _mm256_set1_ps(GMF_LN2_HI), _mm256_add_ps(m, y));
+}
+
+GMF_TARGET_AVX2 static inline __m256 __loss_avx2_element(
+		const loss_kind kind,
+		__m256 y,
+		__m256 yhat,
+		const __m256 delta)
+{
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 diff = _mm256_sub_ps(y, yhat);
+	switch (kind)
+	{
+		case LOSS_SQUARED:
+			return _mm256_mul_ps(diff, diff);
+		case LOSS_CROSS_ENTROPY:
+		{
+			const __m256 p = _mm256_min_ps(_mm256_max_ps(yhat, _mm256_set1_ps(0.01f)), _mm256_set1_ps(0.99f));
+			const __m256 loss = _mm256_fmadd_ps(y, __log_avx2(p), _mm256_mul_ps(_mm256_sub_ps(one, y), __log_avx2(_mm256_sub_ps(one, p))));
+			return _mm256_sub_ps(_mm256_setzero_ps(), loss);
+		}
+		case LOSS_ABSOLUTE:
+			return _mm256_and_ps(diff, abs_mask);
+		case LOSS_HINGE:
+		{
+			const __m256 zero_label = _mm256_set1_ps(0.0001f);
+			const __m256 minus_one = _mm256_set1_ps(-1.0f);
+			y = _mm256_blendv_ps(y, minus_one, _mm256_cmp_ps(_mm256_and_ps(y, abs_mask), zero_label, _CMP_LT_OQ));
+			yhat = _mm256_blendv_ps(yhat, minus_one, _mm256_cmp_ps(_mm256_and_ps(yhat, abs_mask), zero_label, _CMP_LT_OQ));
+			return _mm256_max_ps(_mm256_fnmadd_ps(y, yhat, one), _mm256_setzero_ps());
+		}
+		case LOSS_HUBER:
+		{
+			const __m256 a = _mm256_and_ps(diff, abs_mask);
+			const __m256 m = _mm256_min_ps(a, delta);
+			return _mm256_mul_ps(m, _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), m, a));
+		}
+	}
+
+	return _mm256_setzero_ps();
+}
+
+GMF_TARGET_AVX2 static double __loss_avx2(
+		const loss_kind kind,
+		const float* y,
+		const float* yhat,
+		const size_t n,
+		const float delta)
+{
+	const __m256 delta_v = _mm256_set1_ps(delta);
+	__m256d sum_low = _mm256_setzero_pd();
+	__m256d sum_high = _mm256_setzero_pd();
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		const __m256 loss = __loss_avx2_element(kind, _mm256_loadu_ps(y + i), _mm256_loadu_ps(yhat + i), delta_v);
+		sum_low = _mm256_add_pd(sum_low, _mm256_cvtps_pd(_mm256_castps256_ps128(loss)));
+		sum_high = _mm256_add_pd(sum_high, _mm256_cvtps_pd(_mm256_extractf128_ps(loss, 1)));
+	}
+
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(sum_low, sum_high));
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + __loss_scalar(kind, y, yhat, i, n, delta);
+}
+
+GMF_TARGET_AVX2 static void __sigmoid_avx2(
+		float* z,
+		const size_t n,
+		const bool hard,
+		const float threshold)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 threshold_v = _mm256_set1_ps(threshold);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		const __m256 minus_z = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(z + i));
+		__m256 s = _mm256_div_ps(one, _mm256_add_ps(one, __exp_avx2(minus_z)));
+		if (hard)
+			s = _mm256_and_ps(_mm256_cmp_ps(s, threshold_v, _CMP_GT_OQ), one);
+		_mm256_storeu_ps(z + i, s);
+	}
+
+	__sigmoid_scalar(z, i, n, hard, threshold);
+}
+
+GMF_TARGET_AVX2 static void __exp_array_avx2(
+		float* z,
+		const size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(z + i, __exp_avx2(_mm256_loadu_ps(z + i)));
+
+	__exp_array_scalar(z, i, n);
+}
+
+GMF_TARGET_AVX2 static inline float __sum_avx2(const __m256 v)
+{
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+	return _mm_cvtss_f32(sum);
+}
+
+// 4 rows at a time so every load of w is used 4 times
+GMF_TARGET_AVX2 static void __gemv_avx2(
+		const float* X,
+		const size_t n_rows,
+		const size_t n_columns,
+		const size_t x_stride,
+		const float* w,
+		float* y,
+		const size_t y_stride,
+		const bool accumulate)
+{
+	size_t r = 0;
+	for (; r + 4 <= n_rows; r += 4)
+	{
+		const float* x0 = X + r * x_stride;
+		const float* x1 = x0 + x_stride;
+		const float* x2 = x1 + x_stride;
+		const float* x3 = x2 + x_stride;
+		__m256 sum0 = _mm256_setzero_ps();
+		__m256 sum1 = _mm256_setzero_ps();
+		__m256 sum2 = _mm256_setzero_ps();
+		__m256 sum3 = _mm256_setzero_ps();
+		size_t c = 0;
+		for (; c + 8 <= n_columns; c += 8)
+		{
+			const __m256 w_v = _mm256_loadu_ps(w + c);
+			sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(x0 + c), w_v, sum0);
+			sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(x1 + c), w_v, sum1);
+			sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(x2 + c), w_v, sum2);
+			sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(x3 + c), w_v, sum3);
+		}
+
+		float dot[4] = { __sum_avx2(sum0), __sum_avx2(sum1), __sum_avx2(sum2), __sum_avx2(sum3) };
+		for (; c < n_columns; ++c)
+		{
+			dot[0] += x0[c] * w[c];
+			dot[1] += x1[c] * w[c];
+			dot[2] += x2[c] * w[c];
+			dot[3] += x3[c] * w[c];
+		}
+		for (size_t i = 0; i < 4; ++i)
+			y[(r + i) * y_stride] = accumulate ? y[(r + i) * y_stride] + dot[i] : dot[i];
+	}
+
+	__gemv_scalar(X, r, n_rows, n_columns, x_stride, w, y, y_stride, accumulate);
+}
+
+// (4 rows, 16 columns) tiles of Y held in registers while the inner
+// dimension streams past: every load of W is used 4 times
+GMF_TARGET_AVX2 static void __gemm_avx2(
+		const float* X,
+		const size_t n_rows,
+		const size_t n_inner,
+		const size_t x_stride,
+		const float* W,
+		const size_t n_columns,
+		float* Y,
+		const bool accumulate)
+{
+	size_t r = 0;
+	for (; r + 4 <= n_rows; r += 4)
+	{
+		const float* x0 = X + r * x_stride;
+		const float* x1 = x0 + x_stride;
+		const float* x2 = x1 + x_stride;
+		const float* x3 = x2 + x_stride;
+		float* y0 = Y + r * n_columns;
+		float* y1 = y0 + n_columns;
+		float* y2 = y1 + n_columns;
+		float* y3 = y2 + n_columns;
+		size_t j = 0;
+		for (; j + 16 <= n_columns; j += 16)
+		{
+			__m256 sum00 = accumulate ? _mm256_loadu_ps(y0 + j) : _mm256_setzero_ps();
+			__m256 sum01 = accumulate ? _mm256_loadu_ps(y0 + j + 8) : _mm256_setzero_ps();
+			__m256 sum10 = accumulate ? _mm256_loadu_ps(y1 + j) : _mm256_setzero_ps();
+			__m256 sum11 = accumulate ? _mm256_loadu_ps(y1 + j + 8) : _mm256_setzero_ps();
+			__m256 sum20 = accumulate ? _mm256_loadu_ps(y2 + j) : _mm256_setzero_ps();
+			__m256 sum21 = accumulate ? _mm256_loadu_ps(y2 + j + 8) : _mm256_setzero_ps();
+			__m256 sum30 = accumulate ? _mm256_loadu_ps(y3 + j) : _mm256_setzero_ps();
+			__m256 sum31 = accumulate ? _mm256_loadu_ps(y3 + j + 8) : _mm256_setzero_ps();
+			for (size_t k = 0; k < n_inner; ++k)
+			{
+				const __m256 w0 = _mm256_loadu_ps(W + k * n_columns + j);
+				const __m256 w1 = _mm256_loadu_ps(W + k * n_columns + j + 8);
+				__m256 x_v = _mm256_broadcast_ss(x0 + k);
+				sum00 = _mm256_fmadd_ps(x_v, w0, sum00);
+				sum01 = _mm256_fmadd_ps(x_v, w1, sum01);
+				x_v = _mm256_broadcast_ss(x1 + k);
+				sum10 = _mm256_fmadd_ps(x_v, w0, sum10);
+				sum11 = _mm256_fmadd_ps(x_v, w1, sum11);
+				x_v = _mm256_broadcast_ss(x2 + k);
+				sum20 = _mm256_fmadd_ps(x_v, w0, sum20);
+				sum21 = _mm256_fmadd_ps(x_v, w1, sum21);
+				x_v = _mm256_broadcast_ss(x3 + k);
+				sum30 = _mm256_fmadd_ps(x_v, w0, sum30);
+				sum31 = _mm256_fmadd_ps(x_v, w1, sum31);
+			}
+			_mm256_storeu_ps(y0 + j, sum00);
+			_mm256_storeu_ps(y0 + j + 8, sum01);
+			_mm256_storeu_ps(y1 + j, sum10);
+			_mm256_storeu_ps(y1 + j + 8, sum11);
+			_mm256_storeu_ps(y2 + j, sum20);
+			_mm256_storeu_ps(y2 + j + 8, sum21);
+			_mm256_storeu_ps(y3 + j, sum30);
+			_mm256_storeu_ps(y3 + j + 8, sum31);
+		}
+
+		__gemm_scalar(X, r, r + 4, n_inner, x_stride, W, j, n_columns, n_columns, Y, accumulate);
+	}
+
+	__gemm_scalar(X, r, n_rows, n_inner, x_stride, W, 0, n_columns, n_columns, Y, accumulate);
+}
+
+/*
+ * AVX-512 kernels (16 floats at a time)
+ */
+
+GMF_TARGET_AVX512 static inline __m512 __exp_avx512(__m512 x)
+{
+	x = _mm512_min_ps(x, _mm512_set1_ps(GMF_EXP_HI));
+	x = _mm512_max_ps(x, _mm512_set1_ps(GMF_EXP_LO));
+
+	const __m512 n = _mm512_roundscale_ps(_mm512_fmadd_ps(x, _mm512_set1_ps(GMF_LOG2E), _mm512_set1_ps(0.5f)), _MM_FROUND_TO_NEG_INF);
+	x = _mm512_fnmadd_ps(n, _mm512_set1_ps(GMF_LN2_HI), x);
+	x = _mm512_fnmadd_ps(n, _mm512_set1_ps(GMF_LN2_LO), x);
+
+	__m512 y = _mm512_set1_ps(1.9875691500e-4f);
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(1.3981999507e-3f));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(8.3334519073e-3f));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(4.1665795894e-2f));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(1.6666665459e-1f));
+	y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(5.0000001201e-1f));
+	y = _mm512_fmadd_ps(y, _mm512_mul_ps(x, x), _mm512_add_ps(x, _mm512_set1_ps(1.0f)));
+
+	__m512i scale = _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127));
+	return _mm512_mul_ps(y, _mm512_castsi512_ps(_mm512_slli_epi32(scale, 23)));
+}
+
+GMF_TARGET_AVX512 static inline __m512 __log_avx512(const __m512 x)
+{
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512i bits = _mm512_castps_si512(x);
+	__m512 e = _mm512_cvtepi32_ps(_mm512_sub_epi32(
+				_mm512_and_si512(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(0xff)),
+				_mm512_set1_epi32(126)));
+	const __m512 mantissa = _mm512_castsi512_ps(_mm512_or_si512(
+				_mm512_and_si512(bits, _mm512_set1_epi32(0x007fffff)),
+				_mm512_set1_epi32(0x3f000000)));
+
+	// branchless version of the m < sqrt(0.5) adjustment
+	const __mmask16 small = _mm512_cmp_ps_mask(mantissa, _mm512_set1_ps(GMF_SQRT_HALF), _CMP_LT_OQ);
+	e = _mm512_mask_sub_ps(e, small, e, one);
+	__m512 m = _mm512_sub_ps(mantissa, one);
+	m = _mm512_mask_add_ps(m, small, m, mantissa);
+
+	const __m512 z = _mm512_mul_ps(m, m);
+	__m512 y = _mm512_set1_ps(7.0376836292e-2f);
+	y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(-1.1514610310e-1f));
+	y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(1.1676998740e-1f));
+	y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(-1.2420140846e-1f));
+	y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(1.4249322787e-1f));
+	y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(-1.6668057665e-1f));
+	y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(2.0000714765e-1f));
+	y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(-2.4999993993e-1f));
+	y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(3.3333331174e-1f));
+	y = _mm512_mul_ps(_mm512_mul_ps(y, m), z);
+
+	y = _mm512_fmadd_ps(e, _mm512_set1_ps(GMF_LN2_LO), y);
+	y = _mm512_fnmadd_ps(_mm512_set1_ps(0.5f), z, y);
+	return _mm512_fmadd_ps(e, _mm512_set1_ps(GMF_LN2_HI), _mm512_add_ps(m, y));
+}
+
+GMF_TARGET_AVX512 static inline __m512 __loss_avx512_element(
+		const loss_kind kind,
+		__m512 y,
+		__m512 yhat,
+		const __m512 delta)
+{
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512 diff = _mm512_sub_ps(y, yhat);
+	switch (kind)
+	{
+		case LOSS_SQUARED:
+			return _mm512_mul_ps(diff, diff);
+		case LOSS_CROSS_ENTROPY:
+		{
+			const __m512 p = _mm512_min_ps(_mm512_max_ps(yhat, _mm512_set1_ps(0.01f)), _mm512_set1_ps(0.99f));
+			const __m512 loss = _mm512_fmadd_ps(y, __log_avx512(p), _mm512_mul_ps(_mm512_sub_ps(one, y), __log_avx512(_mm512_sub_ps(one, p))));
+			return _mm512_sub_ps(_mm512_setzero_ps(), loss);
+		}
+		case LOSS_ABSOLUTE:
+			return _mm512_abs_ps(diff);
+		case LOSS_HINGE:
+		{
+			const __m512 zero_label = _mm512_set1_ps(0.0001f);
+			const __m512 minus_one = _mm512_set1_ps(-1.0f);
+			y = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(_mm512_abs_ps(y), zero_label, _CMP_LT_OQ), y, minus_one);
+			yhat = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(_mm512_abs_ps(yhat), zero_label, _CMP_LT_OQ), yhat, minus_one);
+			return _mm512_max_ps(_mm512_fnmadd_ps(y, yhat, one), _mm512_setzero_ps());
+		}
+		case LOSS_HUBER:
+		{
+			const __m512 a = _mm512_abs_ps(diff);
+			const __m512 m = _mm512_min_ps(a, delta);
+			return _mm512_mul_ps(m, _mm512_fnmadd_ps(_mm512_set1_ps(0.5f), m, a));
+		}
+	}
+
+	return _mm512_setzero_ps();
+}
+
+GMF_TARGET_AVX512 static double __loss_avx512(
+		const loss_kind kind,
+		const float* y,
+		const float* yhat,
+		const size_t n,
+		const float delta)
+{
+	const __m512 delta_v = _mm512_set1_ps(delta);
+	__m512d sum_low = _mm512_setzero_pd();
+	__m512d sum_high = _mm512_setzero_pd();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		const __m512 loss = __loss_avx512_element(kind, _mm512_loadu_ps(y + i), _mm512_loadu_ps(yhat + i), delta_v);
+		sum_low = _mm512_add_pd(sum_low, _mm512_cvtps_pd(_mm512_castps512_ps256(loss)));
+		sum_high = _mm512_add_pd(sum_high, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(loss), 1))));
+	}
+
+	double lanes[8];
+	_mm512_storeu_pd(lanes, _mm512_add_pd(sum_low, sum_high));
+	double loss = 0.0;
+	for (size_t l = 0; l < 8; ++l)
+		loss += lanes[l];
+	return loss + __loss_scalar(kind, y, yhat, i, n, delta);
+}
+
+GMF_TARGET_AVX512 static void __sigmoid_avx512(
+		float* z,
+		const size_t n,
+		const bool hard,
+		const float threshold)
+{
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512 threshold_v = _mm512_set1_ps(threshold);
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		const __m512 minus_z = _mm512_sub_ps(_mm512_setzero_ps(), _mm512_loadu_ps(z + i));
+		__m512 s = _mm512_div_ps(one, _mm512_add_ps(one, __exp_avx512(minus_z)));
+		if (hard)
+			s = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(s, threshold_v, _CMP_GT_OQ), one);
+		_mm512_storeu_ps(z + i, s);
+	}
+
+	__sigmoid_scalar(z, i, n, hard, threshold);
+}
+
+GMF_TARGET_AVX512 static void __exp_array_avx512(
+		float* z,
+		const size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16)
+		_mm512_storeu_ps(z + i, __exp_avx512(_mm512_loadu_ps(z + i)));
+
+	__exp_array_scalar(z, i, n);
+}
+
+// 4 rows at a time so every load of w is used 4 times
+GMF_TARGET_AVX512 static void __gemv_avx512(
+		const float* X,
+		const size_t n_rows,
+		const size_t n_columns,
+		const size_t x_stride,
+		const float* w,
+		float* y,
+		const size_t y_stride,
+		const bool accumulate)
+{
+	size_t r = 0;
+	for (; r + 4 <= n_rows; r += 4)
+	{
+		const float* x0 = X + r * x_stride;
+		const float* x1 = x0 + x_stride;
+		const float* x2 = x1 + x_stride;
+		const float* x3 = x2 + x_stride;
+		__m512 sum0 = _mm512_setzero_ps();
+		__m512 sum1 = _mm512_setzero_ps();
+		__m512 sum2 = _mm512_setzero_ps();
+		__m512 sum3 = _mm512_setzero_ps();
+		size_t c = 0;
+		for (; c + 16 <= n_columns; c += 16)
+		{
+			const __m512 w_v = _mm512_loadu_ps(w + c);
+			sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(x0 + c), w_v, sum0);
+			sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(x1 + c), w_v, sum1);
+			sum2 = _mm512_fmadd_ps(_mm512_loadu_ps(x2 + c), w_v, sum2);
+			sum3 = _mm512_fmadd_ps(_mm512_loadu_ps(x3 + c), w_v, sum3);
+		}
+
+		// masked loads handle the remaining columns
+		if (c < n_columns)
+		{
+			const __mmask16 tail = (__mmask16)((1u << (n_columns - c)) - 1u);
+			const __m512 w_v = _mm512_maskz_loadu_ps(tail, w + c);
+			sum0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, x0 + c), w_v, sum0);
+			sum1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, x1 + c), w_v, sum1);
+			sum2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, x2 + c), w_v, sum2);
+			sum3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, x3 + c), w_v, sum3);
+		}
+
+		const float dot[4] = {
+			_mm512_reduce_add_ps(sum0),
+			_mm512_reduce_add_ps(sum1),
+			_mm512_reduce_add_ps(sum2),
+			_mm512_reduce_add_ps(sum3)
+		};
+		for (size_t i = 0; i < 4; ++i)
+			y[(r + i) * y_stride] = accumulate ? y[(r + i) * y_stride] + dot[i] : dot[i];
+	}
+
+	__gemv_scalar(X, r, n_rows, n_columns, x_stride, w, y, y_stride, accumulate);
+}
+
+// (4 rows, 32 columns) tiles of Y held in registers while the inner
+// dimension streams past, masked (4 rows, 16 columns) tiles for the rest
+GMF_TARGET_AVX512 static void __gemm_avx512(
+		const float* X,
+		const size_t n_rows,
+		const size_t n_inner,
+		const size_t x_stride,
+		const float* W,
+		const size_t n_columns,
+		float* Y,
+		const bool accumulate)
+{
+	size_t r = 0;
+	for (; r + 4 <= n_rows; r += 4)
+	{
+		const float* x0 = X + r * x_stride;
+		const float* x1 = x0 + x_stride;
+		const float* x2 = x1 + x_stride;
+		const float* x3 = x2 + x_stride;
+		float* y0 = Y + r * n_columns;
+		float* y1 = y0 + n_columns;
+		float* y2 = y1 + n_columns;
+		float* y3 = y2 + n_columns;
+		size_t j = 0;
+		for (; j + 32 <= n_columns; j += 32)
+		{
+			__m512 sum00 = accumulate ? _mm512_loadu_ps(y0 + j) : _mm512_setzero_ps();
+			__m512 sum01 = accumulate ? _mm512_loadu_ps(y0 + j + 16) : _mm512_setzero_ps();
+			__m512 sum10 = accumulate ? _mm512_loadu_ps(y1 + j) : _mm512_setzero_ps();
+			__m512 sum11 = accumulate ? _mm512_loadu_ps(y1 + j + 16) : _mm512_setzero_ps();
+			__m512 sum20 = accumulate ? _mm512_loadu_ps(y2 + j) : _mm512_setzero_ps();
+			__m512 sum21 = accumulate ? _mm512_loadu_ps(y2 + j + 16) : _mm512_setzero_ps();
+			__m512 sum30 = accumulate ? _mm512_loadu_ps(y3 + j) : _mm512_setzero_ps();
+			__m512 sum31 = accumulate ? _mm512_loadu_ps(y3 + j + 16) : _mm512_setzero_ps();
+			for (size_t k = 0; k < n_inner; ++k)
+			{
+				const __m512 w0 = _mm512_loadu_ps(W + k * n_columns + j);
+				const __m512 w1 = _mm512_loadu_ps(W + k * n_columns + j + 16);
+				__m512 x_v = _mm512_set1_ps(x0[k]);
+				sum00 = _mm512_fmadd_ps(x_v, w0, sum00);
+				sum01 = _mm512_fmadd_ps(x_v, w1, sum01);
+				x_v = _mm512_set1_ps(x1[k]);
+				sum10 = _mm512_fmadd_ps(x_v, w0, sum10);
+				sum11 = _mm512_fmadd_ps(x_v, w1, sum11);
+				x_v = _mm512_set1_ps(x2[k]);
+				sum20 = _mm512_fmadd_ps(x_v, w0, sum20);
+				sum21 = _mm512_fmadd_ps(x_v, w1, sum21);
+				x_v = _mm512_set1_ps(x3[k]);
+				sum30 = _mm512_fmadd_ps(x_v, w0, sum30);
+				sum31 = _mm512_fmadd_ps(x_v, w1, sum31);
+			}
+			_mm512_storeu_ps(y0 + j, sum00);
+			_mm512_storeu_ps(y0 + j + 16, sum01);
+			_mm512_storeu_ps(y1 + j, sum10);
+			_mm512_storeu_ps(y1 + j + 16, sum11);
+			_mm512_storeu_ps(y2 + j, sum20);
+			_mm512_storeu_ps(y2 + j + 16, sum21);
+			_mm512_storeu_ps(y3 + j, sum30);
+			_mm512_storeu_ps(y3 + j + 16, sum31);
+		}
+
+		for (; j < n_columns; j += 16)
+		{
+			const __mmask16 tail = n_columns - j >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (n_columns - j)) - 1u);
+			__m512 sum0 = accumulate ? _mm512_maskz_loadu_ps(tail, y0 + j) : _mm512_setzero_ps();
+			__m512 sum1 = accumulate ? _mm512_maskz_loadu_ps(tail, y1 + j) : _mm512_setzero_ps();
+			__m512 sum2 = accumulate ? _mm512_maskz_loadu_ps(tail, y2 + j) : _mm512_setzero_ps();
+			__m512 sum3 = accumulate ? _mm512_maskz_loadu_ps(tail, y3 + j) : _mm512_setzero_ps();
+			for (size_t k = 0; k < n_inner; ++k)
+			{
+				const __m512 w_v = _mm512_maskz_loadu_ps(tail, W + k * n_columns + j);
+				sum0 = _mm512_fmadd_ps(_mm512_set1_ps(x0[k]), w_v, sum0);
+				sum1 = _mm512_fmadd_ps(_mm512_set1_ps(x1[k]), w_v, sum1);
+				sum2 = _mm512_fmadd_ps(_mm512_set1_ps(x2[k]), w_v, sum2);
+				sum3 = _mm512_fmadd_ps(_mm512_set1_ps(x3[k]), w_v, sum3);
+			}
+			_mm512_mask_storeu_ps(y0 + j, tail, sum0);
+			_mm512_mask_storeu_ps(y1 + j, tail, sum1);
+			_mm512_mask_storeu_ps(y2 + j, tail, sum2);
+			_mm512_mask_storeu_ps(y3 + j, tail, sum3);
+		}
+	}
+
+	__gemm_scalar(X, r, n_rows, n_inner, x_stride, W, 0, n_columns, n_columns, Y, accumulate);
+}
+
+#endif
+
+/*
+ * Dispatch
+ */
+
+static double __loss(
+		const loss_kind kind,
+		const float* y,
+		const float* yhat,
+		const size_t n,
+		const float delta)
+{
+#ifdef GMF_KERNEL_X86
+	switch (gmf_kernel_isa())
+	{
+		case KERNEL_AVX512:
+			return __loss_avx512(kind, y, yhat, n, delta);
+		case KERNEL_AVX2:
+			return __loss_avx2(kind, y, yhat, n, delta);
+		default:
+			break;
+	}
+#endif
+	return __loss_scalar(kind, y, yhat, 0, n, delta);
+}
+
+static void __sigmoid(
+		float* z,
+		const size_t n,
+		const bool hard,
+		const float threshold)
+{
+#ifdef GMF_KERNEL_X86
+	switch (gmf_kernel_isa())
+	{
+		case KERNEL_AVX512:
+			__sigmoid_avx512(z, n, hard, threshold);
+			return;
+		case KERNEL_AVX2:
+			__sigmoid_avx2(z, n, hard, threshold);
+			return;
+		default:
+			break;
+	}
+#endif
+	__sigmoid_scalar(z, 0, n, hard, threshold);
+}
+
+static void __exp_array(
+		float* z,
+		const size_t n)
+{
+#ifdef GMF_KERNEL_X86
+	switch (gmf_kernel_isa())
+	{
+		case KERNEL_AVX512:
+			__exp_array_avx512(z, n);
+			return;
+		case KERNEL_AVX2:
+			__exp_array_avx2(z, n);
+			return;
+		default:
+			break;
+	}
+#endif
+	__exp_array_scalar(z, 0, n);
+}
+
+void gmf_kernel_softmax(
+		float* z,
+		const size_t n_rows,
+		const size_t n_columns)
+{
+	// subtracting the row max keeps e^z finite
+	for (size_t r = 0; r < n_rows; ++r)
+	{
+		float* row = z + r * n_columns;
+		float max = row[0];
+		for (size_t c = 1; c < n_columns; ++c)
+			max = row[c] > max ? row[c] : max;
+		for (size_t c = 0; c < n_columns; ++c)
+			row[c] -= max;
+	}
+
+	// the exponentials of every row at once
+	__exp_array(z, n_rows * n_columns);
+
+	for (size_t r = 0; r < n_rows; ++r)
+	{
+		float* row = z + r * n_columns;
+		float sum = 0.0f;
+		for (size_t c = 0; c < n_columns; ++c)
+			sum += row[c];
+		const float scale = 1.0f / sum;
+		for (size_t c = 0; c < n_columns; ++c)
+			row[c] *= scale;
+	}
+}
+
+void gmf_kernel_sigmoid(
+		float* z,
+		const size_t n)
+{
+	__sigmoid(z, n, false, 0.0f);
+}
+
+void gmf_kernel_sigmoid_hard(
+		float* z,
+		const size_t n,
+		const float threshold)
+{
+	__sigmoid(z, n, true, threshold);
+}
+
+double gmf_kernel_loss_squared(
+		const float* y,
+		const float* yhat,
+		const size_t n)
+{
+	return __loss(LOSS_SQUARED, y, yhat, n, 0.0f);
+}
+
+double gmf_kernel_loss_cross_entropy(
+		const float* y,
+		const float* yhat,
+		const size_t n)
+{
+	return __loss(LOSS_CROSS_ENTROPY, y, yhat, n, 0.0f);
+}
+
+double gmf_kernel_loss_absolute(
+		const float* y,
+		const float* yhat,
+		const size_t n)
+{
+	return __loss(LOSS_ABSOLUTE, y, yhat, n, 0.0f);
+}
+
+double gmf_kernel_loss_hinge(
+		const float* y,
+		const float* yhat,
+		const size_t n)
+{
+	return __loss(LOSS_HINGE, y, yhat, n, 0.0f);
+}
+
+double gmf_kernel_loss_huber(
+		const float* y,
+		const float* yhat,
+		const size_t n,
+		const float delta)
+{
+	return __loss(LOSS_HUBER, y, yhat, n, delta);
+}
+
+void gmf_kernel_gemv(
+		const float* X,
+		const size_t n_rows,
+		const size_t n_columns,
+		const size_t x_stride,
+		const float* w,
+		float* y,
+		const size_t y_stride,
+		const bool accumulate)
+{
+#ifdef GMF_KERNEL_X86
+	switch (gmf_kernel_isa())
+	{
+		case KERNEL_AVX512:
+			__gemv_avx512(X, n_rows, n_columns, x_stride, w, y, y_stride, accumulate);
+			return;
+		case KERNEL_AVX2:
+			__gemv_avx2(X, n_rows, n_columns, x_stride, w, y, y_stride, accumulate);
+			return;
+		default:
+			break;
+	}
+#endif
+	__gemv_scalar(X, 0, n_rows, n_columns, x_stride, w, y, y_stride, accumulate);
+}
+
+void gmf_kernel_gemm(
+		const float* X,
+		const size_t n_rows,
+		const size_t n_inner,
+		const size_t x_stride,
+		const float* W,
+		const size_t n_columns,
+		float* Y,
+		const bool accumulate)
+{
+#ifdef GMF_KERNEL_X86
+	switch (gmf_kernel_isa())
+	{
+		case KERNEL_AVX512:
+			__gemm_avx512(X, n_rows, n_inner, x_stride, W, n_columns, Y, accumulate);
+			return;
+		case KERNEL_AVX2:
+			__gemm_avx2(X, n_rows, n_inner, x_stride, W, n_columns, Y, accumulate);
+			return;
+		default:
+			break;
+	}
+#endif
+	__gemm_scalar(X, 0, n_rows, n_inner, x_stride, W, 0, n_columns, n_columns, Y, accumulate);
+}
@@ -0,0 +1,201 @@
+#include "lbfgs.h"
+
+// sufficient decrease and curvature constants of the strong Wolfe conditions
+#define GMF_LBFGS_C1 1e-4
+#define GMF_LBFGS_C2 0.9
+// objective evaluations allowed per line search
+#define GMF_LBFGS_MAX_EVALUATIONS 25
+
+static double __dot(
+		const double* a,
+		const double* b,
+		const size_t n)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < n; ++i)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+void gmf_lbfgs_direction(
+		const double* gradient,
+		const double* s,
+		const double* y,
+		const double* rho,
+		const size_t n_pairs,
+		const size_t newest,
+		const size_t history,
+		const size_t n,
+		double* alpha,
+		double* direction)
+{
+	for (size_t i = 0; i < n; ++i)
+		direction[i] = -gradient[i];
+
+	// newest to oldest
+	for (size_t k = 0; k < n_pairs; ++k)
+	{
+		const size_t slot = (newest + history - k) % history;
+		alpha[slot] = rho[slot] * __dot(s + slot * n, direction, n);
+		const double* y_slot = y + slot * n;
+		for (size_t i = 0; i < n; ++i)
+			direction[i] -= alpha[slot] * y_slot[i];
+	}
+
+	// initial hessian is gamma * I with gamma = s^T y / y^T y of the newest pair
+	if (n_pairs > 0)
+	{
+		const double* y_newest = y + newest * n;
+		const double gamma = 1.0 / (rho[newest] * __dot(y_newest, y_newest, n));
+		for (size_t i = 0; i < n; ++i)
+			direction[i] *= gamma;
+	}
+
+	// oldest to newest
+	for (size_t k = n_pairs; k-- > 0;)
+	{
+		const size_t slot = (newest + history - k) % history;
+		const double beta = rho[slot] * __dot(y + slot * n, direction, n);
+		const double* s_slot = s + slot * n;
+		for (size_t i = 0; i < n; ++i)
+			direction[i] += (alpha[slot] - beta) * s_slot[i];
+	}
+}
+
+// W = W0 + t * direction, then evaluate
+static double __evaluate(
+		LBFGSObjective objective,
+		void* context,
+		float* W,
+		const float* W0,
+		const double* direction,
+		const double t,
+		const size_t n,
+		double* gradient,
+		double* g_dot_d)
+{
+	for (size_t i = 0; i < n; ++i)
+		W[i] = (float)(W0[i] + t * direction[i]);
+
+	const double f = objective(context, gradient);
+	*g_dot_d = __dot(gradient, direction, n);
+	return f;
+}
+
+// minimizer of the cubic interpolating (a, fa, ga) and (b, fb, gb),
+// kept away from the ends of the interval (bisection as a fallback)
+static double __cubic_step(
+		const double a,
+		const double fa,
+		const double ga,
+		const double b,
+		const double fb,
+		const double gb)
+{
+	const double low = a < b ? a : b;
+	const double high = a < b ? b : a;
+	const double margin = 0.1 * (high - low);
+
+	const double d1 = ga + gb - 3.0 * (fa - fb) / (a - b);
+	const double d2_squared = d1 * d1 - ga * gb;
+	if (d2_squared >= 0.0)
+	{
+		const double d2 = (b > a ? 1.0 : -1.0) * sqrt(d2_squared);
+		const double t = b - (b - a) * (gb + d2 - d1) / (gb - ga + 2.0 * d2);
+		if (isfinite(t) && t >= low + margin && t <= high - margin)
+			return t;
+	}
+
+	return 0.5 * (low + high);
+}
+
+double gmf_lbfgs_line_search(
+		LBFGSObjective objective,
+		void* context,
+		float* W,
+		const float* W0,
+		const double* direction,
+		const double f0,
+		const double g0_dot_d,
+		const double initial_step,
+		const size_t n,
+		double* f,
+		double* gradient)
+{
+	// bracketing phase: grow the step until the minimum is bracketed
+	double t_low = 0.0, f_low = f0, g_low = g0_dot_d;
+	double t_high = 0.0, f_high = f0, g_high = g0_dot_d;
+	double t = initial_step;
+	double g_dot_d = 0.0;
+	size_t n_evaluations = 0;
+	int bracketed = 0;
+
+	while (n_evaluations < GMF_LBFGS_MAX_EVALUATIONS)
+	{
+		*f = __evaluate(objective, context, W, W0, direction, t, n, gradient, &g_dot_d);
+		n_evaluations++;
+
+		if (!isfinite(*f) || *f > f0 + GMF_LBFGS_C1 * t * g0_dot_d || (n_evaluations > 1 && *f >= f_low))
+		{
+			t_high = t; f_high = *f; g_high = g_dot_d;
+			bracketed = 1;
+			break;
+		}
+		if (fabs(g_dot_d) <= -GMF_LBFGS_C2 * g0_dot_d)
+			return t;
+		if (g_dot_d >= 0.0)
+		{
+			// the minimum lies between the previous and current step
+			t_high = t_low; f_high = f_low; g_high = g_low;
+			t_low = t; f_low = *f; g_low = g_dot_d;
+			bracketed = 1;
+			break;
+		}
+
+		t_low = t; f_low = *f; g_low = g_dot_d;
+		t *= 2.0;
+	}
+
+	// zoom phase: shrink [t_low, t_high] until the Wolfe conditions hold.
+	// t_low always satisfies sufficient decrease with the lowest objective
+	while (bracketed && n_evaluations < GMF_LBFGS_MAX_EVALUATIONS)
+	{
+		if (isfinite(f_high))
+			t = __cubic_step(t_low, f_low, g_low, t_high, f_high, g_high);
+		else
+			t = 0.5 * (t_low + t_high);
+
+		*f = __evaluate(objective, context, W, W0, direction, t, n, gradient, &g_dot_d);
+		n_evaluations++;
+
+		if (!isfinite(*f) || *f > f0 + GMF_LBFGS_C1 * t * g0_dot_d || *f >= f_low)
+		{
+			t_high = t; f_high = *f; g_high = g_dot_d;
+		}
+		else
+		{
+			if (fabs(g_dot_d) <= -GMF_LBFGS_C2 * g0_dot_d)
+				return t;
+			if (g_dot_d * (t_high - t_low) >= 0.0)
+			{
+				t_high = t_low; f_high = f_low; g_high = g_low;
+			}
+			t_low = t; f_low = *f; g_low = g_dot_d;
+		}
+
+		if (fabs(t_high - t_low) <= 1e-12 * (t_low > 1.0 ? t_low : 1.0))
+			break;
+	}
+
+	// out of evaluations - fall back to the best step found so far
+	// (it still satisfies sufficient decrease) if there is one
+	if (t_low > 0.0)
+	{
+		*f = __evaluate(objective, context, W, W0, direction, t_low, n, gradient, &g_dot_d);
+		return t_low;
+	}
+
+	for (size_t i = 0; i < n; ++i)
+		W[i] = W0[i];
+	return 0.0;
+}
@@ -1,6 +1,47 @@
+#include <string.h>
+
 #include "linear_model.h"
 #include "matrix.h"
 #include "gmf_util.h"
+#include "feature_matrix.h"
+#include "fused_losses.h"
+#include "optimizers.h"
+#include "solvers.h"
+#include "lbfgs.h"
+#include "coordinate_descent.h"
+#include "activations.h"
+#include "kernels.h"
+#include "regularization.h"
+#include "regularization_gradient.h"
+#include "fit_workspace.h"
+
+// rows per chunk when computing the CLASSIC gradient. The chunking (and
+// therefore the order of summation) never depends on the number of
+// threads, which is what makes multi-threaded results reproducible.
+#define GMF_FIT_CHUNK_ROWS 2048
+
+// largest dense buffer (in values) fit() allocates for the (n_columns, n_columns)
+// systems of CHOLESKY/NEWTON or to convert X into a Matrix for custom functions.
+// Wide (e.g. hashed sparse) data exits with an error instead of attempting
+// an allocation of many GB.
+#define GMF_FIT_MAX_DENSE_VALUES ((size_t)1 << 28)
+
+// the loss of a STOCHASTIC/HOGWILD loss check is the average loss of the
+// last GMF_SGD_LOSS_SAMPLES samples of every shard in the window, the
+// other samples only compute their gradient
+#define GMF_SGD_LOSS_SAMPLES 32
+
+// blocking of the batch prediction engine. A column block of W stays in L1
+// while a block of rows streams past it; the predictions of a row block are
+// still in cache when the activation runs over them. Threads take whole
+// tasks of GMF_PREDICT_TASK_ROWS rows.
+#define GMF_PREDICT_ROW_BLOCK 64
+#define GMF_PREDICT_COLUMN_BLOCK 1024
+#define GMF_PREDICT_TASK_ROWS 8192
+
+// W with at most 1 / GMF_PREDICT_SPARSE_RATIO non-zero weights (e.g. after L1)
+// is predicted with a gather over the non-zero columns instead of a full gemv
+#define GMF_PREDICT_SPARSE_RATIO 4
 
 static void err(const char* msg)
 {
@@ -19,6 +60,14 @@ void gmf_model_linear_init_inplace(
 	(*lm)->params = params; 
 	(*lm)->regularization = NULL;
 	(*lm)->regularization_gradient = NULL;
+	(*lm)->fused_loss_gradient = NULL;
+	(*lm)->optimizer = &gmf_optimizer_sgd;
+	(*lm)->learning_rate_schedule = &gmf_learning_rate_constant;
+	(*lm)->workspace = NULL;
+	(*lm)->validation_X = NULL;
+	(*lm)->validation_Y = NULL;
+	(*lm)->partial = NULL;
+	(*lm)->stopped_early = false;
 
 	// by default we'll init W to NULL since they aren't set until fit() is called
 	(*lm)->W = NULL;
@@ -38,6 +87,19 @@ static void __default_params(LinearModelParams* params)
 	params->regularization_params = NULL;
 	params->huber_delta = 1.0f;
 	params->sigmoid_threshold = 0.5f;
+	params->n_threads = 1;
+	params->loss_check_interval = 0;
+	params->validation_sample_size = 0;
+	params->momentum = 0.9f;
+	params->beta1 = 0.9f;
+	params->beta2 = 0.999f;
+	params->epsilon = 1e-8f;
+	params->decay_rate = 0.5f;
+	params->decay_steps = 1000;
+	params->min_learning_rate = 0.0f;
+	params->lbfgs_history = 10;
+	params->exclude_bias = false;
+	params->random_seed = 0;
 }
 
 LinearModel* gmf_model_linear_init()
@@ -54,17 +116,956 @@ LinearModel* gmf_model_linear_init()
 	return lm;
 }
 
-static void __init_W(LinearModel** lm, const Matrix* X)
+// W drawn uniformly from [-1, 1] with random_state (or zeros if random_state is NULL)
+static void __init_W(LinearModel** lm, const size_t n_columns, RandomState* random_state)
 {
 	// if fit is called multiple times, need to check
-	// if W is already initialized
-	if ((*lm)->W)
+	// if W is already initialized (and reuse it if the shape matches)
+	if ((*lm)->W && (*lm)->W->n_rows != n_columns)
 		mat_free(&(*lm)->W);
 
-	// initialize random weights in [-1, 1]
-	(*lm)->W = NULL; 
-	mat_init(&(*lm)->W, X->n_columns, 1);
-	mat_random(&(*lm)->W, -1.0f, 1.0f);
+	if (!(*lm)->W)
+		mat_init(&(*lm)->W, n_columns, 1);
+	for (size_t c = 0; c < n_columns; ++c)
+		(*lm)->W->data[c] = random_state ? gmf_util_random_uniform(random_state, -1.0f, 1.0f) : 0.0f;
+}
+
+// number of rows used each iteration for the given optimization type
+static size_t __sample_rows(const LinearModelParams* params, const size_t n_rows)
+{
+	switch (params->model_type)
+	{
+		case BATCH:
+			// default batch size is 25% original data size
+			return params->batch_size == 0 ? n_rows / 4 : params->batch_size;
+		case STOCHASTIC:
+		case HOGWILD:
+			return 1;
+		default:
+			return n_rows;
+	}
+}
+
+// doubles per thread used by the direct solvers: the (n_columns, n_columns)
+// system, its right hand side and a block of rows converted to double
+static size_t __solver_stride(const size_t n_columns)
+{
+	return n_columns * (n_columns + 1 + GMF_SOLVER_ROW_BLOCK);
+}
+
+// number of SGD shards - one per thread for HOGWILD (but never more than
+// there are rows), one for STOCHASTIC and none for the other model types
+static size_t __shard_count(const LinearModelParams* params, const size_t n_rows)
+{
+	if (params->model_type == STOCHASTIC)
+		return 1;
+	if (params->model_type != HOGWILD)
+		return 0;
+	if (params->n_threads <= 1)
+		return 1;
+	return params->n_threads < n_rows ? params->n_threads : n_rows;
+}
+
+// rows per chunk of __chunked_loss_gradient(). Every chunk zeroes and reduces
+// a dense (n_columns) gradient so chunks of sparse rows hold (on average) at
+// least n_columns non-zero values. Only depends on X so results still don't
+// depend on the number of threads.
+static size_t __chunk_rows(const FeatureMatrix* X)
+{
+	if (X->type != FEATURES_CSR || X->n_rows == 0)
+		return GMF_FIT_CHUNK_ROWS;
+
+	const size_t n_nonzero = gmf_features_nonzeros(X);
+	const size_t rows = n_nonzero > 0 ? X->n_columns * X->n_rows / n_nonzero + 1 : X->n_rows;
+	return rows > GMF_FIT_CHUNK_ROWS ? rows : GMF_FIT_CHUNK_ROWS;
+}
+
+// exits with msg if an (n_rows, n_columns) dense buffer is larger than GMF_FIT_MAX_DENSE_VALUES
+static void __check_dense_size(
+	const size_t n_rows,
+	const size_t n_columns,
+	const char* msg)
+{
+	if (n_columns > 0 && n_rows > GMF_FIT_MAX_DENSE_VALUES / n_columns)
+		err(msg);
+}
+
+// split the n_rows rows of row_idx into contiguous slices, one per shard
+static void __shard_rows(LinearModelWorkspace* workspace, const size_t n_rows)
+{
+	for (size_t s = 0; s < workspace->n_shards; ++s)
+	{
+		workspace->shards[s].row_start = s * n_rows / workspace->n_shards;
+		workspace->shards[s].n_rows = (s + 1) * n_rows / workspace->n_shards - workspace->shards[s].row_start;
+		workspace->shards[s].epoch_position = workspace->shards[s].n_rows;
+		workspace->shards[s].loss = 0.0;
+	}
+}
+
+// chunk_rows is the number of rows per chunk of __chunked_loss_gradient(),
+// see __chunk_rows()
+static void __workspace_alloc(
+	LinearModelWorkspace* workspace,
+	const LinearModel* lm,
+	const size_t n_rows,
+	const size_t n_columns,
+	const size_t chunk_rows)
+{
+	workspace->n_rows = n_rows;
+	workspace->n_columns = n_columns;
+	workspace->n_sample_rows = __sample_rows(lm->params, n_rows);
+	workspace->row_capacity = n_rows;
+	workspace->sample_capacity = workspace->n_sample_rows;
+
+	workspace->Yhat = NULL;
+	workspace->X_sample = NULL;
+	workspace->Y_sample = NULL;
+	workspace->loss_gradient = NULL;
+	mat_init(&workspace->Yhat, workspace->n_sample_rows, 1);
+	mat_init(&workspace->loss_gradient, n_columns, 1);
+
+	// X_sample/Y_sample are only needed by custom (unfused) functions
+	// so they're allocated on first use, see __gather_rows()
+	workspace->row_idx = NULL;
+	workspace->epoch_position = n_rows;
+	if (lm->params->model_type == BATCH 
+			|| lm->params->model_type == STOCHASTIC 
+			|| lm->params->model_type == HOGWILD)
+		workspace->row_idx = gmf_fit_row_idx_alloc(n_rows);
+
+	// SGD threads each own a contiguous slice of row_idx
+	workspace->n_shards = __shard_count(lm->params, n_rows);
+	workspace->shards = NULL;
+	if (workspace->n_shards > 0)
+	{
+		void* alloc = malloc(workspace->n_shards * sizeof(LinearModelShard));
+		if (!alloc)
+			err("Couldn't allocate memory for LinearModelWorkspace.");
+		workspace->shards = alloc;
+		__shard_rows(workspace, n_rows);
+	}
+
+	workspace->n_chunks = 0;
+	workspace->chunk_rows = chunk_rows;
+	workspace->partial_gradients = NULL;
+	workspace->partial_losses = NULL;
+	if (lm->params->model_type == CLASSIC || lm->params->model_type == BATCH || lm->params->model_type == LBFGS)
+	{
+		workspace->n_chunks = (workspace->n_sample_rows + chunk_rows - 1) / chunk_rows;
+		gmf_fit_partials_alloc(workspace->n_chunks, n_columns, &workspace->partial_gradients, &workspace->partial_losses);
+	}
+
+	// optimizer state is tiny (two vectors the size of W) so it's always allocated
+	workspace->optimizer_state.n_weights = n_columns;
+	workspace->optimizer_state.step = 0;
+	workspace->optimizer_state.velocity = calloc(n_columns, sizeof(float));
+	workspace->optimizer_state.accumulator = calloc(n_columns, sizeof(float));
+	if (!workspace->optimizer_state.velocity || !workspace->optimizer_state.accumulator)
+		err("Couldn't allocate memory for LinearModelWorkspace.");
+
+	// only sparse SGD defers its regularization, see gmf_regularization_lazy_init()
+	memset(&workspace->lazy_regularization, 0, sizeof(LazyRegularization));
+
+	// direct solvers accumulate one system per thread
+	workspace->n_solver_partials = 0;
+	workspace->solver_partials = NULL;
+	workspace->solver_losses = NULL;
+	workspace->solver_factor = NULL;
+	workspace->solver_step = NULL;
+	workspace->solver_W = NULL;
+	if (lm->params->model_type == NEWTON || lm->params->model_type == LBFGS)
+	{
+		workspace->solver_W = malloc(n_columns * sizeof(float));
+		if (!workspace->solver_W)
+			err("Couldn't allocate memory for LinearModelWorkspace.");
+	}
+	if (lm->params->model_type == CHOLESKY || lm->params->model_type == NEWTON)
+	{
+		__check_dense_size(n_columns, n_columns + 1 + GMF_SOLVER_ROW_BLOCK, "CHOLESKY and NEWTON solve a dense (n_columns, n_columns) system which is too large for this many columns. Please use LBFGS, COORDINATE_DESCENT or an SGD model type instead.");
+		workspace->n_solver_partials = lm->params->n_threads > 1 ? lm->params->n_threads : 1;
+		if (workspace->n_solver_partials > n_rows && n_rows > 0)
+			workspace->n_solver_partials = n_rows;
+		workspace->solver_partials = malloc(workspace->n_solver_partials * __solver_stride(n_columns) * sizeof(double));
+		workspace->solver_losses = malloc(workspace->n_solver_partials * sizeof(double));
+		workspace->solver_factor = malloc(n_columns * n_columns * sizeof(double));
+		workspace->solver_step = malloc(n_columns * sizeof(double));
+		if (!workspace->solver_partials 
+				|| !workspace->solver_losses 
+				|| !workspace->solver_factor 
+				|| !workspace->solver_step)
+			err("Couldn't allocate memory for LinearModelWorkspace.");
+	}
+
+	// curvature history of LBFGS
+	workspace->lbfgs_history = 0;
+	workspace->lbfgs_s = NULL;
+	workspace->lbfgs_y = NULL;
+	workspace->lbfgs_rho = NULL;
+	workspace->lbfgs_alpha = NULL;
+	workspace->lbfgs_gradient = NULL;
+	workspace->lbfgs_previous_gradient = NULL;
+	workspace->lbfgs_direction = NULL;
+	if (lm->params->model_type == LBFGS)
+	{
+		workspace->lbfgs_history = lm->params->lbfgs_history > 0 ? lm->params->lbfgs_history : 1;
+		workspace->lbfgs_s = malloc(workspace->lbfgs_history * n_columns * sizeof(double));
+		workspace->lbfgs_y = malloc(workspace->lbfgs_history * n_columns * sizeof(double));
+		workspace->lbfgs_rho = malloc(workspace->lbfgs_history * sizeof(double));
+		workspace->lbfgs_alpha = malloc(workspace->lbfgs_history * sizeof(double));
+		workspace->lbfgs_gradient = malloc(n_columns * sizeof(double));
+		workspace->lbfgs_previous_gradient = malloc(n_columns * sizeof(double));
+		workspace->lbfgs_direction = malloc(n_columns * sizeof(double));
+		if (!workspace->lbfgs_s 
+				|| !workspace->lbfgs_y 
+				|| !workspace->lbfgs_rho 
+				|| !workspace->lbfgs_alpha 
+				|| !workspace->lbfgs_gradient 
+				|| !workspace->lbfgs_previous_gradient 
+				|| !workspace->lbfgs_direction)
+			err("Couldn't allocate memory for LinearModelWorkspace.");
+	}
+
+	// column-major data and cached residual of coordinate descent. The
+	// columns are sized by the X of every fit(), see __cd_prepare()
+	workspace->cd_X_columns = NULL;
+	workspace->cd_row_idx = NULL;
+	workspace->cd_column_ptr = NULL;
+	workspace->cd_capacity = 0;
+	workspace->cd_column_norms = NULL;
+	workspace->cd_residual = NULL;
+	workspace->cd_columns = NULL;
+	workspace->cd_active = NULL;
+	if (lm->params->model_type == COORDINATE_DESCENT)
+	{
+		workspace->cd_column_ptr = malloc((n_columns + 1) * sizeof(size_t));
+		workspace->cd_column_norms = malloc(n_columns * sizeof(double));
+		workspace->cd_residual = malloc(n_rows * sizeof(double));
+		workspace->cd_columns = malloc(n_columns * sizeof(size_t));
+		workspace->cd_active = malloc(n_columns * sizeof(size_t));
+		if (!workspace->cd_column_ptr 
+				|| !workspace->cd_column_norms 
+				|| !workspace->cd_residual 
+				|| !workspace->cd_columns 
+				|| !workspace->cd_active)
+			err("Couldn't allocate memory for LinearModelWorkspace.");
+		for (size_t c = 0; c < n_columns; ++c)
+			workspace->cd_columns[c] = c;
+	}
+
+	// validation buffers depend on the validation data, see __validation_prepare()
+	workspace->n_validation_rows = 0;
+	workspace->validation_idx = NULL;
+	workspace->validation_X_sample = NULL;
+	workspace->validation_Y_sample = NULL;
+	workspace->validation_Yhat = NULL;
+	workspace->best_W = NULL;
+
+	workspace->n_threads = lm->params->n_threads;
+	workspace->thread_pool = NULL;
+	if (workspace->n_threads > 1)
+		workspace->thread_pool = gmf_util_thread_pool_init(workspace->n_threads);
+}
+
+static void __validation_release(LinearModelWorkspace* workspace)
+{
+	workspace->n_validation_rows = 0;
+	free(workspace->validation_idx);
+	workspace->validation_idx = NULL;
+	if (workspace->validation_X_sample)
+		mat_free(&workspace->validation_X_sample);
+	if (workspace->validation_Y_sample)
+		mat_free(&workspace->validation_Y_sample);
+	if (workspace->validation_Yhat)
+		mat_free(&workspace->validation_Yhat);
+	free(workspace->best_W);
+	workspace->best_W = NULL;
+}
+
+static void __workspace_release(LinearModelWorkspace* workspace)
+{
+	mat_free(&workspace->Yhat);
+	mat_free(&workspace->loss_gradient);
+	if (workspace->X_sample)
+		mat_free(&workspace->X_sample);
+	if (workspace->Y_sample)
+		mat_free(&workspace->Y_sample);
+	free(workspace->row_idx);
+	workspace->row_idx = NULL;
+	free(workspace->partial_gradients);
+	workspace->partial_gradients = NULL;
+	free(workspace->partial_losses);
+	workspace->partial_losses = NULL;
+	free(workspace->shards);
+	workspace->shards = NULL;
+	free(workspace->optimizer_state.velocity);
+	workspace->optimizer_state.velocity = NULL;
+	free(workspace->optimizer_state.accumulator);
+	workspace->optimizer_state.accumulator = NULL;
+	gmf_regularization_lazy_free(&workspace->lazy_regularization);
+	free(workspace->solver_partials);
+	workspace->solver_partials = NULL;
+	free(workspace->solver_losses);
+	workspace->solver_losses = NULL;
+	free(workspace->solver_factor);
+	workspace->solver_factor = NULL;
+	free(workspace->solver_step);
+	workspace->solver_step = NULL;
+	free(workspace->solver_W);
+	workspace->solver_W = NULL;
+	free(workspace->lbfgs_s);
+	workspace->lbfgs_s = NULL;
+	free(workspace->lbfgs_y);
+	workspace->lbfgs_y = NULL;
+	free(workspace->lbfgs_rho);
+	workspace->lbfgs_rho = NULL;
+	free(workspace->lbfgs_alpha);
+	workspace->lbfgs_alpha = NULL;
+	free(workspace->lbfgs_gradient);
+	workspace->lbfgs_gradient = NULL;
+	free(workspace->lbfgs_previous_gradient);
+	workspace->lbfgs_previous_gradient = NULL;
+	free(workspace->lbfgs_direction);
+	workspace->lbfgs_direction = NULL;
+	free(workspace->cd_X_columns);
+	workspace->cd_X_columns = NULL;
+	free(workspace->cd_row_idx);
+	workspace->cd_row_idx = NULL;
+	free(workspace->cd_column_ptr);
+	workspace->cd_column_ptr = NULL;
+	workspace->cd_capacity = 0;
+	free(workspace->cd_column_norms);
+	workspace->cd_column_norms = NULL;
+	free(workspace->cd_residual);
+	workspace->cd_residual = NULL;
+	free(workspace->cd_columns);
+	workspace->cd_columns = NULL;
+	free(workspace->cd_active);
+	workspace->cd_active = NULL;
+	__validation_release(workspace);
+	if (workspace->thread_pool)
+		gmf_util_thread_pool_free(&workspace->thread_pool);
+}
+
+static LinearModelWorkspace* __workspace_init(
+	const LinearModel* lm,
+	const size_t n_rows,
+	const size_t n_columns,
+	const size_t chunk_rows)
+{
+	void* alloc = malloc(sizeof(LinearModelWorkspace));
+	if (!alloc)
+		err("Couldn't allocate memory for LinearModelWorkspace.");
+	LinearModelWorkspace* workspace = alloc;
+	__workspace_alloc(workspace, lm, n_rows, n_columns, chunk_rows);
+
+	return workspace;
+}
+
+LinearModelWorkspace* gmf_model_linear_workspace_init(
+	const LinearModel* lm,
+	const size_t n_rows,
+	const size_t n_columns)
+{
+	return __workspace_init(lm, n_rows, n_columns, GMF_FIT_CHUNK_ROWS);
+}
+
+void gmf_model_linear_workspace_free(
+	LinearModelWorkspace** workspace)
+{
+	__workspace_release(*workspace);
+	free(*workspace);
+	*workspace = NULL;
+}
+
+// make sure a (caller-owned) workspace fits the data, otherwise resize it.
+// Buffers are only reallocated when n_rows (or the sample) outgrows their
+// capacity, so e.g. the smaller last chunk of every partial_fit() epoch
+// doesn't reallocate anything.
+static void __workspace_reserve(
+	LinearModelWorkspace* workspace,
+	const LinearModel* lm,
+	const size_t n_rows,
+	const size_t n_columns,
+	const size_t chunk_rows)
+{
+	const size_t n_sample_rows = __sample_rows(lm->params, n_rows);
+	bool needs_samples = lm->params->model_type == BATCH 
+		|| lm->params->model_type == STOCHASTIC 
+		|| lm->params->model_type == HOGWILD;
+	bool needs_chunks = lm->params->model_type == CLASSIC || lm->params->model_type == BATCH || lm->params->model_type == LBFGS;
+	bool needs_solver = lm->params->model_type == CHOLESKY || lm->params->model_type == NEWTON;
+	bool needs_lbfgs = lm->params->model_type == LBFGS;
+	bool needs_cd = lm->params->model_type == COORDINATE_DESCENT;
+	if (n_rows <= workspace->row_capacity
+			&& n_sample_rows <= workspace->sample_capacity
+			&& workspace->n_columns == n_columns
+			&& workspace->n_threads == lm->params->n_threads
+			&& workspace->n_shards == __shard_count(lm->params, n_rows)
+			&& (!needs_samples || workspace->row_idx)
+			&& (!needs_chunks || (workspace->partial_gradients 
+					&& workspace->n_chunks >= (n_sample_rows + chunk_rows - 1) / chunk_rows))
+			&& (!needs_solver || workspace->solver_partials)
+			&& (!needs_lbfgs || (workspace->lbfgs_s && workspace->lbfgs_history == lm->params->lbfgs_history))
+			&& (!needs_cd || workspace->cd_column_ptr))
+	{
+		workspace->chunk_rows = chunk_rows;
+		if (workspace->n_rows == n_rows && workspace->n_sample_rows == n_sample_rows)
+			return;
+
+		// the buffers are large enough, only their shapes change
+		workspace->n_rows = n_rows;
+		workspace->n_sample_rows = n_sample_rows;
+		workspace->epoch_position = n_rows;
+		workspace->Yhat->n_rows = n_sample_rows;
+		if (workspace->X_sample)
+		{
+			workspace->X_sample->n_rows = n_sample_rows;
+			workspace->Y_sample->n_rows = n_sample_rows;
+		}
+		if (workspace->row_idx)
+			for (size_t r = 0; r < n_rows; ++r)
+				workspace->row_idx[r] = r;
+		if (workspace->shards)
+			__shard_rows(workspace, n_rows);
+		return;
+	}
+
+	// the optimizer state only depends on the columns, so it survives a
+	// resize (e.g. partial_fit() chunks with different numbers of rows)
+	LinearModelOptimizerState optimizer_state = workspace->optimizer_state;
+	const bool keep_optimizer_state = workspace->n_columns == n_columns;
+	if (keep_optimizer_state)
+	{
+		workspace->optimizer_state.velocity = NULL;
+		workspace->optimizer_state.accumulator = NULL;
+	}
+
+	__workspace_release(workspace);
+	__workspace_alloc(workspace, lm, n_rows, n_columns, chunk_rows);
+
+	if (keep_optimizer_state)
+	{
+		free(workspace->optimizer_state.velocity);
+		free(workspace->optimizer_state.accumulator);
+		workspace->optimizer_state = optimizer_state;
+	}
+}
+
+// next n_sample_rows rows of the current epoch, see gmf_fit_next_sample()
+static const size_t* __next_sample(LinearModelWorkspace* workspace)
+{
+	return gmf_fit_next_sample(
+			&workspace->random_state,
+			workspace->row_idx,
+			workspace->n_rows,
+			workspace->n_sample_rows,
+			&workspace->epoch_position);
+}
+
+// copy sampled rows into the workspace's X_sample/Y_sample (as float). Only
+// used for custom (unfused) functions which need the sample as a Matrix.
+static void __gather_rows(
+	LinearModelWorkspace* workspace,
+	const FeatureMatrix* X,
+	const Matrix* Y,
+	const size_t* sample_idx)
+{
+	// allocated for sample_capacity rows so a smaller sample reuses them, see __workspace_reserve()
+	if (!workspace->X_sample)
+	{
+		mat_init(&workspace->X_sample, workspace->sample_capacity, workspace->n_columns);
+		mat_init(&workspace->Y_sample, workspace->sample_capacity, 1);
+		workspace->X_sample->n_rows = workspace->n_sample_rows;
+		workspace->Y_sample->n_rows = workspace->n_sample_rows;
+	}
+
+	const size_t n_columns = X->n_columns;
+	for (size_t i = 0; i < workspace->n_sample_rows; ++i)
+	{
+		size_t row = sample_idx[i];
+		gmf_features_row(X, row, workspace->X_sample->data + i * n_columns);
+		workspace->Y_sample->data[i] = Y->data[row];
+	}
+}
+
+// scalar regularization gradient added to every residual. Proximal
+// regularizations contribute nothing here, see __update_weights()
+static float __residual_regularization(const LinearModel* lm)
+{
+	if (!lm->regularization_gradient || gmf_regularization_is_proximal(lm->regularization))
+		return 0.0f;
+	return lm->regularization_gradient(lm->params->regularization_params, lm->W);
+}
+
+// update W with the optimizer. With gmf_optimizer_sgd the L1/L2/elastic net
+// regularization is applied as a proximal step of size learning_rate after
+// the update (L1 sets small weights to exactly zero). The other optimizers
+// scale the step of every weight differently, so they get the exact gradient
+// of the regularization added to loss_gradient instead.
+static void __update_weights(
+	LinearModel* lm,
+	Matrix* loss_gradient,
+	const float learning_rate,
+	LinearModelWorkspace* workspace)
+{
+	const bool proximal = gmf_regularization_is_proximal(lm->regularization);
+	const size_t first = lm->params->exclude_bias ? 1 : 0;
+	if (proximal && lm->optimizer != &gmf_optimizer_sgd)
+		gmf_regularization_gradient_weights(lm->regularization, lm->params->regularization_params, first, lm->W->data, lm->W->n_rows, loss_gradient->data);
+
+	lm->optimizer(&lm->W, loss_gradient, learning_rate, lm, &workspace->optimizer_state);
+
+	if (proximal && lm->optimizer == &gmf_optimizer_sgd)
+		gmf_regularization_proximal(lm->regularization, lm->params->regularization_params, learning_rate, first, lm->W->data, lm->W->n_rows);
+}
+
+typedef struct chunk_args
+{
+	const FeatureMatrix* X;
+	const Matrix* Y;
+	const size_t* row_idx;
+	size_t n_rows;
+	const LinearModel* lm;
+	LinearModelWorkspace* workspace;
+	float regularization_gradient;
+	bool compute_loss;
+} chunk_args;
+
+// fused loss + gradient over a single chunk of rows
+static void __chunk_loss_gradient(void* args, size_t chunk)
+{
+	chunk_args* c_args = args;
+	const size_t n_columns = c_args->X->n_columns;
+	const size_t chunk_rows = c_args->workspace->chunk_rows;
+	const size_t row_start = chunk * chunk_rows;
+	size_t row_end = row_start + chunk_rows;
+	if (row_end > c_args->n_rows)
+		row_end = c_args->n_rows;
+
+	float* gradient = c_args->workspace->partial_gradients + chunk * n_columns;
+	for (size_t c = 0; c < n_columns; ++c)
+		gradient[c] = 0.0f;
+
+	c_args->workspace->partial_losses[chunk] = gmf_fused_loss_accumulate(
+			c_args->X, 
+			c_args->Y, 
+			c_args->lm, 
+			c_args->regularization_gradient, 
+			c_args->row_idx,
+			row_start, 
+			row_end, 
+			c_args->compute_loss,
+			gradient);
+}
+
+// fused loss + gradient over n_rows rows of X (all rows if row_idx is NULL,
+// otherwise the rows listed in row_idx) computed chunk by chunk (possibly
+// on multiple threads). The per-chunk results are combined with a
+// pairwise tree reduction in a fixed order so the result is identical
+// regardless of how many threads were used. Without compute_loss only the
+// gradient is computed and the returned loss is 0.
+static float __chunked_loss_gradient(
+	const LinearModel* lm,
+	const FeatureMatrix* X,
+	const Matrix* Y,
+	const size_t* row_idx,
+	const size_t n_rows,
+	const bool compute_loss,
+	LinearModelWorkspace* workspace,
+	Matrix** loss_gradient)
+{
+	const size_t n_chunks = (n_rows + workspace->chunk_rows - 1) / workspace->chunk_rows;
+	chunk_args args = {
+		.X = X,
+		.Y = Y,
+		.row_idx = row_idx,
+		.n_rows = n_rows,
+		.lm = lm,
+		.workspace = workspace,
+		.regularization_gradient = __residual_regularization(lm),
+		.compute_loss = compute_loss
+	};
+
+	gmf_fit_run_chunks(workspace->thread_pool, n_chunks, &__chunk_loss_gradient, &args);
+
+	const size_t n_columns = X->n_columns;
+	gmf_fit_reduce_chunks(workspace->partial_gradients, workspace->partial_losses, n_chunks, n_columns);
+	for (size_t c = 0; c < n_columns; ++c)
+		(*loss_gradient)->data[c] = workspace->partial_gradients[c] / (float)n_rows;
+
+	double loss = workspace->partial_losses[0];
+	if (compute_loss && lm->regularization)
+		loss += lm->regularization(lm->params->regularization_params, lm->W);
+
+	return (float)loss;
+}
+
+typedef struct sgd_args
+{
+	const FeatureMatrix* X;
+	const Matrix* Y;
+	const LinearModel* lm;
+	LinearModelWorkspace* workspace;
+	size_t n_samples;
+	float learning_rate;
+	float regularization_gradient;
+	bool proximal; // take the proximal step after every sample
+	LazyRegularization* lazy; // NULL unless the regularization is deferred
+} sgd_args;
+
+// run one shard's share (n_samples / n_shards) of n_samples per-sample SGD updates. With HOGWILD
+// every shard runs on its own thread and they all update the shared W
+// without any locking - updates from different threads may occasionally
+// overwrite each other, which is fine as long as they rarely overlap.
+static void __sgd_shard(void* args, size_t shard_idx)
+{
+	sgd_args* s_args = args;
+	LinearModelWorkspace* workspace = s_args->workspace;
+	LinearModelShard* shard = &workspace->shards[shard_idx];
+	size_t* row_idx = workspace->row_idx + shard->row_start;
+
+	size_t n_samples = s_args->n_samples / workspace->n_shards;
+	if (shard_idx < s_args->n_samples % workspace->n_shards)
+		n_samples++;
+
+	// only the last few samples of the window compute their loss
+	const size_t first_loss = n_samples > GMF_SGD_LOSS_SAMPLES ? n_samples - GMF_SGD_LOSS_SAMPLES : 0;
+	shard->n_loss_samples = n_samples - first_loss;
+
+	// walk the shuffled epoch of this shard, updating W inplace one row at a time
+	shard->loss = 0.0;
+	size_t n_done = 0;
+	while (n_done < n_samples)
+	{
+		if (shard->epoch_position == shard->n_rows)
+		{
+			gmf_util_shuffle(&shard->random_state, row_idx, shard->n_rows);
+			shard->epoch_position = 0;
+		}
+
+		size_t n = n_samples - n_done;
+		if (n > shard->n_rows - shard->epoch_position)
+			n = shard->n_rows - shard->epoch_position;
+
+		// samples of this piece that fall in the reported tail
+		const size_t n_loss = n_done + n > first_loss ? n_done + n - (n_done > first_loss ? n_done : first_loss) : 0;
+
+		shard->loss += gmf_fused_loss_sgd(
+				s_args->X, 
+				s_args->Y, 
+				s_args->lm, 
+				s_args->learning_rate,
+				s_args->regularization_gradient,
+				row_idx + shard->epoch_position,
+				n,
+				n_loss,
+				s_args->proximal,
+				s_args->lazy,
+				s_args->lm->W->data);
+
+		shard->epoch_position += n;
+		n_done += n;
+	}
+}
+
+typedef struct solver_args
+{
+	const FeatureMatrix* X;
+	const Matrix* Y;
+	const LinearModel* lm;
+	LinearModelWorkspace* workspace;
+} solver_args;
+
+// accumulate one thread's share of the rows into its own system
+static void __solver_partial(void* args, size_t partial)
+{
+	solver_args* s_args = args;
+	LinearModelWorkspace* workspace = s_args->workspace;
+	const size_t n_rows = s_args->X->n_rows;
+	const size_t n_columns = s_args->X->n_columns;
+
+	double* gram = workspace->solver_partials + partial * __solver_stride(n_columns);
+	double* rhs = gram + n_columns * n_columns;
+	double* rows = rhs + n_columns;
+	memset(gram, 0, n_columns * (n_columns + 1) * sizeof(double));
+
+	workspace->solver_losses[partial] = gmf_solver_accumulate(
+			s_args->X,
+			s_args->Y,
+			s_args->lm,
+			partial * n_rows / workspace->n_solver_partials,
+			(partial + 1) * n_rows / workspace->n_solver_partials,
+			gram,
+			rhs,
+			rows);
+}
+
+// build the CHOLESKY/NEWTON system over every row of X in a single pass.
+// The reduced system is left in the first partial (gram followed by rhs).
+// NOTE: the rows are split per thread so the last few bits of the
+// solution can depend on n_threads.
+static double __solver_system(
+	const LinearModel* lm,
+	const FeatureMatrix* X,
+	const Matrix* Y,
+	LinearModelWorkspace* workspace)
+{
+	solver_args args = {
+		.X = X,
+		.Y = Y,
+		.lm = lm,
+		.workspace = workspace
+	};
+	if (workspace->thread_pool && workspace->n_solver_partials > 1)
+		gmf_util_thread_pool_run(workspace->thread_pool, workspace->n_solver_partials, &__solver_partial, &args);
+	else
+		for (size_t p = 0; p < workspace->n_solver_partials; ++p)
+			__solver_partial(&args, p);
+
+	const size_t n_columns = X->n_columns;
+	const size_t stride = __solver_stride(n_columns);
+	double loss = workspace->solver_losses[0];
+	for (size_t p = 1; p < workspace->n_solver_partials; ++p)
+	{
+		const double* partial = workspace->solver_partials + p * stride;
+		for (size_t i = 0; i < n_columns * (n_columns + 1); ++i)
+			workspace->solver_partials[i] += partial[i];
+		loss += workspace->solver_losses[p];
+	}
+
+	return loss;
+}
+
+// solve (gram + ridge * I) * step = rhs for step (stored in solver_step).
+// If the system is (numerically) singular, e.g. due to duplicated
+// columns, a small jitter is added to the diagonal until it factors.
+static void __solver_solve(
+	LinearModelWorkspace* workspace,
+	const double ridge)
+{
+	const size_t n = workspace->n_columns;
+	const double* gram = workspace->solver_partials;
+	const double* rhs = gram + n * n;
+
+	double mean_diagonal = 0.0;
+	for (size_t i = 0; i < n; ++i)
+		mean_diagonal += gram[i * n + i];
+	mean_diagonal = mean_diagonal > 0.0 ? mean_diagonal / (double)n : 1.0;
+
+	double jitter = 0.0;
+	for (size_t attempt = 0; ; ++attempt)
+	{
+		memcpy(workspace->solver_factor, gram, n * n * sizeof(double));
+		for (size_t i = 0; i < n; ++i)
+			workspace->solver_factor[i * n + i] += ridge + jitter;
+		if (gmf_solver_cholesky(workspace->solver_factor, n))
+			break;
+
+		if (attempt == 10)
+			err("Couldn't solve linear system - X^T X is singular. Consider using L2 regularization.");
+		jitter = jitter == 0.0 ? 1e-10 * mean_diagonal : jitter * 100.0;
+	}
+
+	memcpy(workspace->solver_step, rhs, n * sizeof(double));
+	gmf_solver_cholesky_solve(workspace->solver_factor, workspace->solver_step, n);
+}
+
+// L2 penalty of the direct solvers (which can't use arbitrary regularization)
+static float __solver_lambda(const LinearModel* lm)
+{
+	if (!lm->regularization)
+		return 0.0f;
+	if (lm->regularization != &gmf_regularization_L2)
+		err("CHOLESKY and NEWTON only support gmf_regularization_L2.");
+	return lm->params->regularization_params[0];
+}
+
+typedef struct lbfgs_args
+{
+	const FeatureMatrix* X;
+	const Matrix* X_matrix; // NULL when training on a reduced precision FeatureMatrix
+	const Matrix* Y;
+	LinearModel* lm;
+	LinearModelWorkspace* workspace;
+	float (*fused_loss_gradient)(const Matrix*, const Matrix*, const LinearModel*, Matrix**);
+	bool builtin_kernel;
+	double loss; // loss (as reported by the loss function) of the last evaluation
+} lbfgs_args;
+
+// LBFGS objective: the loss divided by n_rows (the loss gradients are
+// averaged over the rows) and its gradient at the current W, computed
+// the same way CLASSIC computes them
+static double __lbfgs_objective(void* args, double* gradient)
+{
+	lbfgs_args* l_args = args;
+	LinearModel* lm = l_args->lm;
+	LinearModelWorkspace* workspace = l_args->workspace;
+	Matrix* loss_grad = workspace->loss_gradient;
+	float loss = 0.0f;
+
+	if (l_args->builtin_kernel)
+		loss = __chunked_loss_gradient(lm, l_args->X, l_args->Y, NULL, l_args->X->n_rows, true, workspace, &loss_grad);
+	else if (l_args->fused_loss_gradient)
+		loss = l_args->fused_loss_gradient(l_args->X_matrix, l_args->Y, lm, &loss_grad);
+	else
+	{
+		Matrix* Yhat = workspace->Yhat;
+		mat_multiply_inplace(l_args->X_matrix, lm->W, &Yhat);
+		lm->activation(&Yhat, lm);
+		loss = lm->loss(l_args->Y, Yhat, lm);
+		lm->loss_gradient(l_args->Y, Yhat, l_args->X_matrix, lm, &loss_grad);
+	}
+
+	l_args->loss = loss;
+
+	// LBFGS can't take proximal steps so proximal regularizations are added
+	// to the average loss (and its gradient) like the other training modes.
+	// The line search needs f and its gradient to match, so both skip the
+	// bias with exclude_bias (other regularizations are rejected by fit()).
+	double objective = (double)loss / (double)l_args->X->n_rows;
+	if (gmf_regularization_is_proximal(lm->regularization))
+	{
+		const float* params = lm->params->regularization_params;
+		const size_t first = lm->params->exclude_bias ? 1 : 0;
+		const Matrix penalized = {
+			.data = lm->W->data + first,
+			.n_rows = workspace->n_columns - first,
+			.n_columns = 1
+		};
+		const double penalty = lm->regularization(params, &penalized);
+		gmf_regularization_gradient_weights(lm->regularization, params, first, lm->W->data, workspace->n_columns, loss_grad->data);
+		objective = ((double)loss - lm->regularization(params, lm->W)) / (double)l_args->X->n_rows + penalty;
+	}
+
+	for (size_t c = 0; c < workspace->n_columns; ++c)
+		gradient[c] = loss_grad->data[c];
+
+	return objective;
+}
+
+// split the regularization of COORDINATE_DESCENT into its L1 and L2 parts
+static void __cd_penalty(const LinearModel* lm, double* l1, double* l2)
+{
+	*l1 = 0.0;
+	*l2 = 0.0;
+	if (!lm->regularization)
+		return;
+
+	const float* params = lm->params->regularization_params;
+	if (lm->regularization == &gmf_regularization_L1)
+		*l1 = params[0];
+	else if (lm->regularization == &gmf_regularization_L2)
+		*l2 = params[0];
+	else if (lm->regularization == &gmf_regularization_elastic_net)
+	{
+		*l1 = params[0] * params[1];
+		*l2 = params[0] * (1.0f - params[1]);
+	}
+	else
+		err("COORDINATE_DESCENT only supports gmf_regularization_L1, gmf_regularization_L2 and gmf_regularization_elastic_net.");
+}
+
+// column-major copy of X (only the non-zero values of a FEATURES_CSR X)
+// and the residual of W. The copy grows with X but is never shrunk.
+static void __cd_prepare(
+	LinearModelWorkspace* workspace,
+	const FeatureMatrix* X,
+	const Matrix* Y,
+	const float* W)
+{
+	const bool sparse = X->type == FEATURES_CSR;
+	if (sparse && X->n_rows > UINT32_MAX)
+		err("COORDINATE_DESCENT supports at most 2^32 - 1 rows of FEATURES_CSR data.");
+
+	const size_t n_values = gmf_features_nonzeros(X);
+	if (n_values > workspace->cd_capacity || (sparse && !workspace->cd_row_idx))
+	{
+		const size_t capacity = n_values > workspace->cd_capacity ? n_values : workspace->cd_capacity;
+		free(workspace->cd_X_columns);
+		free(workspace->cd_row_idx);
+		workspace->cd_row_idx = NULL;
+		workspace->cd_X_columns = malloc((capacity + 1) * sizeof(float));
+		if (sparse)
+			workspace->cd_row_idx = malloc((capacity + 1) * sizeof(uint32_t));
+		if (!workspace->cd_X_columns || (sparse && !workspace->cd_row_idx))
+			err("Couldn't allocate memory for LinearModelWorkspace.");
+		workspace->cd_capacity = capacity;
+	}
+
+	gmf_coordinate_descent_prepare(X, Y, W, workspace->cd_column_ptr, workspace->cd_row_idx, workspace->cd_X_columns, workspace->cd_column_norms, workspace->cd_residual);
+	// a dense X doesn't use row_idx (even if a previous fit() was sparse)
+	if (!sparse)
+	{
+		free(workspace->cd_row_idx);
+		workspace->cd_row_idx = NULL;
+	}
+}
+
+// sum((y - XW)^2) + l1 * sum(|w_j|) + l2 * sum(w_j^2) from the cached residual
+static double __cd_loss(
+	const LinearModel* lm, 
+	const LinearModelWorkspace* workspace, 
+	const double l1, 
+	const double l2)
+{
+	double loss = 0.0;
+	for (size_t r = 0; r < workspace->n_rows; ++r)
+		loss += workspace->cd_residual[r] * workspace->cd_residual[r];
+
+	const size_t first_penalized = lm->params->exclude_bias ? 1 : 0;
+	for (size_t c = first_penalized; c < workspace->n_columns; ++c)
+	{
+		const double w = lm->W->data[c];
+		loss += l1 * fabs(w) + l2 * w * w;
+	}
+
+	return loss;
+}
+
+// run coordinate descent from the current W (the cached residual must match W).
+// Full sweeps over every column alternate with sweeps over the active set
+// (columns with non-zero weights) until a full sweep no longer changes the
+// predictions by more than early_stop_threshold. Every sweep counts as an
+// iteration. Returns true if it converged within n_iterations.
+static bool __coordinate_descent(
+	LinearModel* lm,
+	LinearModelWorkspace* workspace,
+	const double l1,
+	const double l2,
+	const bool verbose)
+{
+	const size_t n_rows = workspace->n_rows;
+	const size_t n_columns = workspace->n_columns;
+	const size_t first_penalized = lm->params->exclude_bias ? 1 : 0;
+	const double tolerance = lm->params->early_stop_threshold;
+	float* W = lm->W->data;
+
+	size_t iter = 0;
+	while (iter < lm->params->n_iterations)
+	{
+		double change = gmf_coordinate_descent_sweep(workspace->cd_X_columns, workspace->cd_column_ptr, workspace->cd_row_idx, n_rows, workspace->cd_columns, n_columns, workspace->cd_column_norms, l1, l2, first_penalized, workspace->cd_residual, W);
+		if (verbose)
+			printf("Loss at iteration %zu: %f\n", iter, (float)__cd_loss(lm, workspace, l1, l2));
+		iter++;
+		if (change < tolerance)
+			return true;
+
+		// weights that are zero after a full sweep usually stay zero
+		size_t n_active = 0;
+		for (size_t c = 0; c < n_columns; ++c)
+			if (c < first_penalized || W[c] != 0.0f)
+				workspace->cd_active[n_active++] = c;
+
+		while (iter < lm->params->n_iterations)
+		{
+			change = gmf_coordinate_descent_sweep(workspace->cd_X_columns, workspace->cd_column_ptr, workspace->cd_row_idx, n_rows, workspace->cd_active, n_active, workspace->cd_column_norms, l1, l2, first_penalized, workspace->cd_residual, W);
+			iter++;
+			if (change < tolerance)
+				break;
+		}
+	}
+
+	return false;
 }
 
 // linear must must have:
@@ -83,42 +1084,259 @@ static void __check_functions(const LinearModel* lm)
 		err("LinearModel missing gradient function for regularization.");
 	if (lm->regularization_gradient && !lm->regularization)
 		err("LinearModel missing regularization function while regularization gradient is specified.");
+	if (!lm->optimizer)
+		err("LinearModel must have optimizer. See gmf_optimizer_...");
+	if (!lm->learning_rate_schedule)
+		err("LinearModel must have learning rate schedule. See gmf_learning_rate_...");
 }
 
-// check if loss hasn't really improved for N iterations
+// check if loss hasn't really improved for N iterations.
+// n_steps is the number of iterations since the previous check
 static bool __check_loss_tolerance(
 	const float loss, 
 	const float previous_loss, 
 	const float tolerance,
 	size_t* tolerance_counter,
-	const size_t early_stop_iterations)
+	const size_t early_stop_iterations,
+	const size_t n_steps)
 {
 	if (fabsf(loss - previous_loss) < tolerance)
-		(*tolerance_counter)++;
+		(*tolerance_counter) += n_steps;
 	else
 		*tolerance_counter = 0;
 
-	if (*tolerance_counter >= early_stop_iterations)
+	return *tolerance_counter >= early_stop_iterations;
+}
+
+// iterations between loss/early stop checks. A single sample is
+// cheap compared to a loss check so STOCHASTIC/HOGWILD check less often
+static size_t __check_interval(const LinearModelParams* params)
+{
+	if (params->loss_check_interval > 0)
+		return params->loss_check_interval;
+	if (params->model_type == STOCHASTIC || params->model_type == HOGWILD)
+		return 100;
+	return 1;
+}
+
+// every loss check of deferred regularization brings all of W up to date and
+// computes the regularization of W, both O(n_columns). By default the loss is
+// checked at most once per ~n_columns non-zero values so a step stays O(non-zero values).
+static size_t __lazy_check_interval(
+	const FeatureMatrix* X,
+	const size_t n_sample_rows,
+	const size_t check_interval)
+{
+	const size_t n_nonzero = gmf_features_nonzeros(X);
+	const size_t per_iteration = X->n_rows > 0 ? n_nonzero * n_sample_rows / X->n_rows : 0;
+	const size_t interval = per_iteration > 0 ? X->n_columns / per_iteration : 1;
+	return interval > check_interval ? interval : check_interval;
+}
+
+// drop the state of partial_fit() (if any)
+static void __partial_free(LinearModel* lm)
+{
+	if (!lm->partial)
+		return;
+
+	if (lm->partial->workspace)
+		gmf_model_linear_workspace_free(&lm->partial->workspace);
+	free(lm->partial);
+	lm->partial = NULL;
+}
+
+// validation data is only used by the iterative model types
+static bool __uses_validation(const LinearModel* lm)
+{
+	if (!lm->validation_X)
+		return false;
+
+	const LinearModelType model_type = lm->params->model_type;
+	return model_type == CLASSIC 
+		|| model_type == BATCH 
+		|| model_type == STOCHASTIC 
+		|| model_type == HOGWILD 
+		|| model_type == LBFGS;
+}
+
+// size the validation buffers and draw the (fixed) validation subsample
+// for this fit(). Custom (unfused) functions get the subsample copied
+// once so every loss check can use the matrix functions.
+static void __validation_prepare(
+	LinearModelWorkspace* workspace,
+	const LinearModel* lm,
+	const bool builtin_loss)
+{
+	if (!__uses_validation(lm))
 	{
-		printf("NOTE: no improvement in loss after %zu consecutive iterations. Stopped early.\n", early_stop_iterations);
-		return true;
+		__validation_release(workspace);
+		return;
 	}
 
-	return false;
+	const Matrix* X = lm->validation_X;
+	const Matrix* Y = lm->validation_Y;
+	if (X->n_columns != workspace->n_columns)
+		err("LinearModel validation_X must have the same number of columns as X.");
+	if (!Y || Y->n_rows != X->n_rows || Y->n_columns != 1)
+		err("LinearModel validation_Y must be an (n_rows, 1) matrix matching validation_X.");
+
+	size_t n_validation_rows = X->n_rows;
+	if (lm->params->validation_sample_size > 0 && lm->params->validation_sample_size < X->n_rows)
+		n_validation_rows = lm->params->validation_sample_size;
+	const bool needs_idx = n_validation_rows < X->n_rows;
+
+	if (workspace->n_validation_rows != n_validation_rows
+			|| (workspace->validation_idx != NULL) != needs_idx
+			|| (workspace->validation_Yhat != NULL) == builtin_loss)
+	{
+		__validation_release(workspace);
+		workspace->n_validation_rows = n_validation_rows;
+		workspace->best_W = malloc(workspace->n_columns * sizeof(float));
+		if (!workspace->best_W)
+			err("Couldn't allocate memory for LinearModelWorkspace.");
+		if (needs_idx)
+		{
+			workspace->validation_idx = malloc(n_validation_rows * sizeof(size_t));
+			if (!workspace->validation_idx)
+				err("Couldn't allocate memory for LinearModelWorkspace.");
+		}
+		if (!builtin_loss)
+		{
+			mat_init(&workspace->validation_Yhat, n_validation_rows, 1);
+			if (needs_idx)
+			{
+				mat_init(&workspace->validation_X_sample, n_validation_rows, X->n_columns);
+				mat_init(&workspace->validation_Y_sample, n_validation_rows, 1);
+			}
+		}
+	}
+
+	if (!needs_idx)
+		return;
+
+	gmf_util_sample(&workspace->random_state, workspace->validation_idx, n_validation_rows, X->n_rows);
+	if (!builtin_loss)
+	{
+		for (size_t i = 0; i < n_validation_rows; ++i)
+		{
+			size_t row = workspace->validation_idx[i];
+			memcpy(workspace->validation_X_sample->data + i * X->n_columns, X->data + row * X->n_columns, X->n_columns * sizeof(float));
+			workspace->validation_Y_sample->data[i] = Y->data[row];
+		}
+	}
 }
 
-void gmf_model_linear_fit(
+// loss (including regularization) on the validation rows of this fit()
+static float __validation_loss(
+	const LinearModel* lm,
+	LinearModelWorkspace* workspace)
+{
+	if (!workspace->validation_Yhat)
+	{
+		// built-in functions read the sampled rows straight out of validation_X
+		const FeatureMatrix validation_X = gmf_features_view(lm->validation_X);
+		float loss = (float)gmf_fused_loss_value(&validation_X, lm->validation_Y, lm, workspace->validation_idx, workspace->n_validation_rows);
+		if (lm->regularization)
+			loss += lm->regularization(lm->params->regularization_params, lm->W);
+		return loss;
+	}
+
+	const Matrix* X = workspace->validation_idx ? workspace->validation_X_sample : lm->validation_X;
+	const Matrix* Y = workspace->validation_idx ? workspace->validation_Y_sample : lm->validation_Y;
+	mat_multiply_inplace(X, lm->W, &workspace->validation_Yhat);
+	lm->activation(&workspace->validation_Yhat, lm);
+
+	return lm->loss(Y, workspace->validation_Yhat, lm);
+}
+
+// state of the loss checks during fit()
+typedef struct loss_tracker
+{
+	float previous_loss; // loss at the previous check
+	size_t tolerance_counter; // iterations without improvement
+	float validation_loss; // validation loss at the last check
+	float best_loss; // lowest validation loss so far
+	bool has_best; // best_W holds the weights with best_loss
+	bool stopped_early; // no improvement for early_stop_iterations
+} loss_tracker;
+
+// loss check n_steps iterations after the previous one. With validation
+// data the validation loss decides early stopping (loss is ignored): W is
+// checkpointed whenever it improves and training stops once it hasn't
+// improved on its best by early_stop_threshold for early_stop_iterations
+// iterations (so a rising validation loss stops training as well).
+// Returns true to stop training.
+static bool __check_loss(
+	const LinearModel* lm,
+	LinearModelWorkspace* workspace,
+	float loss,
+	const size_t n_steps,
+	loss_tracker* tracker)
+{
+	if (workspace->best_W)
+	{
+		loss = __validation_loss(lm, workspace);
+		tracker->validation_loss = loss;
+		if (tracker->has_best && loss < tracker->best_loss - lm->params->early_stop_threshold)
+			tracker->tolerance_counter = 0;
+		else if (tracker->has_best)
+			tracker->tolerance_counter += n_steps;
+
+		if (!tracker->has_best || loss < tracker->best_loss)
+		{
+			tracker->best_loss = loss;
+			tracker->has_best = true;
+			memcpy(workspace->best_W, lm->W->data, workspace->n_columns * sizeof(float));
+		}
+
+		tracker->stopped_early = tracker->tolerance_counter >= lm->params->early_stop_iterations;
+		tracker->previous_loss = loss;
+
+		return tracker->stopped_early;
+	}
+
+	tracker->stopped_early = __check_loss_tolerance(loss, tracker->previous_loss, lm->params->early_stop_threshold, &tracker->tolerance_counter, lm->params->early_stop_iterations, n_steps);
+	tracker->previous_loss = loss;
+
+	return tracker->stopped_early;
+}
+
+static void __print_loss(
+	const size_t iter,
+	const float loss,
+	const loss_tracker* tracker)
+{
+	if (tracker->has_best)
+		printf("Loss at iteration %zu: %f (validation loss: %f)\n", iter, loss, tracker->validation_loss);
+	else
+		printf("Loss at iteration %zu: %f\n", iter, loss);
+}
+
+// train on X (stored in any precision). Custom functions that need X as a
+// Matrix (CLASSIC and LBFGS) use X_matrix which is NULL for fit_features().
+static void __fit(
 	LinearModel** lm,
-	const Matrix* X,
+	const FeatureMatrix* X,
+	const Matrix* X_matrix,
 	const Matrix* Y,
 	const bool verbose)
 {
 	__check_functions(*lm);
-	__init_W(lm, X);
+
+	// fit() trains from scratch, partial_fit() starts over afterwards
+	__partial_free(*lm);
+
+	// every random draw of fit() comes from this stream. Without a random_seed
+	// it follows rand() so srand() makes training reproducible
+	RandomState random_state;
+	gmf_util_random_seed(&random_state, (*lm)->params->random_seed ? (*lm)->params->random_seed : (uint64_t)rand());
+	__init_W(lm, X->n_columns, &random_state);
 
 	// set default batch size if one wasn't set (default of 25% original data size)
 	if ((*lm)->params->model_type == BATCH && (*lm)->params->batch_size == 0)
 		(*lm)->params->batch_size = X->n_rows / 4;
+	if ((*lm)->params->model_type == BATCH && (*lm)->params->batch_size > X->n_rows)
+		err("LinearModel batch_size can't be larger than the number of rows in X.");
 	// set default early_stop_iterations if one wasn't set (default is 10% original iterations)
 	if ((*lm)->params->early_stop_iterations == 0)
 		(*lm)->params->early_stop_iterations = (*lm)->params->n_iterations / 10;
@@ -126,14 +1344,111 @@ void gmf_model_linear_fit(
 	if ((*lm)->regularization && !(*lm)->params->regularization_params)
 		err("LinearModel regularization function missing parameters. Please use gmf_model_..._set_regularization_params().");
 
-	Matrix* loss_grad = NULL;
-	mat_init(&loss_grad, X->n_columns, 1);
+	// every buffer used while training lives in the workspace, sparse X
+	// needs fewer (larger) chunks so they're sized from X
+	const size_t chunk_rows = __chunk_rows(X);
+	LinearModelWorkspace* workspace = (*lm)->workspace;
+	if (workspace)
+		__workspace_reserve(workspace, *lm, X->n_rows, X->n_columns, chunk_rows);
+	else
+		workspace = __workspace_init(*lm, X->n_rows, X->n_columns, chunk_rows);
+	Matrix* loss_grad = workspace->loss_gradient;
+
+	// every fit() starts the optimizer from scratch
+	workspace->optimizer_state.step = 0;
+	memset(workspace->optimizer_state.velocity, 0, workspace->optimizer_state.n_weights * sizeof(float));
+	memset(workspace->optimizer_state.accumulator, 0, workspace->optimizer_state.n_weights * sizeof(float));
+
+	gmf_util_random_seed(&workspace->random_state, gmf_util_random_next(&random_state));
+	workspace->epoch_position = workspace->n_rows;
+	if (workspace->shards)
+	{
+		// shards get a random subset of the rows and their own random stream
+		gmf_util_shuffle(&workspace->random_state, workspace->row_idx, workspace->n_rows);
+		for (size_t s = 0; s < workspace->n_shards; ++s)
+		{
+			gmf_util_random_seed(&workspace->shards[s].random_state, gmf_util_random_next(&workspace->random_state));
+			workspace->shards[s].epoch_position = workspace->shards[s].n_rows;
+		}
+	}
+
+	// prefer a fused kernel (single pass over X) whenever one is available
+	float (*fused_loss_gradient)(const Matrix*, const Matrix*, const LinearModel*, Matrix**) = (*lm)->fused_loss_gradient;
+	if (!fused_loss_gradient)
+		fused_loss_gradient = gmf_fused_loss_select(*lm);
+	// built-in kernels can be split into chunks and run on multiple threads
+	// or run sample by sample for STOCHASTIC
+	bool builtin_kernel = fused_loss_gradient && fused_loss_gradient == gmf_fused_loss_select(*lm);
+	// custom functions of CLASSIC and LBFGS need all of X as a Matrix, a
+	// reduced precision X (or a row view) is converted once for this fit()
+	Matrix* X_decoded = NULL;
+	if (!X_matrix && !builtin_kernel 
+			&& ((*lm)->params->model_type == CLASSIC || (*lm)->params->model_type == LBFGS))
+	{
+		__check_dense_size(X->n_rows, X->n_columns, "Custom functions need X as a dense Matrix which is too large for this X. Please use the built-in functions or a smaller X.");
+		mat_init(&X_decoded, X->n_rows, X->n_columns);
+		for (size_t r = 0; r < X->n_rows; ++r)
+			gmf_features_row(X, r, X_decoded->data + r * X->n_columns);
+		X_matrix = X_decoded;
+	}
+
+	// plain SGD on sparse rows only touches the weights of their non-zero
+	// columns: BATCH steps through the rows of a batch directly instead of
+	// building a dense gradient and the proximal regularization of single
+	// threaded STOCHASTIC/BATCH is deferred until a weight is used
+	const bool sparse_sgd = X->type == FEATURES_CSR 
+		&& builtin_kernel 
+		&& (*lm)->optimizer == &gmf_optimizer_sgd;
+	LazyRegularization* lazy = NULL;
+	if (sparse_sgd 
+			&& gmf_regularization_is_proximal((*lm)->regularization)
+			&& ((*lm)->params->model_type == BATCH || (*lm)->params->model_type == STOCHASTIC))
+	{
+		lazy = &workspace->lazy_regularization;
+		gmf_regularization_lazy_init(lazy, (*lm)->regularization, (*lm)->params->regularization_params, (*lm)->params->exclude_bias ? 1 : 0, X->n_columns);
+	}
+
+	// validation rows are drawn once so every check sees the same rows
+	__validation_prepare(workspace, *lm, gmf_fused_loss_select(*lm) != NULL);
+
+	// the loss is only checked every check_interval iterations and
+	// printed (at most) 10 times for any given number of iterations
+	size_t check_interval = __check_interval((*lm)->params);
+	if (lazy && (*lm)->params->loss_check_interval == 0)
+		check_interval = __lazy_check_interval(X, workspace->n_sample_rows, check_interval);
+	const size_t print_interval = (*lm)->params->n_iterations >= 10 ? (*lm)->params->n_iterations / 10 : 1;
+	loss_tracker tracker = {
+		.previous_loss = 0.0f,
+		.tolerance_counter = 0,
+		.validation_loss = 0.0f,
+		.best_loss = 0.0f,
+		.has_best = false,
+		.stopped_early = false
+	};
 
 	float initial_loss = 0.0f;
-	float previous_loss = 0.0f;
-	size_t tolerance_counter = 0;
 	bool stop_early = false;
 
+	if ((*lm)->params->model_type == CHOLESKY 
+			&& ((*lm)->activation != &gmf_activation_identity || fused_loss_gradient != &gmf_fused_loss_squared))
+		err("CHOLESKY requires gmf_activation_identity and gmf_loss_squared.");
+	if ((*lm)->params->model_type == NEWTON
+			&& ((*lm)->activation == &gmf_activation_identity || fused_loss_gradient != &gmf_fused_loss_cross_entropy))
+		err("NEWTON requires a sigmoid activation and gmf_loss_cross_entropy.");
+	// the line search needs the exact gradient of the objective, which only
+	// the proximal regularizations provide (the others have a scalar shortcut)
+	if ((*lm)->params->model_type == LBFGS
+			&& (*lm)->regularization
+			&& !gmf_regularization_is_proximal((*lm)->regularization))
+		err("LBFGS only supports gmf_regularization_L1, gmf_regularization_L2 and gmf_regularization_elastic_net.");
+
+	if ((*lm)->params->model_type == COORDINATE_DESCENT
+			&& ((*lm)->activation != &gmf_activation_identity || fused_loss_gradient != &gmf_fused_loss_squared))
+		err("COORDINATE_DESCENT requires gmf_activation_identity and gmf_loss_squared.");
+	if ((*lm)->params->model_type == LBFGS
+			&& (fused_loss_gradient == &gmf_fused_loss_absolute || fused_loss_gradient == &gmf_fused_loss_hinge))
+		err("LBFGS requires a smooth loss (e.g. gmf_loss_squared, gmf_loss_huber or gmf_loss_cross_entropy).");
+
 	// begin training
 	switch((*lm)->params->model_type)
 	{
@@ -141,28 +1456,535 @@ void gmf_model_linear_fit(
 			#include "./model_types/linear_model_classic.c"
 			break;
 		case BATCH:
-			#include "./model_types/linear_model_batch.c"
+			if (sparse_sgd)
+			{
+				#include "./model_types/linear_model_sparse_batch.c"
+			}
+			else
+			{
+				#include "./model_types/linear_model_batch.c"
+			}
 			break;
 		case STOCHASTIC:
-			#include "./model_types/linear_model_stochastic.c"
+			// built-in kernels use the allocation free per-sample engine
+			// which updates W inplace (plain SGD only)
+			if (builtin_kernel && (*lm)->optimizer == &gmf_optimizer_sgd)
+			{
+				#include "./model_types/linear_model_sgd.c"
+			}
+			else
+			{
+				#include "./model_types/linear_model_stochastic.c"
+			}
+			break;
+		case HOGWILD:
+			if (!builtin_kernel)
+				err("HOGWILD training only supports the built-in activations and losses.");
+			if ((*lm)->optimizer != &gmf_optimizer_sgd)
+				err("HOGWILD training only supports gmf_optimizer_sgd.");
+			{
+				#include "./model_types/linear_model_sgd.c"
+			}
+			break;
+		case CHOLESKY:
+			#include "./model_types/linear_model_cholesky.c"
+			break;
+		case NEWTON:
+			#include "./model_types/linear_model_newton.c"
+			break;
+		case LBFGS:
+			#include "./model_types/linear_model_lbfgs.c"
+			break;
+		case COORDINATE_DESCENT:
+			#include "./model_types/linear_model_coordinate_descent.c"
 			break;
 	}
 
+	// the outcome is kept on the model, the messages are only printed with verbose
+	// (e.g. OVR fits many submodels in parallel)
+	(*lm)->stopped_early = stop_early || tracker.stopped_early;
+	if (verbose && tracker.stopped_early)
+		printf("NOTE: no improvement in %s after %zu consecutive iterations. Stopped early.\n", tracker.has_best ? "validation loss" : "loss", (*lm)->params->early_stop_iterations);
 	// only display this message if early stopping is not disabled
-	if (!stop_early && (*lm)->params->early_stop_iterations < (*lm)->params->n_iterations)
+	else if (verbose && !stop_early && (*lm)->params->early_stop_iterations < (*lm)->params->n_iterations)
 		printf("WARNING: model may not have converged. Consider increasing iterations or learning rate.\n");
 
-	mat_free(&loss_grad);
+	// keep the weights that did best on the validation data
+	if (tracker.has_best)
+	{
+		memcpy((*lm)->W->data, workspace->best_W, X->n_columns * sizeof(float));
+		if (verbose)
+			printf("Restored weights with the lowest validation loss: %f\n", tracker.best_loss);
+	}
+
+	if (X_decoded)
+		mat_free(&X_decoded);
+	if (!(*lm)->workspace)
+		gmf_model_linear_workspace_free(&workspace);
+}
+
+void gmf_model_linear_fit(
+	LinearModel** lm,
+	const Matrix* X,
+	const Matrix* Y,
+	const bool verbose)
+{
+	const FeatureMatrix features = gmf_features_view(X);
+	__fit(lm, &features, X, Y, verbose);
+}
+
+void gmf_model_linear_fit_features(
+	LinearModel** lm,
+	const FeatureMatrix* X,
+	const Matrix* Y,
+	const bool verbose)
+{
+	__fit(lm, X, NULL, Y, verbose);
+}
+
+// state of partial_fit() created by its first call. W is kept if the columns
+// match (e.g. a warm start from fit()), otherwise it's drawn like fit() does.
+static LinearModelPartialState* __partial_state(LinearModel** lm, const size_t n_columns)
+{
+	if ((*lm)->partial)
+	{
+		if (!(*lm)->W || (*lm)->W->n_rows != n_columns)
+			err("partial_fit() needs the same number of columns in every chunk.");
+		return (*lm)->partial;
+	}
+
+	LinearModelPartialState* partial = malloc(sizeof(LinearModelPartialState));
+	if (!partial)
+		err("Couldn't allocate memory for LinearModelPartialState.");
+	partial->workspace = NULL;
+	partial->n_updates = 0;
+	partial->n_rows_seen = 0;
+	gmf_util_random_seed(&partial->random_state, (*lm)->params->random_seed ? (*lm)->params->random_seed : (uint64_t)rand());
+	if (!(*lm)->W || (*lm)->W->n_rows != n_columns)
+		__init_W(lm, n_columns, &partial->random_state);
+
+	(*lm)->partial = partial;
+
+	return partial;
+}
+
+float gmf_model_linear_partial_fit_features(
+	LinearModel** lm,
+	const FeatureMatrix* X,
+	const Matrix* Y)
+{
+	__check_functions(*lm);
+
+	const LinearModelType model_type = (*lm)->params->model_type;
+	if (model_type != CLASSIC && model_type != BATCH && model_type != STOCHASTIC)
+		err("partial_fit() only supports CLASSIC, BATCH and STOCHASTIC.");
+	if (!gmf_fused_loss_select(*lm) 
+			|| ((*lm)->fused_loss_gradient && (*lm)->fused_loss_gradient != gmf_fused_loss_select(*lm)))
+		err("partial_fit() only supports the built-in activations and losses.");
+	if ((*lm)->regularization && !(*lm)->params->regularization_params)
+		err("LinearModel regularization function missing parameters. Please use gmf_model_..._set_regularization_params().");
+	if (Y->n_rows != X->n_rows)
+		err("partial_fit() needs a label for every row of X.");
+
+	LinearModelPartialState* partial = __partial_state(lm, X->n_columns);
+	const size_t n_rows = X->n_rows;
+	if (n_rows == 0)
+		return 0.0f;
+
+	// set default batch size if one wasn't set (25% of the first chunk)
+	if (model_type == BATCH && (*lm)->params->batch_size == 0)
+		(*lm)->params->batch_size = n_rows >= 4 ? n_rows / 4 : 1;
+
+	// the workspace (and its optimizer state) lives as long as the partial state
+	const size_t chunk_rows = __chunk_rows(X);
+	LinearModelWorkspace* workspace = (*lm)->workspace;
+	if (!workspace && !partial->workspace)
+		partial->workspace = __workspace_init(*lm, n_rows, X->n_columns, chunk_rows);
+	if (!workspace)
+		workspace = partial->workspace;
+	__workspace_reserve(workspace, *lm, n_rows, X->n_columns, chunk_rows);
+
+	// a single pass over the chunk in a random order
+	if (workspace->row_idx)
+		gmf_util_shuffle(&partial->random_state, workspace->row_idx, n_rows);
+
+	// same sparse shortcuts as fit()
+	const bool sparse_sgd = X->type == FEATURES_CSR && (*lm)->optimizer == &gmf_optimizer_sgd;
+	LazyRegularization* lazy = NULL;
+	if (sparse_sgd 
+			&& gmf_regularization_is_proximal((*lm)->regularization)
+			&& (model_type == BATCH || model_type == STOCHASTIC))
+	{
+		lazy = &workspace->lazy_regularization;
+		gmf_regularization_lazy_init(lazy, (*lm)->regularization, (*lm)->params->regularization_params, (*lm)->params->exclude_bias ? 1 : 0, X->n_columns);
+	}
+
+	double loss = 0.0;
+	if (model_type == STOCHASTIC && (*lm)->optimizer == &gmf_optimizer_sgd)
+	{
+		// per-sample engine, the learning rate is updated every check interval like fit()
+		const size_t window = __check_interval((*lm)->params);
+		for (size_t start = 0; start < n_rows; start += window)
+		{
+			const size_t n = start + window <= n_rows ? window : n_rows - start;
+			loss += gmf_fused_loss_sgd(
+					X,
+					Y,
+					*lm,
+					(*lm)->learning_rate_schedule(*lm, partial->n_updates),
+					__residual_regularization(*lm),
+					workspace->row_idx + start,
+					n,
+					n,
+					gmf_regularization_is_proximal((*lm)->regularization),
+					lazy,
+					(*lm)->W->data);
+			partial->n_updates += n;
+		}
+	}
+	else
+	{
+		// CLASSIC takes a single step on the whole chunk, BATCH one per batch_size rows
+		// and STOCHASTIC (with another optimizer) one per row
+		const size_t step_rows = model_type == CLASSIC ? n_rows : workspace->n_sample_rows;
+		Matrix* loss_grad = workspace->loss_gradient;
+		for (size_t start = 0; start < n_rows; start += step_rows)
+		{
+			const size_t n = start + step_rows <= n_rows ? step_rows : n_rows - start;
+			const size_t* rows = workspace->row_idx ? workspace->row_idx + start : NULL;
+			const float learning_rate = (*lm)->learning_rate_schedule(*lm, partial->n_updates++);
+			if (sparse_sgd && model_type == BATCH)
+			{
+				loss += gmf_fused_loss_sgd_batch(
+						X,
+						Y,
+						*lm,
+						learning_rate,
+						__residual_regularization(*lm),
+						rows,
+						n,
+						true,
+						lazy,
+						workspace->Yhat->data,
+						(*lm)->W->data);
+				continue;
+			}
+
+			if (workspace->partial_gradients)
+			{
+				__chunked_loss_gradient(*lm, X, Y, rows, n, true, workspace, &loss_grad);
+				// the reduction leaves the summed loss of the rows in partial_losses[0]
+				loss += workspace->partial_losses[0];
+			}
+			else
+			{
+				memset(loss_grad->data, 0, X->n_columns * sizeof(float));
+				loss += gmf_fused_loss_accumulate(X, Y, *lm, __residual_regularization(*lm), rows, 0, n, true, loss_grad->data);
+			}
+
+			__update_weights(*lm, loss_grad, learning_rate, workspace);
+		}
+	}
+
+	// bring every weight up to date before the chunk is released
+	if (lazy)
+		gmf_regularization_lazy_flush(lazy, (*lm)->W->data);
+	partial->n_rows_seen += n_rows;
+
+	return (float)(loss / (double)n_rows);
+}
+
+void gmf_model_linear_partial_fit(
+	LinearModel** lm,
+	DataIterator* data,
+	const size_t n_epochs,
+	const bool verbose)
+{
+	for (size_t epoch = 0; epoch < n_epochs; ++epoch)
+	{
+		if (epoch > 0)
+		{
+			if (!data->reset)
+				err("partial_fit() needs a DataIterator with reset() for more than one epoch.");
+			data->reset(data->state);
+		}
+
+		const FeatureMatrix* X = NULL;
+		const Matrix* Y = NULL;
+		double loss = 0.0;
+		size_t n_rows = 0;
+		while (data->next(data->state, &X, &Y))
+		{
+			loss += (double)gmf_model_linear_partial_fit_features(lm, X, Y) * (double)X->n_rows;
+			n_rows += X->n_rows;
+		}
+
+		if (verbose)
+			printf("Average loss of epoch %zu: %f (%zu rows)\n", epoch, n_rows > 0 ? loss / (double)n_rows : 0.0, n_rows);
+	}
+}
+
+void gmf_model_linear_fit_path(
+	LinearModel** lm,
+	const Matrix* X,
+	const Matrix* Y,
+	const float* lambdas,
+	const size_t n_lambdas,
+	Matrix** path,
+	const bool verbose)
+{
+	if ((*lm)->params->model_type != COORDINATE_DESCENT)
+		err("gmf_model_linear_fit_path() requires COORDINATE_DESCENT model_type.");
+	__check_functions(*lm);
+	if ((*lm)->activation != &gmf_activation_identity || gmf_fused_loss_select(*lm) != &gmf_fused_loss_squared)
+		err("COORDINATE_DESCENT requires gmf_activation_identity and gmf_loss_squared.");
+	if ((*lm)->regularization != &gmf_regularization_L1 && (*lm)->regularization != &gmf_regularization_elastic_net)
+		err("gmf_model_linear_fit_path() requires gmf_regularization_L1 or gmf_regularization_elastic_net.");
+	if (!(*lm)->params->regularization_params)
+		err("LinearModel regularization function missing parameters. Please use gmf_model_..._set_regularization_params().");
+	if (n_lambdas == 0)
+		err("gmf_model_linear_fit_path() requires at least one lambda.");
+
+	if (!*path)
+		mat_init(path, X->n_columns, n_lambdas);
+	else if ((*path)->n_rows != X->n_columns || (*path)->n_columns != n_lambdas)
+		err("gmf_model_linear_fit_path() path must be (n_columns, n_lambdas).");
+
+	__init_W(lm, X->n_columns, NULL);
+
+	LinearModelWorkspace* workspace = (*lm)->workspace;
+	if (workspace)
+		__workspace_reserve(workspace, *lm, X->n_rows, X->n_columns, GMF_FIT_CHUNK_ROWS);
+	else
+		workspace = __workspace_init(*lm, X->n_rows, X->n_columns, GMF_FIT_CHUNK_ROWS);
+	const FeatureMatrix features = gmf_features_view(X);
+	__cd_prepare(workspace, &features, Y, (*lm)->W->data);
+
+	// fit the unpenalized columns first so the largest lambda accounts for them
+	const size_t first_penalized = (*lm)->params->exclude_bias ? 1 : 0;
+	if (first_penalized > 0)
+		gmf_coordinate_descent_sweep(workspace->cd_X_columns, workspace->cd_column_ptr, workspace->cd_row_idx, X->n_rows, workspace->cd_columns, first_penalized, workspace->cd_column_norms, 0.0, 0.0, first_penalized, workspace->cd_residual, (*lm)->W->data);
+
+	// elastic net with a tiny L1 ratio would need a huge lambda_max
+	float* params = (*lm)->params->regularization_params;
+	double l1_ratio = (*lm)->regularization == &gmf_regularization_L1 ? 1.0 : params[1];
+	l1_ratio = l1_ratio < 0.001 ? 0.001 : l1_ratio;
+	const double lambda_max = gmf_coordinate_descent_l1_max(workspace->cd_X_columns, workspace->cd_column_ptr, workspace->cd_row_idx, X->n_columns, first_penalized, workspace->cd_residual) / l1_ratio;
+
+	for (size_t i = 0; i < n_lambdas; ++i)
+	{
+		if (lambdas)
+			params[0] = lambdas[i];
+		else
+			params[0] = n_lambdas == 1 ? (float)lambda_max : (float)(lambda_max * pow(0.001, (double)i / (double)(n_lambdas - 1)));
+
+		double l1 = 0.0, l2 = 0.0;
+		__cd_penalty(*lm, &l1, &l2);
+		bool converged = __coordinate_descent(*lm, workspace, l1, l2, false);
+
+		size_t n_nonzero = 0;
+		for (size_t c = 0; c < X->n_columns; ++c)
+		{
+			mat_set(path, c, i, (*lm)->W->data[c]);
+			n_nonzero += (*lm)->W->data[c] != 0.0f;
+		}
+
+		if (verbose)
+			printf("Lambda %f: loss %f with %zu non-zero weights\n", params[0], (float)__cd_loss(*lm, workspace, l1, l2), n_nonzero);
+		if (!converged)
+			printf("WARNING: lambda %f may not have converged. Consider increasing iterations.\n", params[0]);
+	}
+
+	if (!(*lm)->workspace)
+		gmf_model_linear_workspace_free(&workspace);
+}
+
+typedef struct predict_args
+{
+	const LinearModel* lm;
+	const FeatureMatrix* X;
+	float* yhat;
+	const size_t* nonzero_columns; // non-NULL if W is sparse
+	const float* nonzero_W; // (n_nonzero) weights of nonzero_columns
+	size_t n_nonzero;
+} predict_args;
+
+// dot product of row r of X with the non-zero weights only
+static float __sparse_dot(
+	const predict_args* args,
+	const size_t r)
+{
+	const FeatureMatrix* X = args->X;
+	float dot = 0.0f;
+	if (X->type == FEATURES_F32)
+	{
+		const float* x = (const float*)X->data + gmf_features_data_row(X, r) * X->n_columns;
+		for (size_t i = 0; i < args->n_nonzero; ++i)
+			dot += x[args->nonzero_columns[i]] * args->nonzero_W[i];
+		return dot;
+	}
+
+	for (size_t i = 0; i < args->n_nonzero; ++i)
+		dot += gmf_features_at(X, r, args->nonzero_columns[i]) * args->nonzero_W[i];
+	return dot;
+}
+
+// predict rows [start, end). buffer holds a decoded (row block, column block)
+// tile for reduced precision features and row views, FEATURES_F32 rows are
+// read straight out of X. A sparse W only reads the columns of its non-zero
+// weights and FEATURES_CSR rows only their non-zero values.
+static void __predict_rows(
+	const predict_args* args,
+	const size_t start,
+	const size_t end,
+	float* buffer)
+{
+	const FeatureMatrix* X = args->X;
+	const size_t n_columns = X->n_columns;
+	const float* W = args->lm->W->data;
+
+	for (size_t row = start; row < end; row += GMF_PREDICT_ROW_BLOCK)
+	{
+		const size_t n_rows = row + GMF_PREDICT_ROW_BLOCK < end ? GMF_PREDICT_ROW_BLOCK : end - row;
+		float* yhat = args->yhat + row;
+		if (X->type == FEATURES_CSR)
+		{
+			for (size_t r = 0; r < n_rows; ++r)
+				yhat[r] = gmf_features_dot(X, row + r, W);
+		}
+		else if (args->nonzero_columns)
+		{
+			for (size_t r = 0; r < n_rows; ++r)
+				yhat[r] = __sparse_dot(args, row + r);
+		}
+		else
+		{
+			for (size_t column = 0; column < n_columns; column += GMF_PREDICT_COLUMN_BLOCK)
+			{
+				const size_t n_block_columns = column + GMF_PREDICT_COLUMN_BLOCK < n_columns ? GMF_PREDICT_COLUMN_BLOCK : n_columns - column;
+				if (X->type == FEATURES_F32 && !X->row_idx)
+				{
+					const float* x = (const float*)X->data + row * n_columns + column;
+					gmf_kernel_gemv(x, n_rows, n_block_columns, n_columns, W + column, yhat, 1, column > 0);
+					continue;
+				}
+
+				for (size_t r = 0; r < n_rows; ++r)
+					gmf_features_row_slice(X, row + r, column, n_block_columns, buffer + r * n_block_columns);
+				gmf_kernel_gemv(buffer, n_rows, n_block_columns, n_block_columns, W + column, yhat, 1, column > 0);
+			}
+		}
+
+		// activation over the (still cached) block through a (n_rows, 1) view
+		Matrix block = { .data = yhat, .n_rows = n_rows, .n_columns = 1 };
+		Matrix* block_ptr = &block;
+		args->lm->activation(&block_ptr, args->lm);
+	}
+}
+
+static float* __predict_buffer(const predict_args* args)
+{
+	const FeatureMatrix* X = args->X;
+	if (X->type == FEATURES_CSR || args->nonzero_columns || (X->type == FEATURES_F32 && !X->row_idx))
+		return NULL;
+
+	float* buffer = malloc(GMF_PREDICT_ROW_BLOCK * GMF_PREDICT_COLUMN_BLOCK * sizeof(float));
+	if (!buffer)
+		err("Couldn't allocate memory for predictions.");
+	return buffer;
+}
+
+static void __predict_task(void* args, size_t task)
+{
+	const predict_args* p_args = args;
+	const size_t n_rows = p_args->X->n_rows;
+	const size_t start = task * GMF_PREDICT_TASK_ROWS;
+	const size_t end = start + GMF_PREDICT_TASK_ROWS < n_rows ? start + GMF_PREDICT_TASK_ROWS : n_rows;
+
+	float* buffer = __predict_buffer(p_args);
+	__predict_rows(p_args, start, end, buffer);
+	free(buffer);
+}
+
+void gmf_model_linear_predict_batch(
+	const LinearModel* lm,
+	const FeatureMatrix* X,
+	float* yhat,
+	ThreadPool* thread_pool)
+{
+	if (!lm->W)
+		err("Model must be fit before making predictions.");
+	if (X->n_columns != lm->W->n_rows)
+		err("X must have the same number of columns as the training data.");
+
+	predict_args args = {
+		.lm = lm,
+		.X = X,
+		.yhat = yhat,
+		.nonzero_columns = NULL,
+		.nonzero_W = NULL,
+		.n_nonzero = 0
+	};
+
+	// collect the non-zero weights once, a sparse W (e.g. after L1)
+	// only has to read a few columns of every row
+	const size_t n_columns = X->n_columns;
+	size_t n_nonzero = 0;
+	for (size_t c = 0; c < n_columns; ++c)
+		n_nonzero += lm->W->data[c] != 0.0f;
+
+	size_t* nonzero_columns = NULL;
+	float* nonzero_W = NULL;
+	if (X->type != FEATURES_CSR && n_nonzero * GMF_PREDICT_SPARSE_RATIO <= n_columns)
+	{
+		nonzero_columns = malloc((n_nonzero + 1) * sizeof(size_t));
+		nonzero_W = malloc((n_nonzero + 1) * sizeof(float));
+		if (!nonzero_columns || !nonzero_W)
+			err("Couldn't allocate memory for predictions.");
+
+		for (size_t c = 0; c < n_columns; ++c)
+			if (lm->W->data[c] != 0.0f)
+			{
+				nonzero_columns[args.n_nonzero] = c;
+				nonzero_W[args.n_nonzero++] = lm->W->data[c];
+			}
+		args.nonzero_columns = nonzero_columns;
+		args.nonzero_W = nonzero_W;
+	}
+
+	const size_t n_tasks = (X->n_rows + GMF_PREDICT_TASK_ROWS - 1) / GMF_PREDICT_TASK_ROWS;
+	if (thread_pool && n_tasks > 1)
+		gmf_util_thread_pool_run(thread_pool, n_tasks, &__predict_task, &args);
+	else
+	{
+		float* buffer = __predict_buffer(&args);
+		__predict_rows(&args, 0, X->n_rows, buffer);
+		free(buffer);
+	}
 
+	free(nonzero_columns);
+	free(nonzero_W);
 }
 
 Matrix* gmf_model_linear_predict(
 	const LinearModel* lm,
 	const Matrix* X)
 {
-	Matrix* Yhat = mat_multiply(X, lm->W);
-	lm->activation(&Yhat, lm);
-	
+	Matrix* Yhat = NULL;
+	mat_init(&Yhat, X->n_rows, 1);
+	gmf_model_linear_predict_inplace(lm, X, &Yhat);
+
+	return Yhat;
+}
+
+Matrix* gmf_model_linear_predict_features(
+	const LinearModel* lm,
+	const FeatureMatrix* X)
+{
+	Matrix* Yhat = NULL;
+	mat_init(&Yhat, X->n_rows, 1);
+	gmf_model_linear_predict_batch(lm, X, Yhat->data, NULL);
+
 	return Yhat;
 }
 
@@ -171,8 +1993,16 @@ void gmf_model_linear_predict_inplace(
 	const Matrix* X,
 		Matrix** Yhat)
 {
-	mat_multiply_inplace(X, lm->W, Yhat);
-	lm->activation(Yhat, lm);
+	// the batch engine writes X->n_rows floats straight into Yhat
+	if (!lm->W)
+		err("Model must be fit before making predictions.");
+	if (X->n_columns != lm->W->n_rows)
+		err("X must have the same number of columns as the training data.");
+	if (!*Yhat || (*Yhat)->n_rows != X->n_rows || (*Yhat)->n_columns != 1)
+		err("Yhat must be an (n_rows, 1) matrix to hold the predictions of X.");
+
+	FeatureMatrix features = gmf_features_view(X);
+	gmf_model_linear_predict_batch(lm, &features, (*Yhat)->data, NULL);
 }
 
 void gmf_model_linear_free(
@@ -180,6 +2010,7 @@ void gmf_model_linear_free(
 {
 	if ((*lm)->W)
 		mat_free(&(*lm)->W);
+	__partial_free(*lm);
 	
 	if ((*lm)->params->regularization_params)
 	{
@@ -192,6 +2023,13 @@ void gmf_model_linear_free(
 	*lm = NULL;
 }
 
+void gmf_model_linear_set_workspace(
+	LinearModel** lm,
+	LinearModelWorkspace* workspace)
+{
+	(*lm)->workspace = workspace;
+}
+
 void gmf_model_linear_set_iterations(
 	LinearModel** lm,
 	const size_t n_iterations)
@@ -234,6 +2072,38 @@ void gmf_model_linear_set_batch_size(
 	(*lm)->params->batch_size = batch_size;
 }
 
+void gmf_model_linear_set_threads(
+	LinearModel** lm,
+	const size_t n_threads)
+{
+	(*lm)->params->n_threads = n_threads;
+}
+
+void gmf_model_linear_set_loss_check_interval(
+	LinearModel** lm,
+	const size_t loss_check_interval)
+{
+	(*lm)->params->loss_check_interval = loss_check_interval;
+}
+
+void gmf_model_linear_set_validation(
+	LinearModel** lm,
+	const Matrix* validation_X,
+	const Matrix* validation_Y)
+{
+	if ((validation_X == NULL) != (validation_Y == NULL))
+		err("LinearModel validation data requires both validation_X and validation_Y (or neither).");
+	(*lm)->validation_X = validation_X;
+	(*lm)->validation_Y = validation_Y;
+}
+
+void gmf_model_linear_set_validation_sample_size(
+	LinearModel** lm,
+	const size_t validation_sample_size)
+{
+	(*lm)->params->validation_sample_size = validation_sample_size;
+}
+
 void gmf_model_linear_set_activation(
 	LinearModel** lm,
 	void (*activation)(Matrix**, const LinearModel*))
@@ -277,11 +2147,99 @@ void gmf_model_linear_set_regularization_params(
 	void* alloc = calloc(n, sizeof(float));
 	if (!alloc)
 		err("Couldn't allocate memory when setting regularization parameters.");
+	// parameters may be set more than once
+	free((*lm)->params->regularization_params);
 	(*lm)->params->regularization_params = alloc;
 	for (size_t i = 0; i < n; ++i)
 		(*lm)->params->regularization_params[i] = regularization_params[i];
 }
 
+void gmf_model_linear_set_fused_loss_gradient(
+	LinearModel** lm,
+	float (*fused_loss_gradient)(const Matrix*, const Matrix*, const LinearModel*, Matrix**))
+{
+	(*lm)->fused_loss_gradient = fused_loss_gradient;
+}
+
+void gmf_model_linear_set_optimizer(
+	LinearModel** lm,
+	void (*optimizer)(Matrix**, const Matrix*, const float, const LinearModel*, LinearModelOptimizerState*))
+{
+	(*lm)->optimizer = optimizer;
+}
+
+void gmf_model_linear_set_learning_rate_schedule(
+	LinearModel** lm,
+	float (*learning_rate_schedule)(const LinearModel*, const size_t))
+{
+	(*lm)->learning_rate_schedule = learning_rate_schedule;
+}
+
+void gmf_model_linear_set_momentum(
+	LinearModel** lm,
+	const float momentum)
+{
+	(*lm)->params->momentum = momentum;
+}
+
+void gmf_model_linear_set_beta1(
+	LinearModel** lm,
+	const float beta1)
+{
+	(*lm)->params->beta1 = beta1;
+}
+
+void gmf_model_linear_set_beta2(
+	LinearModel** lm,
+	const float beta2)
+{
+	(*lm)->params->beta2 = beta2;
+}
+
+void gmf_model_linear_set_epsilon(
+	LinearModel** lm,
+	const float epsilon)
+{
+	(*lm)->params->epsilon = epsilon;
+}
+
+void gmf_model_linear_set_step_decay(
+	LinearModel** lm,
+	const float decay_rate,
+	const size_t decay_steps)
+{
+	(*lm)->params->decay_rate = decay_rate;
+	(*lm)->params->decay_steps = decay_steps;
+}
+
+void gmf_model_linear_set_min_learning_rate(
+	LinearModel** lm,
+	const float min_learning_rate)
+{
+	(*lm)->params->min_learning_rate = min_learning_rate;
+}
+
+void gmf_model_linear_set_lbfgs_history(
+	LinearModel** lm,
+	const size_t lbfgs_history)
+{
+	(*lm)->params->lbfgs_history = lbfgs_history;
+}
+
+void gmf_model_linear_set_exclude_bias(
+	LinearModel** lm,
+	const bool exclude_bias)
+{
+	(*lm)->params->exclude_bias = exclude_bias;
+}
+
+void gmf_model_linear_set_random_seed(
+	LinearModel** lm,
+	const uint64_t random_seed)
+{
+	(*lm)->params->random_seed = random_seed;
+}
+
 void gmf_model_linear_set_huber_delta(
 		LinearModel** lm,
 		const float huber_delta)
@@ -1,39 +1,49 @@
+#include <string.h>
+
 #include "linear_model.h"
 #include "linear_model_ovr.h"
+#include "kernels.h"
 #include "matrix.h"
 #include "vector.h"
 #include "gmf_util.h"
 
+// blocking of predict(). The scores of a block of rows for every model
+// stay in cache while their votes are tallied; blocks of the inner
+// dimension keep the rows of X that are being multiplied in L1.
+#define GMF_OVR_PREDICT_ROW_BLOCK 64
+#define GMF_OVR_PREDICT_INNER_BLOCK 256
+
 static void err(const char* msg)
 {
 	printf("%s\n", msg);
 	exit(-1);
 }
 
-static size_t __factorial(size_t n)
-{
-	size_t result = n;
-	for (n = result - 1; n > 0; --n)
-		result *= n;
-	return result;
-}
-
-static size_t __calculate_required_models(const size_t n_classes)
+static size_t __calculate_required_models(const size_t n_classes, const OVRStrategy strategy)
 {
 	if (n_classes < 2)
 		err("Must have at least two classes to use OVR model.\n");
-	// n choose r
-	// n_classes choose 2
-	// n_classes! / (2*(n_classes - 2)!)
-	return __factorial(n_classes) / (2 * __factorial(n_classes - 2)); 
+	if (strategy == OVR_ONE_VS_REST)
+		return n_classes;
+	// n_classes choose 2 (one of n_classes and n_classes - 1 is even)
+	return n_classes % 2 == 0 ? (n_classes / 2) * (n_classes - 1) : n_classes * ((n_classes - 1) / 2);
 }
 
 static void __compute_class_pairs(
 		size_t (**class_pairs)[2], 
 		const size_t n_models,
-		const size_t n_classes)
+		const size_t n_classes,
+		const OVRStrategy strategy)
 {
-	
+	if (strategy == OVR_ONE_VS_REST)
+	{
+		for (size_t model = 0; model < n_models; ++model)
+		{
+			(*class_pairs)[model][0] = model;
+			(*class_pairs)[model][1] = model;
+		}
+		return;
+	}
 
 	size_t model = 0;
 	size_t x = 0, y = 1;
@@ -55,15 +65,36 @@ void gmf_model_linear_ovr_init_inplace(
 	LinearModelOVR** lm,
 	const size_t n_classes,
 	const float* class_weights)
+{
+	gmf_model_linear_ovr_init_strategy_inplace(lm, n_classes, class_weights, OVR_ONE_VS_ONE);
+}
+
+LinearModelOVR* gmf_model_linear_ovr_init(
+		const size_t n_classes,
+		const float* class_weights)
+{
+	return gmf_model_linear_ovr_init_strategy(n_classes, class_weights, OVR_ONE_VS_ONE);
+}
+
+void gmf_model_linear_ovr_init_strategy_inplace(
+	LinearModelOVR** lm,
+	const size_t n_classes,
+	const float* class_weights,
+	const OVRStrategy strategy)
 {
 	void* alloc = malloc(sizeof(LinearModelOVR));
 	if (!alloc)
 		err("Couldn't allocate memory for LinearModelOVR.");
 	*lm = alloc;
 	(*lm)->n_classes = n_classes;
+	(*lm)->strategy = strategy;
+	(*lm)->n_model_threads = 1;
+	(*lm)->random_seed = 0;
+	(*lm)->W = NULL;
+	(*lm)->binary_weights = NULL;
 
 	// calculate total number of models requred given n_classes
-	size_t n_models = __calculate_required_models(n_classes);
+	size_t n_models = __calculate_required_models(n_classes, strategy);
 	(*lm)->n_models = n_models;
 
 	if (!class_weights)
@@ -85,7 +116,7 @@ void gmf_model_linear_ovr_init_inplace(
 	if (!alloc)
 		err("Couldn't allocate memory for LinearModelOVR.");
 	(*lm)->class_pairs = alloc;
-	__compute_class_pairs(&(*lm)->class_pairs, n_models, n_classes);
+	__compute_class_pairs(&(*lm)->class_pairs, n_models, n_classes, strategy);
 
 	// allocate memory for all linear models
 	alloc = malloc(n_models * sizeof(LinearModel));
@@ -101,152 +132,526 @@ void gmf_model_linear_ovr_init_inplace(
 	}
 }
 
-LinearModelOVR* gmf_model_linear_ovr_init(
+LinearModelOVR* gmf_model_linear_ovr_init_strategy(
 		const size_t n_classes,
-		const float* class_weights)
+		const float* class_weights,
+		const OVRStrategy strategy)
 {
 	LinearModelOVR* lm = NULL;
-	gmf_model_linear_ovr_init_inplace(&lm, n_classes, class_weights);
+	gmf_model_linear_ovr_init_strategy_inplace(&lm, n_classes, class_weights, strategy);
 
 	return lm;
 }
 
-static bool __filter_class(const Vector* row, float* args)
+// number of rows of every class
+static size_t* __class_counts(const Matrix* Y, const size_t n_classes)
 {
-	return fabsf(vec_at(row, 0) - args[0]) < 0.001f || fabsf(vec_at(row, 0) - args[1]) < 0.001f;
-}
-
-static float* __compute_class_weights(const Matrix* Y, const size_t n_classes)
-{
-	size_t* class_counts = NULL;
 	void* alloc = calloc(n_classes, sizeof(size_t));
 	if (!alloc)
 		err("Couldn't allocate memory for computing class weights.");
-	class_counts = alloc;
+	size_t* class_counts = alloc;
+
+	for (size_t r = 0; r < Y->n_rows; ++r)
+	{
+		const float label = mat_at(Y, r, 0);
+		if (label < 0.0f || (size_t)label >= n_classes)
+			err("LinearModelOVR labels must be in {0, 1, ..., n_classes - 1}.");
+		class_counts[(size_t)label]++;
+	}
+
+	return class_counts;
+}
+
+// rows of every class, built once per fit(): the rows of class c are
+// class_rows[class_offsets[c] : class_offsets[c + 1]] in their original order
+typedef struct class_index
+{
+	size_t* class_offsets; // (n_classes + 1)
+	size_t* class_rows; // (n_rows)
+} class_index;
+
+static class_index __class_index(const Matrix* Y, const size_t* class_counts, const size_t n_classes)
+{
+	class_index index;
+	index.class_offsets = malloc((n_classes + 1) * sizeof(size_t));
+	index.class_rows = malloc(Y->n_rows * sizeof(size_t));
+	if (!index.class_offsets || !index.class_rows)
+		err("Couldn't allocate memory for LinearModelOVR.");
+
+	index.class_offsets[0] = 0;
+	for (size_t c = 0; c < n_classes; ++c)
+		index.class_offsets[c + 1] = index.class_offsets[c] + class_counts[c];
 
+	// counting sort, so a pass over Y places every row
+	size_t* next = malloc(n_classes * sizeof(size_t));
+	if (!next)
+		err("Couldn't allocate memory for LinearModelOVR.");
+	memcpy(next, index.class_offsets, n_classes * sizeof(size_t));
 	for (size_t r = 0; r < Y->n_rows; ++r)
-		class_counts[(size_t)mat_at(Y, r, 0)]++;
+		index.class_rows[next[(size_t)mat_at(Y, r, 0)]++] = r;
+	free(next);
+
+	return index;
+}
 
+static float* __compute_class_weights(const size_t* class_counts, const size_t n_rows, const size_t n_classes)
+{
 	float* class_weights = NULL;
-	alloc = calloc(n_classes, sizeof(float));
+	void* alloc = calloc(n_classes, sizeof(float));
 	if (!alloc)
 		err("Couldn't allocate memory for computing class weights.");
 	class_weights = alloc;
 
 	// class weight = N / (n_classes * class_count)
 	for (size_t c = 0; c < n_classes; ++c)
-		class_weights[c] = (float)Y->n_rows / (float)(n_classes * class_counts[c]);
-
-	free(class_counts);
-	class_counts = NULL;
+		class_weights[c] = (float)n_rows / (float)(n_classes * class_counts[c]);
 
 	return class_weights;
 }
 
+// [rest, class] weights of every OVR_ONE_VS_REST submodel: the class keeps
+// its own weight and the rest gets the average weight of its rows, so the
+// rows of every class weigh the same as they would in a single model
+static void __compute_binary_weights(LinearModelOVR* lm, const size_t* class_counts, const size_t n_rows)
+{
+	if (!lm->binary_weights)
+	{
+		lm->binary_weights = malloc(lm->n_models * sizeof(*lm->binary_weights));
+		if (!lm->binary_weights)
+			err("Couldn't allocate memory for LinearModelOVR.");
+	}
+
+	double total_weight = 0.0;
+	for (size_t c = 0; c < lm->n_classes; ++c)
+		total_weight += (double)class_counts[c] * lm->class_weights[c];
+
+	for (size_t m = 0; m < lm->n_models; ++m)
+	{
+		const size_t n_rest = n_rows - class_counts[m];
+		const double rest_weight = total_weight - (double)class_counts[m] * lm->class_weights[m];
+		lm->binary_weights[m][0] = n_rest > 0 ? (float)(rest_weight / (double)n_rest) : 1.0f;
+		lm->binary_weights[m][1] = lm->class_weights[m];
+	}
+}
+
+// labels of the rows are [0, 1] for every binary submodel
+static size_t __binary_pair[2] = { 0, 1 };
+
+// number of rows submodel m is trained on
+static size_t __model_rows(const LinearModelOVR* lm, const size_t* class_counts, const size_t n_rows, const size_t model)
+{
+	if (lm->strategy == OVR_ONE_VS_REST)
+		return n_rows;
+	return class_counts[lm->class_pairs[model][0]] + class_counts[lm->class_pairs[model][1]];
+}
+
+// fit a regular linear model on the rows of a submodel through a row view
+// of X: the rows labeled 0 (the first class of the pair or every other class
+// for OVR_ONE_VS_REST) followed by the rows labeled 1 (the second class of the
+// pair or the class of the submodel). labels holds n_rows zeros followed by
+// max_class_count ones so the labels are a view into it, nothing else is copied.
+// The submodel trains with random_seed set to seed (restored afterwards).
+// If losses isn't NULL the submodel continues training on the rows with
+// gmf_model_linear_partial_fit_features() and its loss is stored in losses[model].
+static void __fit_model(
+		LinearModelOVR* lm,
+		const FeatureMatrix* X,
+		const class_index* index,
+		const float* labels,
+		const size_t model,
+		const uint64_t seed,
+		float* losses,
+		const bool verbose)
+{
+	const size_t* class_pair = lm->class_pairs[model];
+	const size_t* offsets = index->class_offsets;
+	const size_t n_rows = X->n_rows;
+	const size_t positive = class_pair[1];
+	const size_t n_positive = offsets[positive + 1] - offsets[positive];
+	const size_t n_negative = lm->strategy == OVR_ONE_VS_REST
+		? n_rows - n_positive
+		: offsets[class_pair[0] + 1] - offsets[class_pair[0]];
+
+	size_t* model_rows = malloc((n_negative + n_positive) * sizeof(size_t));
+	if (!model_rows)
+		err("Couldn't allocate memory for LinearModelOVR.");
+	if (lm->strategy == OVR_ONE_VS_REST)
+	{
+		// the classes before and after the positive one
+		memcpy(model_rows, index->class_rows, offsets[positive] * sizeof(size_t));
+		memcpy(model_rows + offsets[positive], index->class_rows + offsets[positive + 1], (n_rows - offsets[positive + 1]) * sizeof(size_t));
+	}
+	else
+		memcpy(model_rows, index->class_rows + offsets[class_pair[0]], n_negative * sizeof(size_t));
+	memcpy(model_rows + n_negative, index->class_rows + offsets[positive], n_positive * sizeof(size_t));
+
+	// a view of a view (e.g. a partial_fit() chunk) indexes the data directly
+	FeatureMatrix X_data = *X;
+	if (X->row_idx)
+	{
+		for (size_t i = 0; i < n_negative + n_positive; ++i)
+			model_rows[i] = X->row_idx[model_rows[i]];
+		X_data.row_idx = NULL;
+	}
+
+	const FeatureMatrix X_model = gmf_features_rows(&X_data, model_rows, n_negative + n_positive);
+	const Matrix Y_model = {
+		.data = (float*)labels + (n_rows - n_negative), // never written
+		.n_rows = n_negative + n_positive,
+		.n_columns = 1
+	};
+
+	LinearModelParams* params = lm->models[model]->params;
+	const uint64_t random_seed = params->random_seed;
+	params->random_seed = seed;
+	if (losses)
+		losses[model] = gmf_model_linear_partial_fit_features(&lm->models[model], &X_model, &Y_model);
+	else
+		gmf_model_linear_fit_features(&lm->models[model], &X_model, &Y_model, verbose);
+	params->random_seed = random_seed;
+
+	free(model_rows);
+}
+
+typedef struct ovr_fit_args
+{
+	LinearModelOVR* lm;
+	const FeatureMatrix* X;
+	const class_index* index;
+	const float* labels;
+	const size_t* order; // models from the largest to the smallest subset
+	const uint64_t* seeds; // (n_models) one random stream per model
+	float* losses; // (n_models) partial_fit() only, NULL for fit()
+	bool verbose;
+} ovr_fit_args;
+
+static void __fit_task(void* args, size_t task)
+{
+	ovr_fit_args* f_args = args;
+	const size_t model = f_args->order[task];
+	__fit_model(f_args->lm, f_args->X, f_args->index, f_args->labels, model, f_args->seeds[model], f_args->losses, f_args->verbose);
+}
+
+typedef struct model_size
+{
+	size_t model;
+	size_t n_rows;
+} model_size;
+
+// largest subset first, ties by model index so the order is deterministic
+static int __compare_model_size(const void* a, const void* b)
+{
+	const model_size* left = a;
+	const model_size* right = b;
+	if (left->n_rows != right->n_rows)
+		return left->n_rows > right->n_rows ? -1 : 1;
+	return left->model < right->model ? -1 : (left->model > right->model);
+}
+
+// train every submodel on its rows of X (fit() or partial_fit(), see __fit_model())
+static void __fit_models(
+		LinearModelOVR* lm,
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const size_t* class_counts,
+		float* losses,
+		const bool verbose)
+{
+	const size_t n_models = lm->n_models;
+
+	// models will share the same pointer to save memory. OVR_ONE_VS_REST
+	// models have their own [rest, class] weights instead
+	if (lm->strategy == OVR_ONE_VS_REST)
+	{
+		if (lm->class_weights)
+			__compute_binary_weights(lm, class_counts, Y->n_rows);
+		for (size_t m = 0; m < n_models; ++m)
+		{
+			lm->models[m]->params->class_weights = lm->class_weights ? lm->binary_weights[m] : NULL;
+			lm->models[m]->params->class_pair = __binary_pair;
+		}
+	}
+	else
+	{
+		for (size_t m = 0; m < n_models; ++m)
+		{
+			lm->models[m]->params->class_weights = lm->class_weights;
+			lm->models[m]->params->class_pair = lm->class_pairs[m];
+		}
+	}
+
+	// every model gets its own random stream, drawn up front in model order
+	// (from random_seed if one was set) so the results don't depend on which
+	// thread trains which model
+	uint64_t* seeds = malloc(n_models * sizeof(uint64_t));
+	model_size* sizes = malloc(n_models * sizeof(model_size));
+	size_t* order = malloc(n_models * sizeof(size_t));
+	if (!seeds || !sizes || !order)
+		err("Couldn't allocate memory for LinearModelOVR.");
+
+	RandomState random_state;
+	gmf_util_random_seed(&random_state, lm->random_seed ? lm->random_seed : (uint64_t)rand());
+	for (size_t m = 0; m < n_models; ++m)
+	{
+		seeds[m] = gmf_util_random_next(&random_state) | 1; // never 0 (no seed)
+		sizes[m].model = m;
+		sizes[m].n_rows = __model_rows(lm, class_counts, Y->n_rows, m);
+	}
+
+	// longest processing time first: handing out the largest subsets
+	// first keeps the threads busy until the end
+	qsort(sizes, n_models, sizeof(model_size), &__compare_model_size);
+	for (size_t m = 0; m < n_models; ++m)
+		order[m] = sizes[m].model;
+
+	// partition the rows by class once, every model trains on a view of them
+	const class_index index = __class_index(Y, class_counts, lm->n_classes);
+	size_t max_class_count = 0;
+	for (size_t c = 0; c < lm->n_classes; ++c)
+		if (class_counts[c] > max_class_count)
+			max_class_count = class_counts[c];
+
+	// n_rows zeros followed by max_class_count ones, see __fit_model()
+	float* labels = malloc((Y->n_rows + max_class_count) * sizeof(float));
+	if (!labels)
+		err("Couldn't allocate memory for LinearModelOVR.");
+	for (size_t i = 0; i < Y->n_rows; ++i)
+		labels[i] = 0.0f;
+	for (size_t i = 0; i < max_class_count; ++i)
+		labels[Y->n_rows + i] = 1.0f;
+
+	ovr_fit_args args = {
+		.lm = lm,
+		.X = X,
+		.index = &index,
+		.labels = labels,
+		.order = order,
+		.seeds = seeds,
+		.losses = losses,
+		.verbose = verbose
+	};
+
+	if (lm->n_model_threads > 1 && n_models > 1)
+	{
+		ThreadPool* thread_pool = gmf_util_thread_pool_init(lm->n_model_threads);
+		gmf_util_thread_pool_run(thread_pool, n_models, &__fit_task, &args);
+		gmf_util_thread_pool_free(&thread_pool);
+	}
+	else
+		for (size_t task = 0; task < n_models; ++task)
+			__fit_task(&args, task);
+
+	free(index.class_offsets);
+	free(index.class_rows);
+	free(labels);
+	free(seeds);
+	free(sizes);
+	free(order);
+}
+
 void gmf_model_linear_ovr_fit(
 		LinearModelOVR** lm,
 		const Matrix* X,
 		const Matrix* Y,
 		const bool verbose)
 {
+	size_t* class_counts = __class_counts(Y, (*lm)->n_classes);
 	
 	// compute class weights if they aren't specified
 	if ((*lm)->class_weights == NULL)
-		(*lm)->class_weights = __compute_class_weights(Y, (*lm)->n_classes);
+		(*lm)->class_weights = __compute_class_weights(class_counts, Y->n_rows, (*lm)->n_classes);
 
-	// models will share the same pointer to save memory
+	const FeatureMatrix features = gmf_features_view(X);
+	__fit_models(*lm, &features, Y, class_counts, NULL, verbose);
+	gmf_model_linear_ovr_pack_weights(lm);
+
+	free(class_counts);
+}
+
+float gmf_model_linear_ovr_partial_fit_features(
+		LinearModelOVR** lm,
+		const FeatureMatrix* X,
+		const Matrix* Y)
+{
+	if (Y->n_rows != X->n_rows)
+		err("partial_fit() needs a label for every row of X.");
+
+	// a chunk is too small a sample to derive balanced class weights from,
+	// so the submodels are unweighted unless class_weights were given
+	size_t* class_counts = __class_counts(Y, (*lm)->n_classes);
+	float* losses = malloc((*lm)->n_models * sizeof(float));
+	if (!losses)
+		err("Couldn't allocate memory for LinearModelOVR.");
+
+	__fit_models(*lm, X, Y, class_counts, losses, false);
+	gmf_model_linear_ovr_pack_weights(lm);
+
+	// every submodel weighs by the rows it was trained on
+	double loss = 0.0;
+	size_t n_rows = 0;
 	for (size_t m = 0; m < (*lm)->n_models; ++m)
 	{
-		(*lm)->models[m]->params->class_weights = (*lm)->class_weights;
-		(*lm)->models[m]->params->class_pair = (*lm)->class_pairs[m];
+		const size_t model_rows = __model_rows(*lm, class_counts, Y->n_rows, m);
+		loss += (double)losses[m] * (double)model_rows;
+		n_rows += model_rows;
 	}
 
-	// iterate over different class pairs, filter
-	// the correct data, convert to [0, 1] and fit a regular linear model
-	
-	size_t* filtered_idx = NULL;
-	for (size_t model = 0; model < (*lm)->n_models; ++model)
-	{
-		size_t* class_pair = (*lm)->class_pairs[model];
-		float class_pair_f[2] = { (float)class_pair[0], (float)class_pair[1] };
-		Matrix* Y_filtered = mat_filter(Y, &__filter_class, class_pair_f, &filtered_idx);
-		Matrix* X_filtered = mat_subset_idx(X, filtered_idx, Y_filtered->n_rows);
+	free(class_counts);
+	free(losses);
 
-		free(filtered_idx);
-		filtered_idx = NULL;
+	return n_rows > 0 ? (float)(loss / (double)n_rows) : 0.0f;
+}
 
-		for (size_t r = 0; r < Y_filtered->n_rows; ++r)
+void gmf_model_linear_ovr_partial_fit(
+		LinearModelOVR** lm,
+		DataIterator* data,
+		const size_t n_epochs,
+		const bool verbose)
+{
+	for (size_t epoch = 0; epoch < n_epochs; ++epoch)
+	{
+		if (epoch > 0)
 		{
-			if (fabsf(mat_at(Y_filtered, r, 0) - class_pair_f[0]) < 0.001f)
-				mat_set(&Y_filtered, r, 0, 0.0f);
-			else
-				mat_set(&Y_filtered, r, 0, 1.0f);
+			if (!data->reset)
+				err("partial_fit() needs a DataIterator with reset() for more than one epoch.");
+			data->reset(data->state);
 		}
 
-		gmf_model_linear_fit(&(*lm)->models[model], X_filtered, Y_filtered, verbose);
+		const FeatureMatrix* X = NULL;
+		const Matrix* Y = NULL;
+		double loss = 0.0;
+		size_t n_rows = 0;
+		while (data->next(data->state, &X, &Y))
+		{
+			loss += (double)gmf_model_linear_ovr_partial_fit_features(lm, X, Y) * (double)X->n_rows;
+			n_rows += X->n_rows;
+		}
 
-		mat_free(&X_filtered);
-		mat_free(&Y_filtered);
+		if (verbose)
+			printf("Average loss of epoch %zu: %f (%zu rows)\n", epoch, n_rows > 0 ? loss / (double)n_rows : 0.0, n_rows);
 	}
 }
 
-static float __set_classes(float x, float* args)
+void gmf_model_linear_ovr_pack_weights(
+	LinearModelOVR** lm)
 {
-	if (x < args[2])
-		return args[0];
-	return args[1];
+	const size_t n_models = (*lm)->n_models;
+	const Matrix* first = (*lm)->models[0]->W;
+	if (!first)
+		err("Model must be fit before packing weights.");
+
+	const size_t n_columns = first->n_rows;
+	if ((*lm)->W && (*lm)->W->n_rows != n_columns)
+		mat_free(&(*lm)->W);
+	if (!(*lm)->W)
+		mat_init(&(*lm)->W, n_columns, n_models);
+
+	float* W = (*lm)->W->data;
+	for (size_t m = 0; m < n_models; ++m)
+	{
+		const Matrix* W_model = (*lm)->models[m]->W;
+		if (!W_model || W_model->n_rows != n_columns)
+			err("Every LinearModelOVR submodel must be fit on the same columns.");
+		for (size_t c = 0; c < n_columns; ++c)
+			W[c * n_models + m] = W_model->data[c];
+	}
 }
 
-Matrix* gmf_model_linear_ovr_predict(
-		const LinearModelOVR* lm,
-		const Matrix* X)
+// every model votes for one class of its pair for each of the n_rows rows of
+// the row-major (n_rows, n_models) scores. column is a buffer of n_rows floats
+// so the activation of a model can run over its scores as a (n_rows, 1) view.
+static void __tally_votes(
+	const LinearModelOVR* lm,
+	const float* scores,
+	const size_t n_rows,
+	float* column,
+	uint32_t* votes)
 {
+	const size_t n_models = lm->n_models;
+	const size_t n_classes = lm->n_classes;
+	memset(votes, 0, n_rows * n_classes * sizeof(uint32_t));
 
-	Matrix* predicted_labels = NULL;
-	mat_init(&predicted_labels, lm->n_models, X->n_rows);
-
-	for (size_t model = 0; model < lm->n_models; ++model)
+	for (size_t m = 0; m < n_models; ++m)
 	{
-		Matrix* Yhat = gmf_model_linear_predict(lm->models[model], X); 
-		float class_pairs[3] = { 
-			(float)lm->class_pairs[model][0], 
-			(float)lm->class_pairs[model][1], 
-			lm->models[model]->params->sigmoid_threshold 
-		};
-		mat_apply(&Yhat, &__set_classes, class_pairs);
-		for (size_t r = 0; r < Yhat->n_rows; ++r)
-			mat_set(&predicted_labels, model, r, mat_at(Yhat, r, 0));
-		mat_free(&Yhat);
+		const LinearModel* model = lm->models[m];
+		for (size_t r = 0; r < n_rows; ++r)
+			column[r] = scores[r * n_models + m];
+
+		Matrix block = { .data = column, .n_rows = n_rows, .n_columns = 1 };
+		Matrix* block_ptr = &block;
+		model->activation(&block_ptr, model);
+
+		const float threshold = model->params->sigmoid_threshold;
+		const size_t first_class = lm->class_pairs[m][0];
+		const size_t second_class = lm->class_pairs[m][1];
+		for (size_t r = 0; r < n_rows; ++r)
+			votes[r * n_classes + (column[r] < threshold ? first_class : second_class)]++;
 	}
+}
 
-	Matrix* Yhat = NULL;
-	mat_init(&Yhat, X->n_rows, 1);
-
-	void* alloc = calloc(lm->n_classes, sizeof(float));
-	if (!alloc)
-		err("Couldn't allocate memory for LinearModelOVR predictions.");
-	float* class_lookup_table = alloc;
-	for (size_t r = 0; r < X->n_rows; ++r)
+// OVR_ONE_VS_REST: class of the model with the highest activation for each of
+// the n_rows rows of the row-major (n_rows, n_models) scores. A hard sigmoid
+// is compared before thresholding, otherwise most models would tie at 0 or 1.
+// The lowest class wins a tie.
+static void __highest_score(
+	const LinearModelOVR* lm,
+	const float* scores,
+	const size_t n_rows,
+	float* column,
+	float* best_scores,
+	float* yhat)
+{
+	const size_t n_models = lm->n_models;
+	for (size_t m = 0; m < n_models; ++m)
 	{
-		// reset lookup table
-		for (size_t i = 0; i < lm->n_classes; ++i)
-			class_lookup_table[i] = 0.0f;
-
-		for (size_t m = 0; m < lm->n_models; ++m)
-			class_lookup_table[(size_t)mat_at(predicted_labels, m, r)] += 1.0f;
-
-		float frequent_class = -1.0f;
-		for (size_t c = 0; c < lm->n_classes; ++c)
-			if (class_lookup_table[c] > class_lookup_table[(size_t)frequent_class])
-				frequent_class = (float)c;
+		const LinearModel* model = lm->models[m];
+		for (size_t r = 0; r < n_rows; ++r)
+			column[r] = scores[r * n_models + m];
+
+		Matrix block = { .data = column, .n_rows = n_rows, .n_columns = 1 };
+		Matrix* block_ptr = &block;
+		if (model->activation == &gmf_activation_sigmoid_hard)
+			gmf_activation_sigmoid_soft(&block_ptr, model);
+		else
+			model->activation(&block_ptr, model);
+
+		for (size_t r = 0; r < n_rows; ++r)
+		{
+			if (m == 0 || column[r] > best_scores[r])
+			{
+				best_scores[r] = column[r];
+				yhat[r] = (float)lm->class_pairs[m][1];
+			}
+		}
+	}
+}
 
-		mat_set(&Yhat, r, 0, frequent_class);
+// class with the most votes of every row (the lowest class wins a tie)
+static void __most_votes(
+	const uint32_t* votes,
+	const size_t n_rows,
+	const size_t n_classes,
+	float* yhat)
+{
+	for (size_t r = 0; r < n_rows; ++r)
+	{
+		const uint32_t* row_votes = votes + r * n_classes;
+		size_t frequent_class = 0;
+		for (size_t c = 1; c < n_classes; ++c)
+			if (row_votes[c] > row_votes[frequent_class])
+				frequent_class = c;
+		yhat[r] = (float)frequent_class;
 	}
+}
+
+Matrix* gmf_model_linear_ovr_predict(
+		const LinearModelOVR* lm,
+		const Matrix* X)
+{
+	Matrix* Yhat = NULL;
+	mat_init(&Yhat, X->n_rows, 1);
+	gmf_model_linear_ovr_predict_inplace(lm, X, &Yhat);
 
-	// CLEANUP
-	mat_free(&predicted_labels);
-	free(class_lookup_table);
-	
 	return Yhat;
 }
 
@@ -255,43 +660,46 @@ void gmf_model_linear_ovr_predict_inplace(
 		const Matrix* X,
 		Matrix** Yhat)
 {
-	Matrix* predicted_labels = NULL;
-	mat_init(&predicted_labels, lm->n_models, X->n_rows);
-
-	for (size_t model = 0; model < lm->n_models; ++model)
-	{
-		Matrix* Yhat_temp = mat_multiply(X, lm->models[model]->W);
-		float class_pairs[2] = { (float)lm->class_pairs[model][0], (float)lm->class_pairs[model][1] };
-		mat_apply(&Yhat_temp, &__set_classes, class_pairs);
-		for (size_t r = 0; r < Yhat_temp->n_rows; ++r)
-			mat_set(&predicted_labels, model, r, mat_at(Yhat_temp, r, 0));
-		mat_free(&Yhat_temp);
-	}
-
-	void* alloc = calloc(lm->n_classes, sizeof(float));
-	if (!alloc)
+	if (!lm->W)
+		err("Model must be fit before making predictions.");
+	if (X->n_columns != lm->W->n_rows)
+		err("X must have the same number of columns as the training data.");
+	if (!*Yhat || (*Yhat)->n_rows != X->n_rows || (*Yhat)->n_columns != 1)
+		err("Yhat must be an (n_rows, 1) matrix to hold the predicted classes of X.");
+
+	const size_t n_columns = X->n_columns;
+	const size_t n_models = lm->n_models;
+	float* scores = malloc(GMF_OVR_PREDICT_ROW_BLOCK * n_models * sizeof(float));
+	float* column = malloc(2 * GMF_OVR_PREDICT_ROW_BLOCK * sizeof(float)); // activations and best scores
+	uint32_t* votes = NULL;
+	if (lm->strategy == OVR_ONE_VS_ONE)
+		votes = malloc(GMF_OVR_PREDICT_ROW_BLOCK * lm->n_classes * sizeof(uint32_t));
+	if (!scores || !column || (lm->strategy == OVR_ONE_VS_ONE && !votes))
 		err("Couldn't allocate memory for LinearModelOVR predictions.");
-	float* class_lookup_table = alloc;
-	for (size_t r = 0; r < X->n_rows; ++r)
-	{
-		// reset lookup table
-		for (size_t i = 0; i < lm->n_classes; ++i)
-			class_lookup_table[i] = 0.0f;
 
-		for (size_t m = 0; m < lm->n_models; ++m)
-			class_lookup_table[(size_t)mat_at(predicted_labels, m, r)] += 1.0f;
+	for (size_t row = 0; row < X->n_rows; row += GMF_OVR_PREDICT_ROW_BLOCK)
+	{
+		const size_t n_rows = row + GMF_OVR_PREDICT_ROW_BLOCK < X->n_rows ? GMF_OVR_PREDICT_ROW_BLOCK : X->n_rows - row;
 
-		float frequent_class = -1.0f;
-		for (size_t c = 0; c < lm->n_classes; ++c)
-			if (class_lookup_table[c] > class_lookup_table[(size_t)frequent_class])
-				frequent_class = (float)c;
+		// scores of every model for the block: X[block, :] * W
+		for (size_t inner = 0; inner < n_columns; inner += GMF_OVR_PREDICT_INNER_BLOCK)
+		{
+			const size_t n_inner = inner + GMF_OVR_PREDICT_INNER_BLOCK < n_columns ? GMF_OVR_PREDICT_INNER_BLOCK : n_columns - inner;
+			gmf_kernel_gemm(X->data + row * n_columns + inner, n_rows, n_inner, n_columns, lm->W->data + inner * n_models, n_models, scores, inner > 0);
+		}
 
-		mat_set(Yhat, r, 0, frequent_class);
+		if (lm->strategy == OVR_ONE_VS_REST)
+			__highest_score(lm, scores, n_rows, column, column + GMF_OVR_PREDICT_ROW_BLOCK, (*Yhat)->data + row);
+		else
+		{
+			__tally_votes(lm, scores, n_rows, column, votes);
+			__most_votes(votes, n_rows, lm->n_classes, (*Yhat)->data + row);
+		}
 	}
 
-	// CLEANUP
-	mat_free(&predicted_labels);
-	free(class_lookup_table);
+	free(scores);
+	free(column);
+	free(votes);
 }
 
 void gmf_model_linear_ovr_free(
@@ -309,6 +717,12 @@ void gmf_model_linear_ovr_free(
 	free((*lm)->class_weights);
 	(*lm)->class_weights = NULL;
 
+	free((*lm)->binary_weights);
+	(*lm)->binary_weights = NULL;
+
+	if ((*lm)->W)
+		mat_free(&(*lm)->W);
+
 	free(*lm);
 	*lm = NULL;
 
@@ -362,6 +776,44 @@ void gmf_model_linear_ovr_set_batch_size(
 		(*lm)->models[m]->params->batch_size = batch_size;
 }
 
+void gmf_model_linear_ovr_set_threads(
+		LinearModelOVR** lm,
+		size_t n_threads)
+{
+	for (size_t m = 0; m < (*lm)->n_models; ++m)
+		(*lm)->models[m]->params->n_threads = n_threads;
+}
+
+void gmf_model_linear_ovr_set_model_threads(
+		LinearModelOVR** lm,
+		size_t n_model_threads)
+{
+	(*lm)->n_model_threads = n_model_threads;
+}
+
+void gmf_model_linear_ovr_set_random_seed(
+		LinearModelOVR** lm,
+		uint64_t random_seed)
+{
+	(*lm)->random_seed = random_seed;
+}
+
+void gmf_model_linear_ovr_set_optimizer(
+		LinearModelOVR** lm,
+		void (*optimizer)(Matrix**, const Matrix*, const float, const LinearModel*, LinearModelOptimizerState*))
+{
+	for (size_t m = 0; m < (*lm)->n_models; ++m)
+		(*lm)->models[m]->optimizer = optimizer;
+}
+
+void gmf_model_linear_ovr_set_learning_rate_schedule(
+		LinearModelOVR** lm,
+		float (*learning_rate_schedule)(const LinearModel*, const size_t))
+{
+	for (size_t m = 0; m < (*lm)->n_models; ++m)
+		(*lm)->models[m]->learning_rate_schedule = learning_rate_schedule;
+}
+
 void gmf_model_linear_ovr_set_activation(
 		LinearModelOVR** lm,
 		void (*activation)(Matrix**, const LinearModel*))
@@ -0,0 +1,522 @@
+#include <string.h>
+
+#include "linear_model_vec.h"
+#include "matrix.h"
+#include "gmf_util.h"
+#include "kernels.h"
+#include "fit_workspace.h"
+
+// rows per chunk when computing the gradient. Like the classic model the
+// chunking never depends on the number of threads so results are reproducible.
+#define GMF_VEC_CHUNK_ROWS 2048
+
+static void err(const char* msg)
+{
+	printf("%s\n", msg);
+	exit(-1);
+}
+
+// buffers used while training, allocated once per fit()
+typedef struct vec_workspace
+{
+	size_t n_sample_rows; // rows used per iteration (n_rows or batch_size)
+	size_t n_chunks;
+	Matrix* Yhat; // (n_sample_rows, n_outputs)
+	Matrix* residual; // (n_sample_rows, n_outputs) gradient with respect to XW
+	Matrix* Y_batch; // (n_sample_rows, n_outputs) targets of the batch rows since the loss functions take Y as a Matrix - BATCH only
+	size_t* row_idx; // permutation of [0, n_rows) - BATCH only
+	size_t epoch_position;
+	RandomState random_state;
+	float* partial_gradients; // (n_chunks, n_columns * n_outputs)
+	double* partial_losses; // (n_chunks)
+	float* gradient; // (n_columns, n_outputs)
+	ThreadPool* thread_pool; // NULL if n_threads <= 1
+} vec_workspace;
+
+void gmf_model_linear_vec_init_inplace(
+	LinearModelVec** lm,
+	const size_t n_outputs)
+{
+	if (n_outputs == 0)
+		err("LinearModelVec needs at least one output.");
+
+	void* alloc = malloc(sizeof(LinearModelVec));
+	if (!alloc)
+		err("Couldn't allocate memory for LinearModelVec.");
+	*lm = alloc;
+
+	alloc = malloc(sizeof(LinearModelVecParams));
+	if (!alloc)
+		err("Couldn't allocate memory for LinearModelVecParams.");
+	(*lm)->params = alloc;
+	(*lm)->params->n_iterations = 100;
+	(*lm)->params->learning_rate = 0.001f;
+	(*lm)->params->early_stop_threshold = 0.0001f;
+	(*lm)->params->early_stop_iterations = 0;
+	(*lm)->params->model_type = CLASSIC;
+	(*lm)->params->batch_size = 0;
+	(*lm)->params->n_threads = 1;
+
+	(*lm)->n_outputs = n_outputs;
+	(*lm)->activation = NULL;
+	(*lm)->loss = NULL;
+	(*lm)->loss_gradient = NULL;
+
+	// by default we'll init W to NULL since they aren't set until fit() is called
+	(*lm)->W = NULL;
+}
+
+LinearModelVec* gmf_model_linear_vec_init(
+	const size_t n_outputs)
+{
+	LinearModelVec* lm = NULL;
+	gmf_model_linear_vec_init_inplace(&lm, n_outputs);
+
+	return lm;
+}
+
+static void __check_functions(const LinearModelVec* lm)
+{
+	if (!lm->activation)
+		err("LinearModelVec must have activation function. See gmf_activation_vec_...");
+	if (!lm->loss)
+		err("LinearModelVec must have loss function. See gmf_loss_vec_...");
+	if (!lm->loss_gradient)
+		err("LinearModelVec must have loss gradient. See gmf_loss_gradient_vec_...");
+	if (lm->params->model_type != CLASSIC && lm->params->model_type != BATCH)
+		err("LinearModelVec only supports the CLASSIC and BATCH model types.");
+}
+
+static void __init_W(LinearModelVec** lm, const size_t n_columns)
+{
+	// reuse W from a previous fit() if the shape matches
+	if ((*lm)->W && (*lm)->W->n_rows != n_columns)
+		mat_free(&(*lm)->W);
+
+	// initialize random weights in [-1, 1]
+	if (!(*lm)->W)
+		mat_init(&(*lm)->W, n_columns, (*lm)->n_outputs);
+	mat_random(&(*lm)->W, -1.0f, 1.0f);
+}
+
+// (r, n_outputs) one-hot encoding of (r, 1) class labels
+static Matrix* __one_hot(const Matrix* Y, const size_t n_outputs)
+{
+	Matrix* Y_one_hot = NULL;
+	mat_init(&Y_one_hot, Y->n_rows, n_outputs);
+	memset(Y_one_hot->data, 0, Y->n_rows * n_outputs * sizeof(float));
+	for (size_t r = 0; r < Y->n_rows; ++r)
+	{
+		const float label = Y->data[r];
+		if (label < 0.0f || (size_t)label >= n_outputs || label != (float)(size_t)label)
+			err("LinearModelVec class labels must be integers in [0, n_outputs).");
+		Y_one_hot->data[r * n_outputs + (size_t)label] = 1.0f;
+	}
+
+	return Y_one_hot;
+}
+
+static void __workspace_alloc(
+	vec_workspace* workspace,
+	const LinearModelVec* lm,
+	const size_t n_rows,
+	const size_t n_columns)
+{
+	const size_t n_outputs = lm->n_outputs;
+	workspace->n_sample_rows = lm->params->model_type == BATCH ? lm->params->batch_size : n_rows;
+	workspace->n_chunks = (workspace->n_sample_rows + GMF_VEC_CHUNK_ROWS - 1) / GMF_VEC_CHUNK_ROWS;
+
+	workspace->Yhat = NULL;
+	workspace->residual = NULL;
+	mat_init(&workspace->Yhat, workspace->n_sample_rows, n_outputs);
+	mat_init(&workspace->residual, workspace->n_sample_rows, n_outputs);
+
+	workspace->Y_batch = NULL;
+	workspace->row_idx = NULL;
+	workspace->epoch_position = n_rows;
+	gmf_util_random_seed(&workspace->random_state, (uint64_t)rand());
+	if (lm->params->model_type == BATCH)
+	{
+		mat_init(&workspace->Y_batch, workspace->n_sample_rows, n_outputs);
+		workspace->row_idx = gmf_fit_row_idx_alloc(n_rows);
+	}
+
+	gmf_fit_partials_alloc(workspace->n_chunks, n_columns * n_outputs, &workspace->partial_gradients, &workspace->partial_losses);
+	workspace->gradient = malloc(n_columns * n_outputs * sizeof(float));
+	if (!workspace->gradient)
+		err("Couldn't allocate memory for LinearModelVec workspace.");
+
+	workspace->thread_pool = NULL;
+	if (lm->params->n_threads > 1)
+		workspace->thread_pool = gmf_util_thread_pool_init(lm->params->n_threads);
+}
+
+static void __workspace_release(vec_workspace* workspace)
+{
+	mat_free(&workspace->Yhat);
+	mat_free(&workspace->residual);
+	if (workspace->Y_batch)
+		mat_free(&workspace->Y_batch);
+	free(workspace->row_idx);
+	free(workspace->partial_gradients);
+	free(workspace->partial_losses);
+	free(workspace->gradient);
+	if (workspace->thread_pool)
+		gmf_util_thread_pool_free(&workspace->thread_pool);
+}
+
+// Z = X W for n_rows rows of X - every output in one pass over the rows,
+// see gmf_kernel_gemm()
+static void __multiply(
+	const float* X,
+	const size_t n_rows,
+	const size_t n_columns,
+	const float* W,
+	const size_t n_outputs,
+	float* Z)
+{
+	gmf_kernel_gemm(X, n_rows, n_columns, n_columns, W, n_outputs, Z, false);
+}
+
+typedef struct vec_chunk_args
+{
+	const LinearModelVec* lm;
+	const Matrix* X;
+	const Matrix* Y;
+	const size_t* row_idx; // rows of X and Y used (NULL for all of them)
+	size_t n_rows;
+	vec_workspace* workspace;
+} vec_chunk_args;
+
+// row i of the rows used by c_args
+static size_t __row(const vec_chunk_args* c_args, const size_t i)
+{
+	return c_args->row_idx ? c_args->row_idx[i] : i;
+}
+
+// XW, activation, loss and gradient of a single chunk of rows while
+// they're still in cache. The gradient of the chunk is X^T residual.
+// Batch rows are read straight out of X through row_idx, only their
+// targets are gathered since the loss functions take Y as a Matrix.
+static void __chunk_loss_gradient(void* args, size_t chunk)
+{
+	vec_chunk_args* c_args = args;
+	const LinearModelVec* lm = c_args->lm;
+	vec_workspace* workspace = c_args->workspace;
+	const size_t n_columns = c_args->X->n_columns;
+	const size_t n_outputs = lm->n_outputs;
+	const size_t row_start = chunk * GMF_VEC_CHUNK_ROWS;
+	size_t row_end = row_start + GMF_VEC_CHUNK_ROWS;
+	if (row_end > c_args->n_rows)
+		row_end = c_args->n_rows;
+	const size_t n_rows = row_end - row_start;
+	const float* X = c_args->X->data;
+
+	const float* Y = c_args->Y->data + row_start * n_outputs;
+	float* Yhat_data = workspace->Yhat->data + row_start * n_outputs;
+	if (c_args->row_idx)
+	{
+		float* Y_batch = workspace->Y_batch->data + row_start * n_outputs;
+		for (size_t i = 0; i < n_rows; ++i)
+		{
+			const size_t row = __row(c_args, row_start + i);
+			memcpy(Y_batch + i * n_outputs, c_args->Y->data + row * n_outputs, n_outputs * sizeof(float));
+			__multiply(X + row * n_columns, 1, n_columns, lm->W->data, n_outputs, Yhat_data + i * n_outputs);
+		}
+		Y = Y_batch;
+	}
+	else
+		__multiply(X + row_start * n_columns, n_rows, n_columns, lm->W->data, n_outputs, Yhat_data);
+
+	// the functions see the chunk as (n_rows, n_outputs) matrices
+	Matrix Y_chunk = { .data = (float*)Y, .n_rows = n_rows, .n_columns = n_outputs };
+	Matrix Yhat_chunk = { .data = Yhat_data, .n_rows = n_rows, .n_columns = n_outputs };
+	Matrix residual_chunk = { .data = workspace->residual->data + row_start * n_outputs, .n_rows = n_rows, .n_columns = n_outputs };
+	Matrix* Yhat = &Yhat_chunk;
+	Matrix* residual = &residual_chunk;
+
+	lm->activation(&Yhat, lm);
+	workspace->partial_losses[chunk] = lm->loss(&Y_chunk, Yhat, lm);
+	lm->loss_gradient(&Y_chunk, Yhat, lm, &residual);
+
+	float* gradient = workspace->partial_gradients + chunk * n_columns * n_outputs;
+	memset(gradient, 0, n_columns * n_outputs * sizeof(float));
+	for (size_t r = 0; r < n_rows; ++r)
+	{
+		const float* x = X + __row(c_args, row_start + r) * n_columns;
+		const float* delta = residual->data + r * n_outputs;
+		for (size_t c = 0; c < n_columns; ++c)
+		{
+			const float x_c = x[c];
+			float* g = gradient + c * n_outputs;
+			for (size_t j = 0; j < n_outputs; ++j)
+				g[j] += x_c * delta[j];
+		}
+	}
+}
+
+// loss and (average) gradient over n_rows rows of X (all rows if row_idx
+// is NULL, otherwise the rows listed in row_idx) computed chunk by chunk
+// (possibly on multiple threads) and combined in a fixed order
+static float __loss_gradient(
+	const LinearModelVec* lm,
+	const Matrix* X,
+	const Matrix* Y,
+	const size_t* row_idx,
+	const size_t n_rows,
+	vec_workspace* workspace)
+{
+	vec_chunk_args args = {
+		.lm = lm,
+		.X = X,
+		.Y = Y,
+		.row_idx = row_idx,
+		.n_rows = n_rows,
+		.workspace = workspace
+	};
+
+	gmf_fit_run_chunks(workspace->thread_pool, workspace->n_chunks, &__chunk_loss_gradient, &args);
+
+	const size_t n_weights = X->n_columns * lm->n_outputs;
+	gmf_fit_reduce_chunks(workspace->partial_gradients, workspace->partial_losses, workspace->n_chunks, n_weights);
+	for (size_t w = 0; w < n_weights; ++w)
+		workspace->gradient[w] = workspace->partial_gradients[w] / (float)n_rows;
+
+	return (float)workspace->partial_losses[0];
+}
+
+void gmf_model_linear_vec_fit(
+	LinearModelVec** lm,
+	const Matrix* X,
+	const Matrix* Y,
+	const bool verbose)
+{
+	__check_functions(*lm);
+
+	const size_t n_outputs = (*lm)->n_outputs;
+	const bool class_labels = Y->n_columns == 1 && n_outputs > 1;
+	if (Y->n_rows != X->n_rows)
+		err("LinearModelVec X and Y must have the same number of rows.");
+	if (!class_labels && Y->n_columns != n_outputs)
+		err("LinearModelVec Y must have n_outputs columns (or a single column of class labels).");
+
+	// set default batch size if one wasn't set (default of 25% original data size)
+	if ((*lm)->params->model_type == BATCH && (*lm)->params->batch_size == 0)
+		(*lm)->params->batch_size = X->n_rows / 4;
+	if ((*lm)->params->model_type == BATCH && (*lm)->params->batch_size > X->n_rows)
+		err("LinearModelVec batch_size can't be larger than the number of rows in X.");
+	// set default early_stop_iterations if one wasn't set (default is 10% original iterations)
+	if ((*lm)->params->early_stop_iterations == 0)
+		(*lm)->params->early_stop_iterations = (*lm)->params->n_iterations >= 10 ? (*lm)->params->n_iterations / 10 : 1;
+
+	__init_W(lm, X->n_columns);
+
+	Matrix* Y_one_hot = class_labels ? __one_hot(Y, n_outputs) : NULL;
+	const Matrix* Y_train = class_labels ? Y_one_hot : Y;
+
+	vec_workspace workspace;
+	__workspace_alloc(&workspace, *lm, X->n_rows, X->n_columns);
+
+	const size_t n_weights = X->n_columns * n_outputs;
+	const size_t print_interval = (*lm)->params->n_iterations >= 10 ? (*lm)->params->n_iterations / 10 : 1;
+	float previous_loss = 0.0f;
+	float initial_loss = 0.0f;
+	size_t tolerance_counter = 0;
+	bool stop_early = false;
+
+	for (size_t iter = 0; iter < (*lm)->params->n_iterations; ++iter)
+	{
+		// next batch of the current (shuffled) epoch, its rows are read
+		// straight out of X through these indices
+		const size_t* batch_idx = NULL;
+		if ((*lm)->params->model_type == BATCH)
+			batch_idx = gmf_fit_next_sample(
+					&workspace.random_state,
+					workspace.row_idx,
+					X->n_rows,
+					workspace.n_sample_rows,
+					&workspace.epoch_position);
+
+		const float loss = __loss_gradient(*lm, X, Y_train, batch_idx, workspace.n_sample_rows, &workspace);
+
+		// check early stop criteria
+		if (iter > 0 && fabsf(loss - previous_loss) < (*lm)->params->early_stop_threshold)
+			tolerance_counter++;
+		else
+			tolerance_counter = 0;
+		previous_loss = loss;
+		if (tolerance_counter >= (*lm)->params->early_stop_iterations)
+		{
+			stop_early = true;
+			break;
+		}
+
+		// only print loss 10 times for any given number of iterations
+		if (iter % print_interval == 0)
+		{
+			if (iter == 0)
+				initial_loss = loss;
+			else if (loss > 10 * initial_loss)
+			{
+				printf("WARNING: loss blew up. Consider lowering your learning rate.\n");
+				break;
+			}
+
+			if (verbose)
+				printf("Loss at iteration %zu: %f\n", iter, loss);
+		}
+
+		// update weights of every output at once
+		const float learning_rate = (*lm)->params->learning_rate;
+		float* W = (*lm)->W->data;
+		for (size_t w = 0; w < n_weights; ++w)
+			W[w] -= learning_rate * workspace.gradient[w];
+	}
+
+	// only display this message if early stopping is not disabled
+	if (!stop_early && (*lm)->params->early_stop_iterations < (*lm)->params->n_iterations)
+		printf("WARNING: model may not have converged. Consider increasing iterations or learning rate.\n");
+
+	__workspace_release(&workspace);
+	if (Y_one_hot)
+		mat_free(&Y_one_hot);
+}
+
+Matrix* gmf_model_linear_vec_predict(
+	const LinearModelVec* lm,
+	const Matrix* X)
+{
+	Matrix* Yhat = NULL;
+	mat_init(&Yhat, X->n_rows, lm->n_outputs);
+	gmf_model_linear_vec_predict_inplace(lm, X, &Yhat);
+
+	return Yhat;
+}
+
+void gmf_model_linear_vec_predict_inplace(
+	const LinearModelVec* lm,
+	const Matrix* X,
+	Matrix** Yhat)
+{
+	if (!lm->W)
+		err("Model must be fit before making predictions.");
+	if (X->n_columns != lm->W->n_rows)
+		err("X must have the same number of columns as the training data.");
+	if (!*Yhat || (*Yhat)->n_rows != X->n_rows || (*Yhat)->n_columns != lm->n_outputs)
+		err("Yhat must be an (n_rows, n_outputs) matrix to hold the predictions of X.");
+
+	// predict chunk by chunk so the activation runs while XW is in cache
+	const size_t n_outputs = lm->n_outputs;
+	for (size_t row = 0; row < X->n_rows; row += GMF_VEC_CHUNK_ROWS)
+	{
+		const size_t n_rows = row + GMF_VEC_CHUNK_ROWS < X->n_rows ? GMF_VEC_CHUNK_ROWS : X->n_rows - row;
+		Matrix chunk = { .data = (*Yhat)->data + row * n_outputs, .n_rows = n_rows, .n_columns = n_outputs };
+		Matrix* chunk_ptr = &chunk;
+		__multiply(X->data + row * X->n_columns, n_rows, X->n_columns, lm->W->data, n_outputs, chunk.data);
+		lm->activation(&chunk_ptr, lm);
+	}
+}
+
+Matrix* gmf_model_linear_vec_predict_class(
+	const LinearModelVec* lm,
+	const Matrix* X)
+{
+	Matrix* Yhat = gmf_model_linear_vec_predict(lm, X);
+	Matrix* classes = NULL;
+	mat_init(&classes, X->n_rows, 1);
+
+	const size_t n_outputs = lm->n_outputs;
+	for (size_t r = 0; r < X->n_rows; ++r)
+	{
+		const float* yhat = Yhat->data + r * n_outputs;
+		size_t best = 0;
+		for (size_t j = 1; j < n_outputs; ++j)
+			if (yhat[j] > yhat[best])
+				best = j;
+		classes->data[r] = (float)best;
+	}
+
+	mat_free(&Yhat);
+	return classes;
+}
+
+void gmf_model_linear_vec_free(
+	LinearModelVec** lm)
+{
+	if ((*lm)->W)
+		mat_free(&(*lm)->W);
+	free((*lm)->params);
+	(*lm)->params = NULL;
+	free(*lm);
+	*lm = NULL;
+}
+
+void gmf_model_linear_vec_set_iterations(
+	LinearModelVec** lm,
+	const size_t n_iterations)
+{
+	(*lm)->params->n_iterations = n_iterations;
+}
+
+void gmf_model_linear_vec_set_learning_rate(
+	LinearModelVec** lm,
+	const float learning_rate)
+{
+	(*lm)->params->learning_rate = learning_rate;
+}
+
+void gmf_model_linear_vec_set_early_stop_threshold(
+	LinearModelVec** lm,
+	const float early_stop_threshold)
+{
+	(*lm)->params->early_stop_threshold = early_stop_threshold;
+}
+
+void gmf_model_linear_vec_set_early_stop_iterations(
+	LinearModelVec** lm,
+	const size_t early_stop_iterations)
+{
+	(*lm)->params->early_stop_iterations = early_stop_iterations;
+}
+
+void gmf_model_linear_vec_set_model_type(
+	LinearModelVec** lm,
+	const LinearModelType model_type)
+{
+	(*lm)->params->model_type = model_type;
+}
+
+void gmf_model_linear_vec_set_batch_size(
+	LinearModelVec** lm,
+	const size_t batch_size)
+{
+	(*lm)->params->batch_size = batch_size;
+}
+
+void gmf_model_linear_vec_set_threads(
+	LinearModelVec** lm,
+	const size_t n_threads)
+{
+	(*lm)->params->n_threads = n_threads;
+}
+
+void gmf_model_linear_vec_set_activation(
+	LinearModelVec** lm,
+	void (*activation)(Matrix**, const LinearModelVec*))
+{
+	(*lm)->activation = activation;
+}
+
+void gmf_model_linear_vec_set_loss(
+	LinearModelVec** lm,
+	float (*loss)(const Matrix*, const Matrix*, const LinearModelVec*))
+{
+	(*lm)->loss = loss;
+}
+
+void gmf_model_linear_vec_set_loss_gradient(
+	LinearModelVec** lm,
+	void (*loss_gradient)(const Matrix*, const Matrix*, const LinearModelVec*, Matrix**))
+{
+	(*lm)->loss_gradient = loss_gradient;
+}
@@ -1,14 +1,99 @@
 #include "loss_gradients.h"
 #include "linear_model.h"
+#include "regularization.h"
 #include "matrix.h"
 
-static void __add_regularization(const LinearModel* lm, Matrix** Y)
+// proximal regularizations are applied to W after the update instead
+static float __regularization(const LinearModel* lm)
 {
-	if (lm->regularization_gradient)
+	if (lm->regularization_gradient && !gmf_regularization_is_proximal(lm->regularization))
+		return lm->regularization_gradient(lm->params->regularization_params, lm->W);
+	return 0.0f;
+}
+
+// computes X^T r / n_rows into loss_gradient where r is the residual
+// (plus regularization) of each row. X is read row by row so we
+// never need to copy Y/Yhat or transpose X.
+static void __compute_gradient(
+		const Matrix* Y,
+		const Matrix* Yhat,
+		const Matrix* X,
+		const LinearModel* lm,
+		float (*residual_func)(float, float, const LinearModel*),
+		Matrix** loss_gradient)
+{
+	const size_t n_columns = X->n_columns;
+	float* gradient = (*loss_gradient)->data;
+	for (size_t c = 0; c < n_columns; ++c)
+		gradient[c] = 0.0f;
+
+	float regularization = __regularization(lm);
+
+	for (size_t r = 0; r < X->n_rows; ++r)
 	{
-		float regularization = lm->regularization_gradient(lm->params->regularization_params, lm->W);
-		mat_add_s(Y, regularization);
+		float residual = residual_func(mat_at(Y, r, 0), mat_at(Yhat, r, 0), lm) + regularization;
+		const float* x = X->data + r * n_columns;
+		for (size_t c = 0; c < n_columns; ++c)
+			gradient[c] += residual * x[c];
 	}
+
+	for (size_t c = 0; c < n_columns; ++c)
+		gradient[c] /= (float)X->n_rows;
+}
+
+static float __squared_residual(
+		float y,
+		float yhat,
+		const LinearModel* lm)
+{
+	// -2(y - yhat)
+	return -2.0f * (y - yhat);
+}
+
+static float __cross_entropy_residual(
+		float y,
+		float yhat,
+		const LinearModel* lm)
+{
+	// (yhat - y) with class weights applied
+	float residual = yhat - y;
+	if (lm->params->class_weights)
+		residual *= lm->params->class_weights[lm->params->class_pair[(size_t)y]];
+	return residual;
+}
+
+static float __absolute_residual(
+		float y,
+		float yhat,
+		const LinearModel* lm)
+{
+	if (fabsf(y - yhat) < 0.0001f)
+		return 0.0f;
+	return -(y - yhat)/fabsf(y - yhat); // carry negative from chain rule
+}
+
+static float __hinge_residual(
+		float y,
+		float yhat,
+		const LinearModel* lm)
+{
+	// yeah, <= prob not great for floats, but good enough
+	if (y * yhat <= 0.0f)
+		return 0.5f - y * yhat;
+	else if (y * yhat > 0.0f && y * yhat <= 1.0f)
+		return 0.5f * (1.0f - y * yhat);
+	return 0.0f;
+}
+
+static float __huber_residual(
+		float y,
+		float yhat,
+		const LinearModel* lm)
+{
+	// carry negative from chain rule
+	if (fabsf(y - yhat) <= lm->params->huber_delta)
+		return -(y - yhat);
+	return -lm->params->huber_delta * ((y - yhat) / fabsf(y - yhat));
 }
 
 void gmf_loss_gradient_squared(
@@ -18,18 +103,7 @@ void gmf_loss_gradient_squared(
 		const LinearModel* lm,
 		Matrix** loss_gradient)
 {
-	// compute -2(y - yhat) element-wise and multiply by X
-	Matrix* Y_temp = mat_copy(Y);
-	mat_subtract_e(&Y_temp, Yhat);
-	mat_multiply_s(&Y_temp, -2.0f);
-	__add_regularization(lm, &Y_temp);	
-
-	Matrix* X_t = mat_transpose(X);
-	mat_multiply_inplace(X_t, Y_temp, loss_gradient);	
-	mat_divide_s(loss_gradient, X->n_rows);
-
-	mat_free(&Y_temp);
-	mat_free(&X_t);
+	__compute_gradient(Y, Yhat, X, lm, &__squared_residual, loss_gradient);
 }
 
 void gmf_loss_gradient_cross_entropy(
@@ -39,24 +113,7 @@ void gmf_loss_gradient_cross_entropy(
 		const LinearModel* lm,
 		Matrix** loss_gradient)
 {
-	// compute (yhat - y) element-wise and multiply by X
-	Matrix* Yhat_temp = mat_copy(Yhat);
-	mat_subtract_e(&Yhat_temp, Y);
-
-	// apply class weights
-	if (lm->params->class_weights)
-	{
-		for (size_t r = 0; r < Y->n_rows; ++r)
-			mat_set(&Yhat_temp, r, 0, mat_at(Yhat_temp, r, 0) * lm->params->class_weights[lm->params->class_pair[(size_t)mat_at(Y, r, 0)]]);
-	}
-
-	__add_regularization(lm, &Yhat_temp);
-
-	Matrix* X_t = mat_transpose(X);
-	mat_multiply_inplace(X_t, Yhat_temp, loss_gradient);
-	mat_divide_s(loss_gradient, X->n_rows);
-	mat_free(&Yhat_temp);
-	mat_free(&X_t);
+	__compute_gradient(Y, Yhat, X, lm, &__cross_entropy_residual, loss_gradient);
 }
 
 void gmf_loss_gradient_absolute(
@@ -66,30 +123,7 @@ void gmf_loss_gradient_absolute(
 		const LinearModel* lm,
 		Matrix** loss_gradient)
 {
-	Matrix* result = NULL;
-	mat_init(&result, Y->n_rows, 1);
-
-	for (size_t r = 0; r < Y->n_rows; ++r)
-	{
-		float y = mat_at(Y, r, 0);
-		float yhat = mat_at(Yhat, r, 0);
-
-		if (fabsf(y - yhat) < 0.0001f)
-			mat_set(&result, r, 0, 0.0f);
-		else
-			mat_set(&result, r, 0, (y - yhat)/fabsf(y - yhat));
-	}
-	
-	mat_multiply_s(&result, -1.0f); // carry negative from chain rule
-
-	__add_regularization(lm, &result);
-
-	Matrix* X_t = mat_transpose(X);
-	mat_multiply_inplace(X_t, result, loss_gradient);
-	mat_divide_s(loss_gradient, X->n_rows);
-
-	mat_free(&result);
-	mat_free(&X_t);
+	__compute_gradient(Y, Yhat, X, lm, &__absolute_residual, loss_gradient);
 }
 
 void gmf_loss_gradient_hinge(
@@ -99,31 +133,7 @@ void gmf_loss_gradient_hinge(
 		const LinearModel* lm,
 		Matrix** loss_gradient)
 {
-	Matrix* result = NULL;
-	mat_init(&result, Y->n_rows, 1);
-
-	for (size_t r = 0; r < Y->n_rows; ++r)
-	{
-		float y = mat_at(Y, r, 0);
-		float yhat = mat_at(Yhat, r, 0);
-
-		// yeah, <= prob not great for floats, but good enough
-		if (y * yhat <= 0.0f)
-			mat_set(&result, r, 0, 0.5f - y * yhat);
-		else if (y * yhat > 0.0f && y * yhat <= 1.0f)
-			mat_set(&result, r, 0, 0.5f * (1.0f - y * yhat));
-		else
-			mat_set(&result, r, 0, 0.0f);
-	}
-
-	__add_regularization(lm, &result);
-
-	Matrix* X_t = mat_transpose(X);
-	mat_multiply_inplace(X_t, result, loss_gradient);
-	mat_divide_s(loss_gradient, X->n_rows);
-
-	mat_free(&result);
-	mat_free(&X_t);
+	__compute_gradient(Y, Yhat, X, lm, &__hinge_residual, loss_gradient);
 }
 
 void gmf_loss_gradient_huber(
@@ -133,28 +143,25 @@ void gmf_loss_gradient_huber(
 		const LinearModel* lm,
 		Matrix** loss_gradient)
 {
-	Matrix* result = NULL;
-	mat_init(&result, Y->n_rows, 1);
-	
-	for (size_t r = 0; r < Y->n_rows; ++r)
-	{
-		float y = mat_at(Y, r, 0);
-		float yhat = mat_at(Yhat, r, 0);
-
-		if (fabsf(y - yhat) <= lm->params->huber_delta)
-			mat_set(&result, r, 0, y - yhat);
-		else
-			mat_set(&result, r, 0, lm->params->huber_delta * ((y - yhat) / fabsf(y - yhat)));
-	}
-
-	mat_multiply_s(&result, -1.0f); // carry negative from chain rule
-
-	__add_regularization(lm, &result);
+	__compute_gradient(Y, Yhat, X, lm, &__huber_residual, loss_gradient);
+}
 
-	Matrix* X_t = mat_transpose(X);
-	mat_multiply_inplace(X_t, result, loss_gradient);
-	mat_divide_s(loss_gradient, X->n_rows);
+void gmf_loss_gradient_vec_squared(
+		const Matrix* Y,
+		const Matrix* Yhat,
+		const LinearModelVec* lm,
+		Matrix** residual)
+{
+	for (size_t i = 0; i < Y->n_rows * Y->n_columns; ++i)
+		(*residual)->data[i] = -2.0f * (Y->data[i] - Yhat->data[i]);
+}
 
-	mat_free(&result);
-	mat_free(&X_t);
+void gmf_loss_gradient_vec_cross_entropy(
+		const Matrix* Y,
+		const Matrix* Yhat,
+		const LinearModelVec* lm,
+		Matrix** residual)
+{
+	for (size_t i = 0; i < Y->n_rows * Y->n_columns; ++i)
+		(*residual)->data[i] = Yhat->data[i] - Y->data[i];
 }
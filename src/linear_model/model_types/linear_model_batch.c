@@ -1,68 +1,76 @@
 for (size_t iter = 0; iter < (*lm)->params->n_iterations; ++iter)
 {
-	// sample subset of points (batch optimization)
-	void* s_alloc = calloc((*lm)->params->batch_size, sizeof(size_t));
-	if (!s_alloc)
-		err("Couldn't allocate memory when trying to sample data.");
-	size_t* sampled_idx = s_alloc;
-	Matrix* X_sample = mat_sample(X, (*lm)->params->batch_size, false, sampled_idx);
+	const bool check_loss = iter % check_interval == 0;
+	const bool print_loss = iter % print_interval == 0;
+
+	// next batch of the current (shuffled) epoch. The kernels read the
+	// rows straight out of X through these indices, nothing is copied
+	const size_t* batch_idx = __next_sample(workspace);
+
+	Matrix* X_sample = NULL;
 	Matrix* Y_sample = NULL;
-	mat_init(&Y_sample, (*lm)->params->batch_size, 1);
-	for (size_t r = 0; r < (*lm)->params->batch_size; ++r)
-		mat_set(&Y_sample, r, 0, mat_at(Y, sampled_idx[r], 0));
+	Matrix* Yhat = workspace->Yhat;
+	float loss = 0.0f;
 
-	free(sampled_idx);
-	sampled_idx = NULL;
+	if (builtin_kernel)
+	{
+		// activation, loss and gradient in one pass over the batch rows
+		loss = __chunked_loss_gradient(*lm, X, Y, batch_idx, workspace->n_sample_rows, print_loss || (check_loss && !workspace->best_W), workspace, &loss_grad);
+	}
+	else if (fused_loss_gradient)
+	{
+		// custom kernels need the batch as a matrix
+		__gather_rows(workspace, X, Y, batch_idx);
+		X_sample = workspace->X_sample;
+		Y_sample = workspace->Y_sample;
 
-	Matrix* Yhat = NULL;
-	mat_init(&Yhat, (*lm)->params->batch_size, 1);
+		loss = fused_loss_gradient(X_sample, Y_sample, *lm, &loss_grad);
+	}
+	else
+	{
+		// custom functions need the batch as a matrix
+		__gather_rows(workspace, X, Y, batch_idx);
+		X_sample = workspace->X_sample;
+		Y_sample = workspace->Y_sample;
 
-	// get linear combination of data and weights
-	mat_multiply_inplace(X_sample, (*lm)->W, &Yhat);
-	
-	// apply activation
-	(*lm)->activation(&Yhat, *lm);
+		// get linear combination of data and weights
+		mat_multiply_inplace(X_sample, (*lm)->W, &Yhat);
+		
+		// apply activation
+		(*lm)->activation(&Yhat, *lm);
 
-	// compute loss and check early stop criteria
-	float loss = (*lm)->loss(Y_sample, Yhat, *lm);
+		// compute loss (an extra pass, so only when it's used)
+		if (print_loss || (check_loss && !workspace->best_W))
+			loss = (*lm)->loss(Y_sample, Yhat, *lm);
+	}
 
-	stop_early = __check_loss_tolerance(loss, previous_loss, (*lm)->params->early_stop_threshold, &tolerance_counter, (*lm)->params->early_stop_iterations);
-	if (stop_early)
+	// check early stop criteria
+	if (check_loss && __check_loss(*lm, workspace, loss, check_interval, &tracker))
 	{
-		// incase early stop, we must release memory early
-		mat_free(&X_sample);
-		mat_free(&Y_sample);
-		mat_free(&Yhat);
+		stop_early = true;
 		break;
 	}
-	previous_loss = loss;
 
 	// only print loss 10 times for any given number
 	// of iterations
-	if (iter % (size_t)((float)(*lm)->params->n_iterations / 10.0f) == 0)
+	if (print_loss)
 	{
 		if (iter == 0)
 			initial_loss = loss;
-		else if (iter > 0 && loss > 10 * initial_loss)
+		else if (loss > 10 * initial_loss)
 		{
 			printf("WARNING: loss blew up. Consider lowering your learning rate.\n");
-			// incase early stop, we must release memory early
-			mat_free(&X_sample);
-			mat_free(&Y_sample);
-			mat_free(&Yhat);
 			break;
 		}
-		if (verbose)
-			printf("Loss at iteration %zu: %f\n", iter, loss);
-	}	
 
+		if (verbose)
+			__print_loss(iter, loss, &tracker);
+	}
 
-	(*lm)->loss_gradient(Y_sample, Yhat, X_sample, *lm, &loss_grad);
-	mat_free(&X_sample);
-	mat_free(&Y_sample);
-	mat_free(&Yhat);
+	if (!fused_loss_gradient)
+		(*lm)->loss_gradient(Y_sample, Yhat, X_sample, *lm, &loss_grad);
 
 	// update weights
-	mat_multiply_s(&loss_grad, (*lm)->params->learning_rate);
-	mat_subtract_e(&(*lm)->W, loss_grad);
+	const float learning_rate = (*lm)->learning_rate_schedule(*lm, iter);
+	__update_weights(*lm, loss_grad, learning_rate, workspace);
 }
@@ -0,0 +1,22 @@
+{
+	// a single pass over X builds X^T X and X^T Y, then
+	// (X^T X + lambda * I) * W = X^T Y is solved directly
+	const float lambda = __solver_lambda(*lm);
+	const double sum_squares = __solver_system(*lm, X, Y, workspace);
+	__solver_solve(workspace, lambda);
+
+	const double* rhs = workspace->solver_partials + X->n_columns * X->n_columns;
+	double projection = 0.0;
+	for (size_t c = 0; c < X->n_columns; ++c)
+	{
+		(*lm)->W->data[c] = (float)workspace->solver_step[c];
+		projection += workspace->solver_step[c] * rhs[c];
+	}
+
+	// at the solution, sum((Y - XW)^2) + lambda * W^T W = Y^T Y - W^T X^T Y
+	if (verbose)
+		printf("Loss after solving normal equations: %f\n", (float)(sum_squares - projection));
+
+	// the solution is exact so there's nothing to converge
+	stop_early = true;
+}
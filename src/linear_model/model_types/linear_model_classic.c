@@ -1,48 +1,62 @@
 for (size_t iter = 0; iter < (*lm)->params->n_iterations; ++iter)
 {
-	Matrix* Yhat = NULL;
-	mat_init(&Yhat, X->n_rows, 1);
-
-	// get linear combination of data and weights
-	mat_multiply_inplace(X, (*lm)->W, &Yhat);
-	
-	// apply activation
-	(*lm)->activation(&Yhat, *lm);
-
-	// compute loss and check early stop criteria
-	float loss = (*lm)->loss(Y, Yhat, *lm);
-	stop_early = __check_loss_tolerance(loss, previous_loss, (*lm)->params->early_stop_threshold, &tolerance_counter, (*lm)->params->early_stop_iterations);
-	if (stop_early)
+	const bool check_loss = iter % check_interval == 0;
+	const bool print_loss = iter % print_interval == 0;
+
+	Matrix* Yhat = workspace->Yhat;
+	float loss = 0.0f;
+
+	if (builtin_kernel)
+	{
+		// activation, loss and gradient in one pass over X,
+		// split across n_threads with a deterministic reduction
+		loss = __chunked_loss_gradient(*lm, X, Y, NULL, X->n_rows, print_loss || (check_loss && !workspace->best_W), workspace, &loss_grad);
+	}
+	else if (fused_loss_gradient)
+	{
+		// activation, loss and gradient in one pass over X
+		loss = fused_loss_gradient(X_matrix, Y, *lm, &loss_grad);
+	}
+	else
 	{
-		// incase of early stop, free memory early
-		mat_free(&Yhat);
+		// get linear combination of data and weights
+		mat_multiply_inplace(X_matrix, (*lm)->W, &Yhat);
+		
+		// apply activation
+		(*lm)->activation(&Yhat, *lm);
+
+		// compute loss (an extra pass, so only when it's used)
+		if (print_loss || (check_loss && !workspace->best_W))
+			loss = (*lm)->loss(Y, Yhat, *lm);
+	}
+
+	// check early stop criteria
+	if (check_loss && __check_loss(*lm, workspace, loss, check_interval, &tracker))
+	{
+		stop_early = true;
 		break;
 	}
-	previous_loss = loss;
 
 	// only print loss 10 times for any given number
 	// of iterations
-	if (iter % (size_t)((float)(*lm)->params->n_iterations / 10.0f) == 0)
+	if (print_loss)
 	{
 		if (iter == 0)
 			initial_loss = loss;
-		else if (iter > 0 && loss > 10 * initial_loss)
+		else if (loss > 10 * initial_loss)
 		{
-			// incase of early stop, free memory early
 			printf("WARNING: loss blew up. Consider lowering your learning rate.\n");
-			mat_free(&Yhat);
 			break;
 		}
 
 		if (verbose)
-			printf("Loss at iteration %zu: %f\n", iter, loss);
-	}	
-
+			__print_loss(iter, loss, &tracker);
+	}
 
-	(*lm)->loss_gradient(Y, Yhat, X, *lm, &loss_grad);
-	mat_free(&Yhat);
+	if (!fused_loss_gradient)
+		(*lm)->loss_gradient(Y, Yhat, X_matrix, *lm, &loss_grad);
 
 	// update weights
-	mat_multiply_s(&loss_grad, (*lm)->params->learning_rate);
-	mat_subtract_e(&(*lm)->W, loss_grad);
+	const float learning_rate = (*lm)->learning_rate_schedule(*lm, iter);
+	__update_weights(*lm, loss_grad, learning_rate, workspace);
 }
@@ -0,0 +1,9 @@
+{
+	// start from W = 0 so weights the penalty removes are exactly zero
+	memset((*lm)->W->data, 0, X->n_columns * sizeof(float));
+	__cd_prepare(workspace, X, Y, (*lm)->W->data);
+
+	double l1 = 0.0, l2 = 0.0;
+	__cd_penalty(*lm, &l1, &l2);
+	stop_early = __coordinate_descent(*lm, workspace, l1, l2, verbose);
+}
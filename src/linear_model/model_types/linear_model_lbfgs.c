@@ -0,0 +1,112 @@
+{
+	// every iteration is one LBFGS step: a search direction from the
+	// curvature history followed by a (strong Wolfe) line search, which
+	// usually accepts the first step and costs a single pass over X
+	const size_t n_columns = X->n_columns;
+	const size_t history = workspace->lbfgs_history;
+	float* W = (*lm)->W->data;
+	double* gradient = workspace->lbfgs_gradient;
+	double* previous_gradient = workspace->lbfgs_previous_gradient;
+	double* direction = workspace->lbfgs_direction;
+
+	lbfgs_args args = {
+		.X = X,
+		.X_matrix = X_matrix,
+		.Y = Y,
+		.lm = *lm,
+		.workspace = workspace,
+		.fused_loss_gradient = fused_loss_gradient,
+		.builtin_kernel = builtin_kernel,
+		.loss = 0.0
+	};
+	double objective = __lbfgs_objective(&args, gradient);
+	size_t n_pairs = 0;
+	size_t newest = history - 1;
+
+	for (size_t iter = 0; iter < (*lm)->params->n_iterations; ++iter)
+	{
+		float loss = (float)args.loss;
+
+		// check early stop criteria
+		if (iter % check_interval == 0 && __check_loss(*lm, workspace, loss, check_interval, &tracker))
+		{
+			stop_early = true;
+			break;
+		}
+
+		// only print loss 10 times for any given number
+		// of iterations
+		if (iter % print_interval == 0 && verbose)
+			__print_loss(iter, loss, &tracker);
+
+		double gradient_norm = 0.0;
+		for (size_t c = 0; c < n_columns; ++c)
+			gradient_norm += gradient[c] * gradient[c];
+		gradient_norm = sqrt(gradient_norm);
+		if (gradient_norm < 1e-7)
+		{
+			// already at a (numerical) minimum
+			stop_early = true;
+			break;
+		}
+
+		gmf_lbfgs_direction(gradient, workspace->lbfgs_s, workspace->lbfgs_y, workspace->lbfgs_rho, n_pairs, newest, history, n_columns, workspace->lbfgs_alpha, direction);
+		double g_dot_d = 0.0;
+		for (size_t c = 0; c < n_columns; ++c)
+			g_dot_d += gradient[c] * direction[c];
+
+		// the curvature history can (rarely) produce an ascent direction
+		// with non-convex or non-smooth losses - restart from steepest descent
+		if (!(g_dot_d < 0.0))
+		{
+			n_pairs = 0;
+			for (size_t c = 0; c < n_columns; ++c)
+				direction[c] = -gradient[c];
+			g_dot_d = -gradient_norm * gradient_norm;
+		}
+
+		// without any history the direction isn't scaled so the first
+		// step is limited to a unit change in W
+		double initial_step = n_pairs == 0 ? (gradient_norm > 1.0 ? 1.0 / gradient_norm : 1.0) : 1.0;
+
+		memcpy(workspace->solver_W, W, n_columns * sizeof(float));
+		memcpy(previous_gradient, gradient, n_columns * sizeof(double));
+		const double previous_objective = objective;
+		double step = gmf_lbfgs_line_search(&__lbfgs_objective, &args, W, workspace->solver_W, direction, previous_objective, g_dot_d, initial_step, n_columns, &objective, gradient);
+
+		if (step == 0.0)
+		{
+			// no decrease along the direction - retry once from steepest descent
+			// otherwise W is as good as it gets in float precision
+			if (n_pairs == 0)
+			{
+				memcpy(gradient, previous_gradient, n_columns * sizeof(double));
+				objective = previous_objective;
+				stop_early = true;
+				break;
+			}
+			n_pairs = 0;
+			objective = __lbfgs_objective(&args, gradient);
+			continue;
+		}
+
+		// store the new curvature pair (skipped if it would break positive definiteness)
+		size_t slot = (newest + 1) % history;
+		double* s = workspace->lbfgs_s + slot * n_columns;
+		double* y = workspace->lbfgs_y + slot * n_columns;
+		double s_dot_y = 0.0;
+		for (size_t c = 0; c < n_columns; ++c)
+		{
+			s[c] = (double)W[c] - (double)workspace->solver_W[c];
+			y[c] = gradient[c] - previous_gradient[c];
+			s_dot_y += s[c] * y[c];
+		}
+		if (s_dot_y > 1e-12)
+		{
+			workspace->lbfgs_rho[slot] = 1.0 / s_dot_y;
+			newest = slot;
+			if (n_pairs < history)
+				n_pairs++;
+		}
+	}
+}
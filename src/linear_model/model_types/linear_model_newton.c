@@ -0,0 +1,63 @@
+{
+	// every iteration is one pass over X building the gradient and
+	// hessian, followed by a direct solve for the Newton step
+	const float lambda = __solver_lambda(*lm);
+	const size_t n_columns = X->n_columns;
+	float* W = (*lm)->W->data;
+
+	// start from W = 0 (p = 0.5 everywhere) where the hessian is well conditioned.
+	// Random weights can saturate the sigmoid and make the first step useless
+	memset(W, 0, n_columns * sizeof(float));
+	double weight_norm = 0.0;
+	double loss = __solver_system(*lm, X, Y, workspace);
+
+	for (size_t iter = 0; iter < (*lm)->params->n_iterations; ++iter)
+	{
+		if (verbose)
+			printf("Loss at iteration %zu: %f\n", iter, (float)loss);
+
+		// gradient and hessian of the L2 penalty are 2 * lambda * W and 2 * lambda * I
+		double* rhs = workspace->solver_partials + n_columns * n_columns;
+		for (size_t c = 0; c < n_columns; ++c)
+			rhs[c] += 2.0 * lambda * W[c];
+		__solver_solve(workspace, 2.0 * lambda);
+		memcpy(workspace->solver_W, W, n_columns * sizeof(float));
+
+		// halve the step until the loss decreases (plain Newton can
+		// overshoot on nearly separable data)
+		double step_size = 1.0;
+		double new_loss = loss;
+		while (true)
+		{
+			weight_norm = 0.0;
+			for (size_t c = 0; c < n_columns; ++c)
+			{
+				W[c] = (float)(workspace->solver_W[c] - step_size * workspace->solver_step[c]);
+				weight_norm += (double)W[c] * W[c];
+			}
+			new_loss = __solver_system(*lm, X, Y, workspace) + lambda * weight_norm;
+
+			if (new_loss <= loss || step_size < 1e-3)
+				break;
+			step_size *= 0.5;
+		}
+
+		// no further improvement is possible in float precision
+		if (new_loss > loss)
+		{
+			memcpy(W, workspace->solver_W, n_columns * sizeof(float));
+			stop_early = true;
+			break;
+		}
+
+		bool converged = loss - new_loss <= 1e-9 * fabs(loss);
+		loss = new_loss;
+		if (converged)
+		{
+			if (verbose)
+				printf("Loss at iteration %zu: %f\n", iter + 1, (float)loss);
+			stop_early = true;
+			break;
+		}
+	}
+}
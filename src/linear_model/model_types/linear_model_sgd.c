@@ -0,0 +1,86 @@
+// every iteration is a single sample, but samples are processed in windows
+// of check_interval samples per shard between loss checks so HOGWILD threads
+// run check_interval updates each between two synchronizations
+const size_t window = check_interval * workspace->n_shards;
+// HOGWILD threads would all rewrite every weight of the shared W after every
+// sample, so the proximal step of the whole window is taken once below
+const bool proximal = gmf_regularization_is_proximal((*lm)->regularization);
+const bool window_proximal = proximal && (*lm)->params->model_type == HOGWILD;
+for (size_t iter = 0; iter < (*lm)->params->n_iterations; iter += window)
+{
+	size_t n_samples = window;
+	if (iter + n_samples > (*lm)->params->n_iterations)
+		n_samples = (*lm)->params->n_iterations - iter;
+
+	// regularization gradient is refreshed once per window
+	float regularization_gradient = __residual_regularization(*lm);
+
+	// STOCHASTIC runs a single shard on this thread while HOGWILD
+	// runs a shard per thread, all updating W concurrently
+	sgd_args args = {
+		.X = X,
+		.Y = Y,
+		.lm = *lm,
+		.workspace = workspace,
+		.n_samples = n_samples,
+		.learning_rate = (*lm)->learning_rate_schedule(*lm, iter),
+		.regularization_gradient = regularization_gradient,
+		.proximal = proximal && !window_proximal,
+		.lazy = lazy
+	};
+	if (workspace->thread_pool && workspace->n_shards > 1)
+		gmf_util_thread_pool_run(workspace->thread_pool, workspace->n_shards, &__sgd_shard, &args);
+	else
+		for (size_t s = 0; s < workspace->n_shards; ++s)
+			__sgd_shard(&args, s);
+
+	double loss_sum = 0.0;
+	size_t n_loss_samples = 0;
+	for (size_t s = 0; s < workspace->n_shards; ++s)
+	{
+		loss_sum += workspace->shards[s].loss;
+		n_loss_samples += workspace->shards[s].n_loss_samples;
+	}
+
+	// a single proximal step for the n_samples updates of every shard
+	if (window_proximal)
+		gmf_regularization_proximal(
+				(*lm)->regularization,
+				(*lm)->params->regularization_params,
+				args.learning_rate * (float)n_samples,
+				(*lm)->params->exclude_bias ? 1 : 0,
+				(*lm)->W->data,
+				(*lm)->W->n_rows);
+
+	// W is read as a whole below
+	if (lazy)
+		gmf_regularization_lazy_flush(lazy, (*lm)->W->data);
+
+	// average loss per sample over the tail of the window (+ regularization)
+	float loss = (float)(loss_sum / (double)n_loss_samples);
+	if ((*lm)->regularization)
+		loss += (*lm)->regularization((*lm)->params->regularization_params, (*lm)->W);
+
+	// check early stop criteria
+	if (__check_loss(*lm, workspace, loss, n_samples, &tracker))
+	{
+		stop_early = true;
+		break;
+	}
+
+	// only print loss 10 times for any given number
+	// of iterations
+	if (iter == 0 || (iter + n_samples) / print_interval > iter / print_interval)
+	{
+		if (iter == 0)
+			initial_loss = loss;
+		else if (loss > 10 * initial_loss)
+		{
+			printf("WARNING: loss blew up. Consider lowering your learning rate.\n");
+			break;
+		}
+
+		if (verbose)
+			__print_loss(iter, loss, &tracker);
+	}
+}
@@ -0,0 +1,57 @@
+for (size_t iter = 0; iter < (*lm)->params->n_iterations; ++iter)
+{
+	const bool check_loss = iter % check_interval == 0;
+	const bool print_loss = iter % print_interval == 0;
+
+	// next batch of the current (shuffled) epoch. Every step reads the rows
+	// straight out of X and only touches the weights of their non-zero columns
+	const size_t* batch_idx = __next_sample(workspace);
+	float loss = (float)gmf_fused_loss_sgd_batch(
+			X,
+			Y,
+			*lm,
+			(*lm)->learning_rate_schedule(*lm, iter),
+			__residual_regularization(*lm),
+			batch_idx,
+			workspace->n_sample_rows,
+			check_loss || print_loss,
+			lazy,
+			workspace->Yhat->data,
+			(*lm)->W->data);
+
+	// W is only read as a whole when the loss is used
+	if (check_loss || print_loss)
+	{
+		if (lazy)
+			gmf_regularization_lazy_flush(lazy, (*lm)->W->data);
+		if ((*lm)->regularization)
+			loss += (*lm)->regularization((*lm)->params->regularization_params, (*lm)->W);
+	}
+
+	// check early stop criteria
+	if (check_loss && __check_loss(*lm, workspace, loss, check_interval, &tracker))
+	{
+		stop_early = true;
+		break;
+	}
+
+	// only print loss 10 times for any given number
+	// of iterations
+	if (print_loss)
+	{
+		if (iter == 0)
+			initial_loss = loss;
+		else if (loss > 10 * initial_loss)
+		{
+			printf("WARNING: loss blew up. Consider lowering your learning rate.\n");
+			break;
+		}
+
+		if (verbose)
+			__print_loss(iter, loss, &tracker);
+	}
+}
+
+// bring the weights that weren't used since the last loss check up to date
+if (lazy)
+	gmf_regularization_lazy_flush(lazy, (*lm)->W->data);
@@ -1,59 +1,62 @@
 for (size_t iter = 0; iter < (*lm)->params->n_iterations; ++iter)
 {
-	// sample single point (stochastic optimization)
-	size_t sampled_idx[1];
-	Matrix* X_sample = mat_sample(X, 1, false, sampled_idx);
-	Matrix* Y_sample = mat_subset(Y, sampled_idx[0], sampled_idx[0], 0, 0);
+	const bool check_loss = iter % check_interval == 0;
+	const bool print_loss = iter % print_interval == 0;
 
-	Matrix* Yhat = NULL;
-	mat_init(&Yhat, 1, 1);
+	// sample single point (stochastic optimization)
+	// sampled row is copied into the workspace, nothing is allocated
+	__gather_rows(workspace, X, Y, __next_sample(workspace));
+	Matrix* X_sample = workspace->X_sample;
+	Matrix* Y_sample = workspace->Y_sample;
 
-	// get linear combination of data and weights
-	mat_multiply_inplace(X_sample, (*lm)->W, &Yhat);
-	
-	// apply activation
-	(*lm)->activation(&Yhat, *lm);
+	Matrix* Yhat = workspace->Yhat;
+	float loss = 0.0f;
 
-	// compute loss and check early stop criteria
-	float loss = (*lm)->loss(Y_sample, Yhat, *lm);
+	if (fused_loss_gradient)
+	{
+		// activation, loss and gradient in one pass over the sample
+		loss = fused_loss_gradient(X_sample, Y_sample, *lm, &loss_grad);
+	}
+	else
+	{
+		// get linear combination of data and weights
+		mat_multiply_inplace(X_sample, (*lm)->W, &Yhat);
+		
+		// apply activation
+		(*lm)->activation(&Yhat, *lm);
+
+		// compute loss (an extra pass, so only when it's used)
+		if (print_loss || (check_loss && !workspace->best_W))
+			loss = (*lm)->loss(Y_sample, Yhat, *lm);
+	}
 
-	stop_early = __check_loss_tolerance(loss, previous_loss, (*lm)->params->early_stop_threshold, &tolerance_counter, (*lm)->params->early_stop_iterations);
-	if (stop_early)
+	// check early stop criteria
+	if (check_loss && __check_loss(*lm, workspace, loss, check_interval, &tracker))
 	{
-		// incase early stop, we must release memory early
-		mat_free(&X_sample);
-		mat_free(&Y_sample);
-		mat_free(&Yhat);
+		stop_early = true;
 		break;
 	}
-	previous_loss = loss;
 
 	// only print loss 10 times for any given number
 	// of iterations
-	if (iter % (size_t)((float)(*lm)->params->n_iterations / 10.0f) == 0)
+	if (print_loss)
 	{
 		if (iter == 0)
 			initial_loss = loss;
-		else if (iter > 0 && loss > 10 * initial_loss)
+		else if (loss > 10 * initial_loss)
 		{
 			printf("WARNING: loss blew up. Consider lowering your learning rate.\n");
-			// incase early stop, we must release memory early
-			mat_free(&X_sample);
-			mat_free(&Y_sample);
-			mat_free(&Yhat);
 			break;
 		}
 
 		if (verbose)
-			printf("Loss at iteration %zu: %f\n", iter, loss);
-	}	
+			__print_loss(iter, loss, &tracker);
+	}
 
-	(*lm)->loss_gradient(Y_sample, Yhat, X_sample, *lm, &loss_grad);
-	mat_free(&X_sample);
-	mat_free(&Y_sample);
-	mat_free(&Yhat);
+	if (!fused_loss_gradient)
+		(*lm)->loss_gradient(Y_sample, Yhat, X_sample, *lm, &loss_grad);
 
 	// update weights
-	mat_multiply_s(&loss_grad, (*lm)->params->learning_rate);
-	mat_subtract_e(&(*lm)->W, loss_grad);
+	const float learning_rate = (*lm)->learning_rate_schedule(*lm, iter);
+	__update_weights(*lm, loss_grad, learning_rate, workspace);
 }
@@ -0,0 +1,149 @@
+#include "optimizers.h"
+#include "matrix.h"
+#include "linear_model.h"
+
+#define GMF_PI 3.14159265358979323846
+
+void gmf_optimizer_sgd(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state)
+{
+	float* w = (*W)->data;
+	const float* g = gradient->data;
+	for (size_t i = 0; i < (*W)->n_rows; ++i)
+		w[i] -= learning_rate * g[i];
+	state->step++;
+}
+
+void gmf_optimizer_momentum(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state)
+{
+	const float momentum = lm->params->momentum;
+	float* w = (*W)->data;
+	const float* g = gradient->data;
+	for (size_t i = 0; i < (*W)->n_rows; ++i)
+	{
+		state->velocity[i] = momentum * state->velocity[i] + g[i];
+		w[i] -= learning_rate * state->velocity[i];
+	}
+	state->step++;
+}
+
+void gmf_optimizer_nesterov(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state)
+{
+	const float momentum = lm->params->momentum;
+	float* w = (*W)->data;
+	const float* g = gradient->data;
+	for (size_t i = 0; i < (*W)->n_rows; ++i)
+	{
+		state->velocity[i] = momentum * state->velocity[i] + g[i];
+		w[i] -= learning_rate * (g[i] + momentum * state->velocity[i]);
+	}
+	state->step++;
+}
+
+void gmf_optimizer_adagrad(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state)
+{
+	const float epsilon = lm->params->epsilon;
+	float* w = (*W)->data;
+	const float* g = gradient->data;
+	for (size_t i = 0; i < (*W)->n_rows; ++i)
+	{
+		state->accumulator[i] += g[i] * g[i];
+		w[i] -= learning_rate * g[i] / (sqrtf(state->accumulator[i]) + epsilon);
+	}
+	state->step++;
+}
+
+void gmf_optimizer_rmsprop(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state)
+{
+	const float beta2 = lm->params->beta2;
+	const float epsilon = lm->params->epsilon;
+	float* w = (*W)->data;
+	const float* g = gradient->data;
+	for (size_t i = 0; i < (*W)->n_rows; ++i)
+	{
+		state->accumulator[i] = beta2 * state->accumulator[i] + (1.0f - beta2) * g[i] * g[i];
+		w[i] -= learning_rate * g[i] / (sqrtf(state->accumulator[i]) + epsilon);
+	}
+	state->step++;
+}
+
+void gmf_optimizer_adam(
+		Matrix** W,
+		const Matrix* gradient,
+		const float learning_rate,
+		const LinearModel* lm,
+		LinearModelOptimizerState* state)
+{
+	const float beta1 = lm->params->beta1;
+	const float beta2 = lm->params->beta2;
+	const float epsilon = lm->params->epsilon;
+	state->step++;
+
+	// bias corrections are folded into the step size so the
+	// inner loop doesn't divide each moment separately
+	const double correction1 = 1.0 - pow(beta1, (double)state->step);
+	const double correction2 = 1.0 - pow(beta2, (double)state->step);
+	const float step_size = (float)(learning_rate * sqrt(correction2) / correction1);
+	const float epsilon_hat = (float)(epsilon * sqrt(correction2));
+
+	float* w = (*W)->data;
+	const float* g = gradient->data;
+	for (size_t i = 0; i < (*W)->n_rows; ++i)
+	{
+		state->velocity[i] = beta1 * state->velocity[i] + (1.0f - beta1) * g[i];
+		state->accumulator[i] = beta2 * state->accumulator[i] + (1.0f - beta2) * g[i] * g[i];
+		w[i] -= step_size * state->velocity[i] / (sqrtf(state->accumulator[i]) + epsilon_hat);
+	}
+}
+
+float gmf_learning_rate_constant(
+		const LinearModel* lm,
+		const size_t iteration)
+{
+	return lm->params->learning_rate;
+}
+
+float gmf_learning_rate_step_decay(
+		const LinearModel* lm,
+		const size_t iteration)
+{
+	const size_t decay_steps = lm->params->decay_steps > 0 ? lm->params->decay_steps : 1;
+	return lm->params->learning_rate * powf(lm->params->decay_rate, (float)(iteration / decay_steps));
+}
+
+float gmf_learning_rate_cosine(
+		const LinearModel* lm,
+		const size_t iteration)
+{
+	const float min_learning_rate = lm->params->min_learning_rate;
+	if (lm->params->n_iterations == 0)
+		return lm->params->learning_rate;
+
+	double progress = (double)iteration / (double)lm->params->n_iterations;
+	progress = progress > 1.0 ? 1.0 : progress;
+	return min_learning_rate + (lm->params->learning_rate - min_learning_rate) * (float)(0.5 * (1.0 + cos(GMF_PI * progress)));
+}
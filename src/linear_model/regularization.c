@@ -1,35 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "regularization.h"
 #include "matrix.h"
 
+static void err(const char* msg)
+{
+	printf("%s\n", msg);
+	exit(-1);
+}
+
+// all regularization functions read W directly so
+// they don't allocate anything while training
+
 float gmf_regularization_L1(const float* params, const Matrix* W)
 {
-	Matrix* W_copy = mat_copy(W);
-	for (size_t i = 0; i < W_copy->n_rows; ++i)
-		mat_set(&W_copy, i, 0, fabsf(mat_at(W_copy, i, 0)));
-	float weight_sum = mat_sum(W_copy);
-	mat_free(&W_copy);	
+	float weight_sum = 0.0f;
+	for (size_t i = 0; i < W->n_rows; ++i)
+		weight_sum += fabsf(mat_at(W, i, 0));
 
 	return params[0] * weight_sum;
 }
 
 float gmf_regularization_L2(const float* params, const Matrix* W)
 {
-	Matrix* W_copy = mat_copy(W);
-	for (size_t i = 0; i < W_copy->n_rows; ++i)
-		mat_set(&W_copy, i, 0, powf(mat_at(W_copy, i, 0), 2.0f));
-	float weight_sum = mat_sum(W_copy);
-	mat_free(&W_copy);	
+	float weight_sum = 0.0f;
+	for (size_t i = 0; i < W->n_rows; ++i)
+		weight_sum += powf(mat_at(W, i, 0), 2.0f);
 
 	return params[0] * weight_sum;
 }
 
 float gmf_regularization_LN(const float* params, const Matrix* W)
 {
-	Matrix* W_copy = mat_copy(W);
-	for (size_t i = 0; i < W_copy->n_rows; ++i)
-		mat_set(&W_copy, i, 0, powf(mat_at(W_copy, i, 0), params[1]));
-	float weight_sum = mat_sum(W_copy);
-	mat_free(&W_copy);
+	float weight_sum = 0.0f;
+	for (size_t i = 0; i < W->n_rows; ++i)
+		weight_sum += powf(mat_at(W, i, 0), params[1]);
 
 	return params[0] * weight_sum;
 }
+
+float gmf_regularization_elastic_net(const float* params, const Matrix* W)
+{
+	float l1_sum = 0.0f;
+	float l2_sum = 0.0f;
+	for (size_t i = 0; i < W->n_rows; ++i)
+	{
+		l1_sum += fabsf(mat_at(W, i, 0));
+		l2_sum += powf(mat_at(W, i, 0), 2.0f);
+	}
+
+	return params[0] * (params[1] * l1_sum + (1.0f - params[1]) * l2_sum);
+}
+
+bool gmf_regularization_is_proximal(float (*regularization)(const float*, const Matrix*))
+{
+	return regularization == &gmf_regularization_L1
+		|| regularization == &gmf_regularization_L2
+		|| regularization == &gmf_regularization_elastic_net;
+}
+
+// split a proximal regularization into its L1 and L2 strengths
+static void __proximal_penalty(
+		float (*regularization)(const float*, const Matrix*),
+		const float* params,
+		float* l1,
+		float* l2)
+{
+	*l1 = 0.0f;
+	*l2 = 0.0f;
+	if (regularization == &gmf_regularization_L1)
+		*l1 = params[0];
+	else if (regularization == &gmf_regularization_L2)
+		*l2 = params[0];
+	else if (regularization == &gmf_regularization_elastic_net)
+	{
+		*l1 = params[0] * params[1];
+		*l2 = params[0] * (1.0f - params[1]);
+	}
+}
+
+void gmf_regularization_proximal(
+		float (*regularization)(const float*, const Matrix*),
+		const float* params,
+		const float step,
+		const size_t first,
+		float* W,
+		const size_t n)
+{
+	float l1 = 0.0f;
+	float l2 = 0.0f;
+	__proximal_penalty(regularization, params, &l1, &l2);
+
+	const float threshold = step * l1;
+	const float decay = 1.0f / (1.0f + 2.0f * step * l2);
+	for (size_t i = first; i < n; ++i)
+	{
+		const float w = W[i];
+		const float shrunk = fabsf(w) - threshold;
+		W[i] = shrunk > 0.0f ? copysignf(shrunk * decay, w) : 0.0f;
+	}
+}
+
+void gmf_regularization_lazy_init(
+		LazyRegularization* lazy,
+		float (*regularization)(const float*, const Matrix*),
+		const float* params,
+		const size_t first,
+		const size_t n_weights)
+{
+	if (lazy->n_weights != n_weights || !lazy->weight_scale)
+	{
+		gmf_regularization_lazy_free(lazy);
+		lazy->weight_scale = malloc((n_weights + 1) * sizeof(double));
+		lazy->weight_shrinkage = malloc((n_weights + 1) * sizeof(double));
+		if (!lazy->weight_scale || !lazy->weight_shrinkage)
+			err("Couldn't allocate memory for LazyRegularization.");
+		lazy->n_weights = n_weights;
+	}
+
+	__proximal_penalty(regularization, params, &lazy->l1, &lazy->l2);
+	lazy->first = first;
+	lazy->scale = 1.0;
+	lazy->shrinkage = 0.0;
+	for (size_t i = 0; i < n_weights; ++i)
+	{
+		lazy->weight_scale[i] = 1.0;
+		lazy->weight_shrinkage[i] = 0.0;
+	}
+}
+
+void gmf_regularization_lazy_free(LazyRegularization* lazy)
+{
+	free(lazy->weight_scale);
+	free(lazy->weight_shrinkage);
+	lazy->weight_scale = NULL;
+	lazy->weight_shrinkage = NULL;
+	lazy->n_weights = 0;
+}
+
+void gmf_regularization_lazy_update(
+		LazyRegularization* lazy,
+		const size_t i,
+		float* W)
+{
+	if (i < lazy->first)
+		return;
+
+	// |w| / scale shrinks by the L1 threshold of every step divided by
+	// the scale before that step and never crosses zero
+	const double w = W[i];
+	const double u = fabs(w) / lazy->weight_scale[i] - (lazy->shrinkage - lazy->weight_shrinkage[i]);
+	W[i] = u > 0.0 ? (float)copysign(u * lazy->scale, w) : 0.0f;
+	lazy->weight_scale[i] = lazy->scale;
+	lazy->weight_shrinkage[i] = lazy->shrinkage;
+}
+
+void gmf_regularization_lazy_step(
+		LazyRegularization* lazy,
+		const float step,
+		float* W)
+{
+	lazy->shrinkage += (double)step * lazy->l1 / lazy->scale;
+	lazy->scale /= 1.0 + 2.0 * (double)step * lazy->l2;
+
+	// keep the scale (and the shrinkage which grows like 1 / scale) in range
+	if (lazy->scale < GMF_LAZY_MIN_SCALE)
+		gmf_regularization_lazy_flush(lazy, W);
+}
+
+void gmf_regularization_lazy_flush(
+		LazyRegularization* lazy,
+		float* W)
+{
+	for (size_t i = lazy->first; i < lazy->n_weights; ++i)
+		gmf_regularization_lazy_update(lazy, i, W);
+
+	lazy->scale = 1.0;
+	lazy->shrinkage = 0.0;
+	for (size_t i = 0; i < lazy->n_weights; ++i)
+	{
+		lazy->weight_scale[i] = 1.0;
+		lazy->weight_shrinkage[i] = 0.0;
+	}
+}
@@ -1,35 +1,76 @@
 #include "regularization_gradient.h"
+#include "regularization.h"
 #include "matrix.h"
 
 float gmf_regularization_gradient_L1(const float* params, const Matrix* W)
 {
-	Matrix* W_copy = mat_copy(W);
 	float weight_sum = 0.0f;
 	for (size_t i = 0; i < W->n_rows; ++i)
-		weight_sum += mat_at(W_copy, i, 0) / fabsf(mat_at(W_copy, i, 0));
-	mat_free(&W_copy);
+	{
+		float w = mat_at(W, i, 0);
+		// sign(w) with sign(0) = 0 (w / |w| is NaN for a zero weight)
+		weight_sum += (w > 0.0f) - (w < 0.0f);
+	}
 
 	return params[0] * weight_sum;
 }
 
 float gmf_regularization_gradient_L2(const float* params, const Matrix* W)
 {
-	Matrix* W_copy = mat_copy(W);
 	float weight_sum = 0.0f;
 	for (size_t i = 0; i < W->n_rows; ++i)
-		weight_sum += mat_at(W_copy, i, 0); 
-	mat_free(&W_copy);
+		weight_sum += mat_at(W, i, 0); 
 
 	return params[0] * 2 * weight_sum;
 }
 
 float gmf_regularization_gradient_LN(const float* params, const Matrix* W)
 {
-	Matrix* W_copy = mat_copy(W);
 	float weight_sum = 0.0f;
 	for (size_t i = 0; i < W->n_rows; ++i)
-		weight_sum += mat_at(W_copy, i, 0); 
-	mat_free(&W_copy);
+		weight_sum += mat_at(W, i, 0); 
 
 	return params[0] * params[1] * weight_sum;
 }
+
+float gmf_regularization_gradient_elastic_net(const float* params, const Matrix* W)
+{
+	float l1_sum = 0.0f;
+	float l2_sum = 0.0f;
+	for (size_t i = 0; i < W->n_rows; ++i)
+	{
+		float w = mat_at(W, i, 0);
+		// sign(w) with sign(0) = 0
+		l1_sum += (w > 0.0f) - (w < 0.0f);
+		l2_sum += w;
+	}
+
+	return params[0] * (params[1] * l1_sum + (1.0f - params[1]) * 2 * l2_sum);
+}
+
+void gmf_regularization_gradient_weights(
+		float (*regularization)(const float*, const Matrix*),
+		const float* params,
+		const size_t first,
+		const float* W,
+		const size_t n,
+		float* gradient)
+{
+	float l1 = 0.0f;
+	float l2 = 0.0f;
+	if (regularization == &gmf_regularization_L1)
+		l1 = params[0];
+	else if (regularization == &gmf_regularization_L2)
+		l2 = params[0];
+	else if (regularization == &gmf_regularization_elastic_net)
+	{
+		l1 = params[0] * params[1];
+		l2 = params[0] * (1.0f - params[1]);
+	}
+
+	for (size_t i = first; i < n; ++i)
+	{
+		const float w = W[i];
+		gradient[i] += l1 * ((w > 0.0f) - (w < 0.0f)) + 2.0f * l2 * w;
+	}
+}
@@ -0,0 +1,220 @@
+#include "solvers.h"
+#include "matrix.h"
+#include "feature_matrix.h"
+#include "linear_model.h"
+
+// block size of the Cholesky factorization. A panel of
+// GMF_CHOLESKY_BLOCK columns of a 500 feature system fits in L2
+#define GMF_CHOLESKY_BLOCK 64
+
+// add sum(weights[k] * x_k^T x_k) over a block of n_block rows to the
+// lower triangle of gram. Adding several rows per pass over gram cuts
+// the memory traffic on the (n, n) system by the block size.
+static void __rank_k_update(
+		double* gram,
+		const double* rows,
+		const double* weights,
+		const size_t n_block,
+		const size_t n)
+{
+	if (n_block == GMF_SOLVER_ROW_BLOCK)
+	{
+		const double* x0 = rows;
+		const double* x1 = rows + n;
+		const double* x2 = rows + 2 * n;
+		const double* x3 = rows + 3 * n;
+		for (size_t i = 0; i < n; ++i)
+		{
+			const double a0 = weights[0] * x0[i];
+			const double a1 = weights[1] * x1[i];
+			const double a2 = weights[2] * x2[i];
+			const double a3 = weights[3] * x3[i];
+			double* gram_row = gram + i * n;
+			for (size_t j = 0; j <= i; ++j)
+				gram_row[j] += a0 * x0[j] + a1 * x1[j] + a2 * x2[j] + a3 * x3[j];
+		}
+		return;
+	}
+
+	for (size_t k = 0; k < n_block; ++k)
+	{
+		const double* x = rows + k * n;
+		for (size_t i = 0; i < n; ++i)
+		{
+			const double a = weights[k] * x[i];
+			double* gram_row = gram + i * n;
+			for (size_t j = 0; j <= i; ++j)
+				gram_row[j] += a * x[j];
+		}
+	}
+}
+
+// weighted log loss that doesn't overflow for large |z| where z = x * W
+static double __log_loss(const double y, const double z)
+{
+	// log(1 + e^z) - y * z
+	const double softplus = z > 0.0 ? z + log1p(exp(-z)) : log1p(exp(z));
+	return softplus - y * z;
+}
+
+double gmf_solver_accumulate(
+		const FeatureMatrix* X,
+		const Matrix* Y,
+		const LinearModel* lm,
+		const size_t row_start,
+		const size_t row_end,
+		double* gram,
+		double* rhs,
+		double* rows)
+{
+	const size_t n_columns = X->n_columns;
+	const float* w = lm->W->data;
+	const bool newton = lm->params->model_type == NEWTON;
+	double loss = 0.0;
+	double weights[GMF_SOLVER_ROW_BLOCK];
+	size_t n_block = 0;
+
+	for (size_t r = row_start; r < row_end; ++r)
+	{
+		const double y = Y->data[r];
+
+		// widen the row once, every product below is in double
+		double* row = rows + n_block * n_columns;
+		double z = 0.0;
+		for (size_t c = 0; c < n_columns; ++c)
+		{
+			row[c] = gmf_features_at(X, r, c);
+			z += row[c] * w[c];
+		}
+
+		double target = y;
+		weights[n_block] = 1.0;
+		if (newton)
+		{
+			double class_weight = 1.0;
+			if (lm->params->class_weights)
+				class_weight = lm->params->class_weights[lm->params->class_pair[(size_t)y]];
+
+			const double p = 1.0 / (1.0 + exp(-z));
+			weights[n_block] = class_weight * p * (1.0 - p);
+			target = class_weight * (p - y);
+			loss += class_weight * __log_loss(y, z);
+		}
+		else
+			loss += y * y;
+
+		for (size_t c = 0; c < n_columns; ++c)
+			rhs[c] += target * row[c];
+
+		if (++n_block == GMF_SOLVER_ROW_BLOCK)
+		{
+			__rank_k_update(gram, rows, weights, n_block, n_columns);
+			n_block = 0;
+		}
+	}
+
+	if (n_block > 0)
+		__rank_k_update(gram, rows, weights, n_block, n_columns);
+
+	return loss;
+}
+
+// unblocked factorization of the (n, n) diagonal block starting at A[k][k]
+static bool __cholesky_block(
+		double* A,
+		const size_t lda,
+		const size_t k,
+		const size_t n)
+{
+	for (size_t j = k; j < k + n; ++j)
+	{
+		double* row_j = A + j * lda;
+		double diagonal = row_j[j];
+		for (size_t p = k; p < j; ++p)
+			diagonal -= row_j[p] * row_j[p];
+		if (!(diagonal > 0.0))
+			return false;
+		row_j[j] = sqrt(diagonal);
+
+		for (size_t i = j + 1; i < k + n; ++i)
+		{
+			double* row_i = A + i * lda;
+			double value = row_i[j];
+			for (size_t p = k; p < j; ++p)
+				value -= row_i[p] * row_j[p];
+			row_i[j] = value / row_j[j];
+		}
+	}
+
+	return true;
+}
+
+bool gmf_solver_cholesky(
+		double* A,
+		const size_t n)
+{
+	// right-looking blocked factorization. Every step factors a diagonal
+	// block, solves the panel below it and updates the trailing matrix.
+	// Rows are contiguous so all inner loops are unit stride dot products.
+	for (size_t k = 0; k < n; k += GMF_CHOLESKY_BLOCK)
+	{
+		const size_t kb = n - k < GMF_CHOLESKY_BLOCK ? n - k : GMF_CHOLESKY_BLOCK;
+		if (!__cholesky_block(A, n, k, kb))
+			return false;
+
+		// panel: L21 = A21 * L11^-T
+		for (size_t i = k + kb; i < n; ++i)
+		{
+			double* row_i = A + i * n;
+			for (size_t j = k; j < k + kb; ++j)
+			{
+				const double* row_j = A + j * n;
+				double value = row_i[j];
+				for (size_t p = k; p < j; ++p)
+					value -= row_i[p] * row_j[p];
+				row_i[j] = value / row_j[j];
+			}
+		}
+
+		// trailing update: A22 -= L21 * L21^T (lower triangle only)
+		for (size_t i = k + kb; i < n; ++i)
+		{
+			double* row_i = A + i * n;
+			for (size_t j = k + kb; j <= i; ++j)
+			{
+				const double* row_j = A + j * n;
+				double value = 0.0;
+				for (size_t p = k; p < k + kb; ++p)
+					value += row_i[p] * row_j[p];
+				row_i[j] -= value;
+			}
+		}
+	}
+
+	return true;
+}
+
+void gmf_solver_cholesky_solve(
+		const double* L,
+		double* b,
+		const size_t n)
+{
+	// forward substitution: L * y = b
+	for (size_t i = 0; i < n; ++i)
+	{
+		const double* row_i = L + i * n;
+		double value = b[i];
+		for (size_t p = 0; p < i; ++p)
+			value -= row_i[p] * b[p];
+		b[i] = value / row_i[i];
+	}
+
+	// back substitution: L^T * x = y
+	for (size_t i = n; i-- > 0;)
+	{
+		double value = b[i];
+		for (size_t p = i + 1; p < n; ++p)
+			value -= L[p * n + i] * b[p];
+		b[i] = value / L[i * n + i];
+	}
+}
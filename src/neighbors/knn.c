@@ -13,6 +13,7 @@ static void __default_params(KNN** knn)
 	(*knn)->type = CLASSIC;
 	(*knn)->params->distance = &gmf_distance_euclidean;
 	(*knn)->params->n_neighbors = 3;
+	(*knn)->params->feature_type = FEATURES_F32;
 }
 
 KNN* gmf_model_knn_init()
@@ -28,6 +29,9 @@ KNN* gmf_model_knn_init()
 		knn_err("Couldn't allocate memory for KNN.");
 
 	knn->params = alloc;
+	knn->X = NULL;
+	knn->features = NULL;
+	knn->Y = NULL;
 
 	__default_params(&knn);
 
@@ -55,13 +59,38 @@ void gmf_model_knn_set_neighbors(
 	(*knn)->params->n_neighbors = n_neighbors;
 }
 
+void gmf_model_knn_set_feature_type(
+		KNN** knn,
+		const FeatureType feature_type)
+{
+	(*knn)->params->feature_type = feature_type;
+}
+
 void gmf_model_knn_fit(
 		KNN** knn,
 		const Matrix* X,
 		const Matrix* Y)
 {
-	// KNN stores copy
-	(*knn)->X = mat_copy(X);
+	// KNN stores copy (converted to feature_type)
+	if ((*knn)->params->feature_type == FEATURES_F32)
+		(*knn)->X = mat_copy(X);
+	else
+		(*knn)->features = gmf_features_init(X, (*knn)->params->feature_type);
+	(*knn)->Y = mat_copy(Y);
+}
+
+void gmf_model_knn_fit_features(
+		KNN** knn,
+		const FeatureMatrix* X,
+		const Matrix* Y)
+{
+	// KNN keeps a non-owning view of X, predict() converts its rows on the fly
+	void* alloc = malloc(sizeof(FeatureMatrix));
+	if (!alloc)
+		knn_err("Couldn't allocate memory for KNN.");
+	(*knn)->features = alloc;
+	*(*knn)->features = *X;
+	(*knn)->features->owns_data = false;
 	(*knn)->Y = mat_copy(Y);
 }
 
@@ -86,13 +115,19 @@ Matrix* gmf_model_knn_predict(
 	Vector* row_vec = NULL;
 	Vector* test_row = NULL;
 	distance_pair* distance_pairs = NULL;
+	const size_t n_train_rows = knn->features ? knn->features->n_rows : knn->X->n_rows;
 
-	void* alloc = malloc(knn->X->n_rows * sizeof(distance_pair));
+	void* alloc = malloc(n_train_rows * sizeof(distance_pair));
 	if (!alloc)
 		knn_err("Couldn't allocate memory to store distances for KNN.");
 
 	distance_pairs = alloc;
 
+	// reduced precision rows are converted into the same vector every time
+	Vector* train_row = NULL;
+	if (knn->features)
+		vec_init(&train_row, knn->features->n_columns);
+
 	Matrix* predicted = NULL;
 	mat_init(&predicted, X->n_rows, 1);
 
@@ -113,7 +148,7 @@ Matrix* gmf_model_knn_predict(
 
 		vec_free(&row_vec);
 
-		qsort(distance_pairs, knn->X->n_rows, sizeof(distance_pair), &distance_comparator);
+		qsort(distance_pairs, n_train_rows, sizeof(distance_pair), &distance_comparator);
 
 		float estimate = 0.0f;
 		for (size_t k = 0; k < knn->params->n_neighbors; ++k)
@@ -123,6 +158,8 @@ Matrix* gmf_model_knn_predict(
 	}
 
 	free(distance_pairs);
+	if (train_row)
+		vec_free(&train_row);
 	
 	return predicted;
 }
@@ -132,7 +169,10 @@ void gmf_model_knn_free(KNN** knn)
 	free((*knn)->params);
 	(*knn)->params = NULL;
 
-	mat_free(&(*knn)->X);
+	if ((*knn)->X)
+		mat_free(&(*knn)->X);
+	if ((*knn)->features)
+		gmf_features_free(&(*knn)->features);
 	mat_free(&(*knn)->Y);
 
 	free(*knn);
@@ -1,14 +1,24 @@
 // for every test data point, compare distances with every
 // training point
-for (size_t tr = 0; tr < knn->X->n_rows; ++tr)
+for (size_t tr = 0; tr < n_train_rows; ++tr)
 {
 	// don't compute distance to self
 	if (tr == r)
 		continue;
 
-	test_row = mat_get_row(knn->X, tr);
-	float distance = knn->params->distance(row_vec, test_row);
+	float distance = 0.0f;
+	if (knn->features)
+	{
+		// decode the whole row at once (no per element type switch or CSR search)
+		gmf_features_row(knn->features, tr, train_row->data);
+		distance = knn->params->distance(row_vec, train_row);
+	}
+	else
+	{
+		test_row = mat_get_row(knn->X, tr);
+		distance = knn->params->distance(row_vec, test_row);
+		vec_free(&test_row);
+	}
 	distance_pair dp = {.distance = distance, .idx = tr};
 	distance_pairs[tr] = dp;
-	vec_free(&test_row);
 }